@@ -0,0 +1,2 @@
+# c4 is a namespace shared by several packages
+__path__ = __import__("pkgutil").extend_path(__path__, __name__)
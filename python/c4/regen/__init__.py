@@ -0,0 +1,197 @@
+"""In-process code generation with c4regen.
+
+The generators and the writer are described with python objects, from
+which a regen YAML config is made; the code is then generated in this
+process by the native _regen extension module, so that the startup costs
+are paid once per session instead of once per file::
+
+    import c4.regen as regen
+
+    egen = regen.EnumGenerator(hdr="...", src="...")
+    writer = regen.ChunkWriterGenGroup()
+
+    if __name__ == "__main__":
+        regen.run(writer, egen, [more_generators])
+
+A YAML config can also be used directly::
+
+    rg = regen.Regen(open("regen.yml").read(), "regen.yml")
+    rg.gencode(["foo.hpp", "bar.hpp"], flags=["-x", "c++"], jobs=0)
+    for out in rg.gencode_buffers([("foo.hpp", unsaved_contents)]):
+        print(out["names"], out["code"])
+"""
+
+import argparse
+import sys
+
+from ._regen import Regen
+
+
+# -----------------------------------------------------------------------------
+
+def _yml_block(key, text, indent):
+    """emit a YAML literal block"""
+    lines = text.split("\n")
+    if lines and lines[-1] == "":
+        lines.pop()
+    out = indent + key + ": |\n"
+    for l in lines:
+        out += (indent + "  " + l + "\n") if l else "\n"
+    return out
+
+
+class Generator:
+    """the base of the generators: each generator extracts the entities
+    tagged with a macro, and renders code for them with its templates"""
+
+    type = None
+    default_macro = None
+
+    def __init__(self, name=None, macro=None, attr=None,
+                 hdr="", inl="", src="",
+                 hdr_preamble="", inl_preamble="", src_preamble=""):
+        self.name = name if name else self.type
+        self.macro = macro if macro else self.default_macro
+        self.attr = attr
+        self.hdr = hdr
+        self.inl = inl
+        self.src = src
+        self.hdr_preamble = hdr_preamble
+        self.inl_preamble = inl_preamble
+        self.src_preamble = src_preamble
+
+    def to_yml(self):
+        out = "  - name: {}\n".format(self.name)
+        out += "    type: {}\n".format(self.type)
+        out += "    extract:\n"
+        out += "      macro: {}\n".format(self.macro)
+        if self.attr:
+            out += "      attr: {}\n".format(self.attr)
+        for key in ("hdr_preamble", "inl_preamble", "src_preamble", "hdr", "inl", "src"):
+            val = getattr(self, key)
+            if val:
+                out += _yml_block(key, val, "    ")
+        return out
+
+
+class EnumGenerator(Generator):
+    type = "enum"
+    default_macro = "C4_ENUM"
+
+
+class ClassGenerator(Generator):
+    type = "class"
+    default_macro = "C4_CLASS"
+
+
+class FunctionGenerator(Generator):
+    type = "function"
+    default_macro = "C4_FUNCTION"
+
+
+# -----------------------------------------------------------------------------
+
+class ChunkWriter:
+    """the base of the writers: a writer decides the files where the
+    generated code goes"""
+
+    type = None
+
+    def __init__(self, chunk=None, hdr=None, inl=None, src=None):
+        self.tpl = {"chunk": chunk, "hdr": hdr, "inl": inl, "src": src}
+
+    def to_yml(self):
+        out = "writer: {}\n".format(self.type)
+        if any(self.tpl.values()):
+            out += "tpl:\n"
+            for key, val in self.tpl.items():
+                if val:
+                    out += _yml_block(key, val, "  ")
+        return out
+
+
+class ChunkWriterStdout(ChunkWriter):
+    type = "stdout"
+
+
+class ChunkWriterGenFile(ChunkWriter):
+    type = "genfile"
+
+
+class ChunkWriterGenGroup(ChunkWriter):
+    type = "gengroup"
+
+
+class ChunkWriterSameFile(ChunkWriter):
+    type = "samefile"
+
+
+class ChunkWriterSingleFile(ChunkWriter):
+    type = "singlefile"
+
+
+# -----------------------------------------------------------------------------
+
+def _flatten(generators):
+    for g in generators:
+        if isinstance(g, (list, tuple)):
+            yield from _flatten(g)
+        else:
+            yield g
+
+
+def config_yml(writer, *generators):
+    """get the regen YAML config for a writer and generators"""
+    out = writer.to_yml()
+    out += "generators:\n"
+    for g in _flatten(generators):
+        out += g.to_yml()
+    return out
+
+
+# the generated files which are compiled; the others are headers
+_SOURCE_EXTENSIONS = (".c", ".cc", ".cpp", ".cxx")
+
+
+def make_regen(writer, *generators):
+    """create a Regen with a writer and generators"""
+    return Regen(config_yml(writer, *generators), "<python>")
+
+
+def run(writer, *generators, argv=None):
+    """the command line of the driver scripts: generate the code of the
+    given files, or print the files which are generated from them"""
+    parser = argparse.ArgumentParser(description="generate code with c4regen")
+    parser.add_argument("files", nargs="*", help="the source files")
+    parser.add_argument("-x", "--cmd", default="generate", choices=["generate", "outfiles", "config"],
+                        help="generate the code, print the files generated from each file, or print the YAML config")
+    parser.add_argument("-f", "--flag", action="append", default=[],
+                        help="a flag for parsing the source files. Can be given several times.")
+    parser.add_argument("-j", "--jobs", type=int, default=None,
+                        help="parse up to this many files in parallel. 0 uses one job per hardware thread. "
+                        "Defaults to the jobs setting of the config.")
+    parser.add_argument("--show-hdr", action="store_true", help="with outfiles: print only the header files")
+    parser.add_argument("--show-src", action="store_true", help="with outfiles: print only the source files")
+    parser.add_argument("--stats", action="store_true", help="print statistics of the run")
+    args = parser.parse_args(argv)
+
+    if args.cmd == "config":
+        print(config_yml(writer, *generators), end="")
+        return 0
+    rg = make_regen(writer, *generators)
+    if args.cmd == "outfiles":
+        for src, names in rg.outfiles(args.files):
+            for n in names:
+                is_src = n.endswith(_SOURCE_EXTENSIONS)
+                if (args.show_hdr and is_src) or (args.show_src and not is_src):
+                    continue
+                print(n)
+        return 0
+    rg.gencode(args.files, flags=args.flag, jobs=args.jobs)
+    if args.stats:
+        rg.print_stats()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(run(ChunkWriterStdout()))
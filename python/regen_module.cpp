@@ -0,0 +1,331 @@
+// The c4.regen._regen python extension module: runs c4::regen::Regen
+// in-process, so that python driver scripts pay the startup costs (the
+// interpreter, libclang, loading the config) once per session instead
+// of once per file.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdexcept>
+#include <c4/regen/regen.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace {
+
+struct PyRegen
+{
+    PyObject_HEAD
+    c4::regen::Regen $ rg;
+};
+
+/** c4 errors abort by default; throw instead, so that they are raised as
+ * python exceptions */
+void _throw_error(const char* msg, size_t len)
+{
+    throw std::runtime_error(std::string(msg, len));
+}
+
+/** run native code without holding the GIL, converting c++ exceptions
+ * to python exceptions. @return false if an exception was raised */
+template<class Fn>
+bool _run(Fn &&fn)
+{
+    std::string err;
+    bool failed = false;
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        fn();
+    }
+    catch(std::exception const& e)
+    {
+        err = e.what();
+        failed = true;
+    }
+    Py_END_ALLOW_THREADS
+    if(failed)
+    {
+        PyErr_SetString(PyExc_RuntimeError, err.c_str());
+    }
+    return ! failed;
+}
+
+/** convert a sequence of str */
+bool _strings(PyObject $ seq, std::vector<std::string> $ out, std::vector<const char*> $ ptrs)
+{
+    out->clear();
+    ptrs->clear();
+    if(seq == nullptr) return true;
+    PyObject $ fast = PySequence_Fast(seq, "expected a sequence of strings");
+    if( ! fast) return false;
+    Py_ssize_t num = PySequence_Fast_GET_SIZE(fast);
+    for(Py_ssize_t i = 0; i < num; ++i)
+    {
+        const char *s = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(fast, i));
+        if( ! s)
+        {
+            Py_DECREF(fast);
+            return false;
+        }
+        out->emplace_back(s);
+    }
+    Py_DECREF(fast);
+    for(auto c$$ s : *out)
+    {
+        ptrs->push_back(s.c_str());
+    }
+    return true;
+}
+
+/** convert a sequence of (name, contents) pairs */
+bool _buffers(PyObject $ seq, std::vector<std::string> $ strs, std::vector<CXUnsavedFile> $ files)
+{
+    strs->clear();
+    files->clear();
+    if(seq == nullptr) return true;
+    PyObject $ fast = PySequence_Fast(seq, "expected a sequence of (name, contents) pairs");
+    if( ! fast) return false;
+    Py_ssize_t num = PySequence_Fast_GET_SIZE(fast);
+    strs->reserve(2 * (size_t)num); // the buffers must not be relocated
+    for(Py_ssize_t i = 0; i < num; ++i)
+    {
+        const char *name = nullptr, *contents = nullptr;
+        Py_ssize_t len = 0;
+        if( ! PyArg_ParseTuple(PySequence_Fast_GET_ITEM(fast, i), "ss#", &name, &contents, &len))
+        {
+            Py_DECREF(fast);
+            return false;
+        }
+        strs->emplace_back(name);
+        strs->emplace_back(contents, (size_t)len);
+    }
+    Py_DECREF(fast);
+    for(size_t i = 0; i < strs->size(); i += 2)
+    {
+        files->push_back(CXUnsavedFile{(*strs)[i].c_str(), (*strs)[i+1].data(), (unsigned long)(*strs)[i+1].size()});
+    }
+    return true;
+}
+
+/** get the native regen of an object, raising if it has none, ie if
+ * __init__ was not called or failed */
+c4::regen::Regen $ _regen(PyRegen $ self)
+{
+    if( ! self->rg)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Regen was not initialized");
+    }
+    return self->rg;
+}
+
+PyObject $ _triplet(c4::regen::CodeInstances<std::string> c$$ c)
+{
+    return Py_BuildValue("(s#s#s#)",
+                         c.m_hdr.data(), (Py_ssize_t)c.m_hdr.size(),
+                         c.m_inl.data(), (Py_ssize_t)c.m_inl.size(),
+                         c.m_src.data(), (Py_ssize_t)c.m_src.size());
+}
+
+
+//-----------------------------------------------------------------------------
+
+int Regen_init(PyRegen $ self, PyObject $ args, PyObject $ kwargs)
+{
+    static const char *kwlist[] = {"config_yml", "name", nullptr};
+    const char *yml = nullptr, *name = "";
+    Py_ssize_t len = 0;
+    if( ! PyArg_ParseTupleAndKeywords(args, kwargs, "s#|s", (char**)kwlist, &yml, &len, &name))
+    {
+        return -1;
+    }
+    delete self->rg;
+    self->rg = new c4::regen::Regen;
+    c4::regen::Regen $ rg = self->rg;
+    std::string cfg(yml, (size_t)len);
+    if( ! _run([&]{ rg->load_config_yml(c4::to_csubstr(cfg), name); }))
+    {
+        delete self->rg;
+        self->rg = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+void Regen_dealloc(PyRegen $ self)
+{
+    delete self->rg;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyObject $ Regen_load_config(PyRegen $ self, PyObject $ args)
+{
+    const char *filename = nullptr;
+    if( ! PyArg_ParseTuple(args, "s", &filename)) return nullptr;
+    c4::regen::Regen $ rg = _regen(self);
+    if( ! rg) return nullptr;
+    if( ! _run([&]{ rg->load_config(filename); })) return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject $ Regen_gencode(PyRegen $ self, PyObject $ args, PyObject $ kwargs)
+{
+    static const char *kwlist[] = {"files", "flags", "jobs", nullptr};
+    PyObject *pyfiles = nullptr, *pyflags = nullptr, *pyjobs = Py_None;
+    if( ! PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", (char**)kwlist, &pyfiles, &pyflags, &pyjobs)) return nullptr;
+    c4::regen::Regen $ rg = _regen(self);
+    if( ! rg) return nullptr;
+    // without jobs, the jobs setting of the config is used
+    const size_t cfg_jobs = rg->m_parse_queue.m_num_jobs;
+    size_t num_jobs = cfg_jobs;
+    if(pyjobs != Py_None)
+    {
+        Py_ssize_t jobs = PyLong_AsSsize_t(pyjobs);
+        if(jobs == -1 && PyErr_Occurred()) return nullptr;
+        if(jobs < 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "jobs must not be negative");
+            return nullptr;
+        }
+        num_jobs = (size_t)jobs;
+    }
+    std::vector<std::string> files, flags;
+    std::vector<const char*> pfiles, pflags;
+    if( ! _strings(pyfiles, &files, &pfiles) || ! _strings(pyflags, &flags, &pflags)) return nullptr;
+    bool ok = _run([&]{
+        rg->m_parse_queue.set_jobs(num_jobs);
+        rg->gencode(pfiles, nullptr, pflags.data(), pflags.size());
+    });
+    rg->m_parse_queue.set_jobs(cfg_jobs);
+    if( ! ok) return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject $ Regen_gencode_buffers(PyRegen $ self, PyObject $ args, PyObject $ kwargs)
+{
+    static const char *kwlist[] = {"sources", "overlays", "flags", nullptr};
+    PyObject *pysources = nullptr, *pyoverlays = nullptr, *pyflags = nullptr;
+    if( ! PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", (char**)kwlist, &pysources, &pyoverlays, &pyflags)) return nullptr;
+    std::vector<std::string> src_strs, ovl_strs, flags;
+    std::vector<CXUnsavedFile> sources, overlays;
+    std::vector<const char*> pflags;
+    if( ! _buffers(pysources, &src_strs, &sources)
+        || ! _buffers(pyoverlays, &ovl_strs, &overlays)
+        || ! _strings(pyflags, &flags, &pflags))
+    {
+        return nullptr;
+    }
+    std::vector<c4::regen::RenderedFile> out;
+    c4::regen::Regen $ rg = _regen(self);
+    if( ! rg) return nullptr;
+    bool ok = _run([&]{
+        rg->gencode_buffers(sources.data(), sources.size(), overlays.data(), overlays.size(),
+                            pflags.data(), pflags.size(), &out);
+    });
+    if( ! ok) return nullptr;
+    PyObject $ ret = PyList_New((Py_ssize_t)out.size());
+    for(size_t i = 0; i < out.size(); ++i)
+    {
+        PyObject $ d = Py_BuildValue("{s:s#,s:N,s:N}",
+                                     "source", out[i].m_source.data(), (Py_ssize_t)out[i].m_source.size(),
+                                     "names", _triplet(out[i].m_names),
+                                     "code", _triplet(out[i].m_code));
+        PyList_SET_ITEM(ret, (Py_ssize_t)i, d);
+    }
+    return ret;
+}
+
+PyObject $ Regen_outfiles(PyRegen $ self, PyObject $ args)
+{
+    PyObject $ pyfiles = nullptr;
+    if( ! PyArg_ParseTuple(args, "O", &pyfiles)) return nullptr;
+    std::vector<std::string> files;
+    std::vector<const char*> pfiles;
+    if( ! _strings(pyfiles, &files, &pfiles)) return nullptr;
+    std::vector<c4::regen::Writer::set_type> names(files.size());
+    c4::regen::Regen $ rg = _regen(self);
+    if( ! rg) return nullptr;
+    bool ok = _run([&]{
+        for(size_t i = 0; i < files.size(); ++i)
+        {
+            rg->m_writer.insert_filenames(c4::to_csubstr(files[i]), &names[i]);
+        }
+    });
+    if( ! ok) return nullptr;
+    PyObject $ ret = PyList_New((Py_ssize_t)files.size());
+    for(size_t i = 0; i < files.size(); ++i)
+    {
+        PyObject $ list = PyList_New((Py_ssize_t)names[i].size());
+        Py_ssize_t j = 0;
+        for(auto c$$ name : names[i])
+        {
+            PyList_SET_ITEM(list, j++, PyUnicode_FromStringAndSize(name.data(), (Py_ssize_t)name.size()));
+        }
+        PyList_SET_ITEM(ret, (Py_ssize_t)i, Py_BuildValue("(sN)", files[i].c_str(), list));
+    }
+    return ret;
+}
+
+PyObject $ Regen_print_stats(PyRegen $ self, PyObject $ /*args*/)
+{
+    c4::regen::Regen $ rg = _regen(self);
+    if( ! rg) return nullptr;
+    rg->print_stats();
+    Py_RETURN_NONE;
+}
+
+PyMethodDef s_regen_methods[] = {
+    {"load_config", (PyCFunction)Regen_load_config, METH_VARARGS,
+     "load_config(filename)\n\nLoad the config from a YAML file."},
+    {"gencode", (PyCFunction)(void(*)(void))Regen_gencode, METH_VARARGS|METH_KEYWORDS,
+     "gencode(files, flags=(), jobs=None)\n\nGenerate the code of the files, and write it. "
+     "jobs overrides the jobs setting of the config for this call; 0 uses one job per hardware thread."},
+    {"gencode_buffers", (PyCFunction)(void(*)(void))Regen_gencode_buffers, METH_VARARGS|METH_KEYWORDS,
+     "gencode_buffers(sources, overlays=(), flags=())\n\n"
+     "Generate the code of (name, contents) source buffers, without touching the filesystem. "
+     "Returns a list of dicts with the keys source, names and code, where names and code "
+     "are (hdr, inl, src) tuples."},
+    {"outfiles", (PyCFunction)Regen_outfiles, METH_VARARGS,
+     "outfiles(files)\n\nReturns a list of (file, [names]) with the files generated from each file: "
+     "every shard, and the files of every generator, as listed by regen --cmd outfiles."},
+    {"print_stats", (PyCFunction)Regen_print_stats, METH_NOARGS,
+     "print_stats()\n\nPrint statistics of the last run to stderr."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyTypeObject s_regen_type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyModuleDef s_module = {PyModuleDef_HEAD_INIT};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit__regen()
+{
+    c4::set_error_callback(&_throw_error);
+
+    s_regen_type.tp_name = "c4.regen._regen.Regen";
+    s_regen_type.tp_doc = "Regen(config_yml, name='')\n\nGenerates code with the given YAML config.";
+    s_regen_type.tp_basicsize = sizeof(PyRegen);
+    s_regen_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    s_regen_type.tp_new = PyType_GenericNew;
+    s_regen_type.tp_init = (initproc)Regen_init;
+    s_regen_type.tp_dealloc = (destructor)Regen_dealloc;
+    s_regen_type.tp_methods = s_regen_methods;
+    if(PyType_Ready(&s_regen_type) < 0) return nullptr;
+
+    s_module.m_name = "c4.regen._regen";
+    s_module.m_doc = "In-process code generation with c4regen.";
+    s_module.m_size = -1;
+    PyObject $ m = PyModule_Create(&s_module);
+    if( ! m) return nullptr;
+    Py_INCREF(&s_regen_type);
+    if(PyModule_AddObject(m, "Regen", (PyObject*)&s_regen_type) < 0)
+    {
+        Py_DECREF(&s_regen_type);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
+
+#include <c4/c4_pop.hpp>
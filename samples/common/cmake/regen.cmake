@@ -1,64 +1,169 @@
 
+include(CMakeParseArguments)
+
+#------------------------------------------------------------------------------
+# the native regen executable, and the config used by regen_setup() and
+# c4regen_target(). These can be set before calling either.
+#
+#   REGEN_EXECUTABLE: the regen executable. Looked up in the PATH if not set.
+#   REGEN_CONFIG: the regen YAML config. Defaults to ${wdir}/regen.yml
+#   REGEN_FLAGS: the compiler flags used to parse the files.
+#                Defaults to -x c++ -std=c++11 -I ${wdir}
+
+
 #------------------------------------------------------------------------------
+# run a command and get its output as a list of lines
 function(_regen_capture_output output_var wdir)
-    set(cmd)
     #message(STATUS "executing command (at ${wdir}): ${ARGN}")
     execute_process(COMMAND ${ARGN}
         WORKING_DIRECTORY ${wdir}
         OUTPUT_VARIABLE out
         ERROR_VARIABLE err
         RESULT_VARIABLE res)
-    string(REPLACE "\n" "" out2 "${out}")
     if(NOT "${res}" STREQUAL "0")
         message(FATAL_ERROR "command failed (status=${res}): ${ARGN}. err=\n${err}")
     endif()
-    set(${output_var} ${out2} PARENT_SCOPE)
+    string(STRIP "${out}" out)
+    string(REPLACE "\n" ";" lines "${out}")
+    set(${output_var} ${lines} PARENT_SCOPE)
+endfunction()
+
+
+#------------------------------------------------------------------------------
+# find the executable, and get the config and the parse arguments for regen
+function(_regen_setup_args wdir cfg_var args_var)
+    if(NOT REGEN_EXECUTABLE)
+        find_program(REGEN_EXECUTABLE regen)
+        if(NOT REGEN_EXECUTABLE)
+            message(FATAL_ERROR "regen: could not find the regen executable. Set REGEN_EXECUTABLE.")
+        endif()
+    endif()
+    set(cfg ${REGEN_CONFIG})
+    if(NOT cfg)
+        set(cfg ${wdir}/regen.yml)
+    endif()
+    set(flags ${REGEN_FLAGS})
+    if(NOT flags)
+        set(flags -x c++ -std=c++11 -I ${wdir})
+    endif()
+    set(args --cfg ${cfg})
+    foreach(f ${flags})
+        list(APPEND args --flag ${f})
+    endforeach()
+    set(${cfg_var} ${cfg} PARENT_SCOPE)
+    set(${args_var} ${args} PARENT_SCOPE)
 endfunction()
 
 
 #------------------------------------------------------------------------------
+# depfiles are supported by the ninja generators, and by all
+# generators since cmake 3.20
+function(_regen_use_depfile var)
+    set(use OFF)
+    if(NOT (CMAKE_VERSION VERSION_LESS 3.20))
+        set(use ON)
+    elseif(CMAKE_GENERATOR MATCHES "Ninja" AND NOT (CMAKE_VERSION VERSION_LESS 3.7))
+        set(use ON)
+    endif()
+    set(${var} ${use} PARENT_SCOPE)
+endfunction()
+
+
+#------------------------------------------------------------------------------
+# find the files generated from all the files with a single call: pass
+# the file list in a response file, and get back one line per file with
+# <file>\t<output>\t<output>..., listing every file written for it. The
+# response file is rewritten only when the file list changes, so that it
+# can be used as a dependency. Only the names are used, so configuring
+# does not parse the files; the files written for an included header
+# are listed only when the header is in the list too (regen --map-headers
+# finds them, at the cost of a parse of every file).
+function(_regen_query_outputs map_var wdir rsp_file regen_args)
+    string(REPLACE ";" "\n" rsp_contents "${ARGN}")
+    file(WRITE ${rsp_file}.tmp "${rsp_contents}\n")
+    configure_file(${rsp_file}.tmp ${rsp_file} COPYONLY)
+    _regen_capture_output(map "${wdir}" ${REGEN_EXECUTABLE} --cmd outfiles --map ${regen_args} @${rsp_file})
+    set(${map_var} ${map} PARENT_SCOPE)
+endfunction()
+
+
+#------------------------------------------------------------------------------
+# split a line of the output map into the source file and the generated
+# headers and sources. The files written into the source file are not
+# outputs, so they are left out; whether any were is set in written_var.
+function(_regen_parse_map_line line source_var hdrs_var srcs_var written_var)
+    string(REPLACE "\t" ";" fields "${line}")
+    list(GET fields 0 r)
+    list(REMOVE_AT fields 0)
+    set(hdrs)
+    set(srcs)
+    set(written OFF)
+    foreach(g ${fields})
+        set(written ON)
+        if("${g}" STREQUAL "${r}")
+            # written into the source
+        elseif("${g}" MATCHES "\\.(c|cc|cpp|cxx)$")
+            list(APPEND srcs "${g}")
+        else()
+            list(APPEND hdrs "${g}")
+        endif()
+    endforeach()
+    set(${source_var} "${r}" PARENT_SCOPE)
+    set(${hdrs_var} ${hdrs} PARENT_SCOPE)
+    set(${srcs_var} ${srcs} PARENT_SCOPE)
+    set(${written_var} ${written} PARENT_SCOPE)
+endfunction()
+
+
+#------------------------------------------------------------------------------
+# generate the code of each file with its own regen command
 function(regen_setup wdir generated_headers generated_sources generated_targets)
     if(NOT TARGET regen)
         add_custom_target(regen)
     endif()
+    _regen_setup_args(${wdir} cfg regen_args)
+    _regen_use_depfile(use_depfile)
+
     message(STATUS "regen: checking dependencies...")
-    set(REGEN_FILE ${wdir}/regen.py)
-    set(REGEN_EXEC python3 ${REGEN_FILE})
-    set(REGEN_ARGS --clang-args "-std=c++11 -I ${wdir}")
+    string(MD5 rsp_hash "${wdir};${ARGN}")
+    _regen_query_outputs(map ${wdir} "${CMAKE_CURRENT_BINARY_DIR}/regen-${rsp_hash}.rsp" "${regen_args}" ${ARGN})
+
     set(hdrs)
     set(srcs)
-    foreach(r ${ARGN}) # for each file...
-        # find the files generated from this file
-        _regen_capture_output(ghdr "${wdir}" ${REGEN_EXEC} --show-hdr ${REGEN_ARGS} ${r})
-        _regen_capture_output(gsrc "${wdir}" ${REGEN_EXEC} --show-src ${REGEN_ARGS} ${r})
-        # if there are any generated sources...
-        if(NOT (ghdr OR gsrc))
+    set(tgts)
+    foreach(line ${map}) # for each file...
+        _regen_parse_map_line("${line}" r ghdrs gsrcs written)
+        # if there are any generated files...
+        if(NOT written)
             message(STATUS " ... regen: ${r}")
         else()
-            message(STATUS " ... regen: ${r}  ---->  ${ghdr} ${gsrc}")
-            set(fghdr "${wdir}/${ghdr}")
-            set(fgsrc "${wdir}/${gsrc}")
+            message(STATUS " ... regen: ${r}  ---->  ${ghdrs} ${gsrcs}")
             # since some writers can write into the source file and cmake
             # will see this as a circular dependency, always generate an
             # output file; only mark the output files as such if they're
             # not the source file
             set(done_file "${CMAKE_CURRENT_BINARY_DIR}/${r}.regen.done")
+            set(dep_file "${CMAKE_CURRENT_BINARY_DIR}/${r}.regen.d")
             set(output_files "${done_file}")
-            if(ghdr AND (NOT "${ghdr}" STREQUAL "${r}"))
-                list(APPEND output_files ${fghdr})
-            endif()
-            if(gsrc AND (NOT "${gsrc}" STREQUAL "${r}"))
-                list(APPEND output_files ${fgsrc})
+            foreach(g ${ghdrs} ${gsrcs})
+                list(APPEND output_files "${wdir}/${g}")
+            endforeach()
+            # with a depfile, regen reruns whenever any of the files it
+            # read (the source, its includes and the config) changes
+            set(depfile_args)
+            set(depfile_opts)
+            if(use_depfile)
+                set(depfile_args DEPFILE "${dep_file}")
+                set(depfile_opts --MF "${dep_file}" --MT "${done_file}")
             endif()
-            #message(STATUS "aqui 2 done_file=${done_file}")
-            #message(STATUS "aqui 3 output_files=${output_files}")
             # add a custom command to run regen
             add_custom_command(OUTPUT ${output_files}
-                DEPENDS "${r}" "${REGEN_FILE}" "${CMAKE_CURRENT_LIST_FILE}"
-                COMMAND ${REGEN_EXEC} --gen-code ${REGEN_ARGS} ${r}
+                DEPENDS "${r}" "${cfg}" "${REGEN_EXECUTABLE}" "${CMAKE_CURRENT_LIST_FILE}"
+                ${depfile_args}
+                COMMAND ${REGEN_EXECUTABLE} --cmd generate ${regen_args} ${depfile_opts} ${r}
                 COMMAND ${CMAKE_COMMAND} -E touch "${done_file}"
                 WORKING_DIRECTORY ${wdir}
-                COMMENT "regen@${CMAKE_CURRENT_SOURCE_DIR}: ${r}  ---->  ${ghdr} ${gsrc}")
+                COMMENT "regen@${CMAKE_CURRENT_SOURCE_DIR}: ${r}  ---->  ${ghdrs} ${gsrcs}")
             # see http://stackoverflow.com/questions/12913077/cmake-add-dependency-to-add-custom-command-dynamically
             # cannot add a dependency which is the OUTPUT of a custom command
             # but add_custom_target() allows non-existing dependencies in its
@@ -66,8 +171,12 @@ function(regen_setup wdir generated_headers generated_sources generated_targets)
             add_custom_target(${r}-regen-target DEPENDS ${done_file})
             add_dependencies(regen ${r}-regen-target)
             # save the names
-            list(APPEND hdrs ${fghdr})
-            list(APPEND srcs ${fgsrc})
+            foreach(g ${ghdrs})
+                list(APPEND hdrs "${wdir}/${g}")
+            endforeach()
+            foreach(g ${gsrcs})
+                list(APPEND srcs "${wdir}/${g}")
+            endforeach()
             list(APPEND tgts ${r}-regen-target)
         endif()
     endforeach()
@@ -75,3 +184,86 @@ function(regen_setup wdir generated_headers generated_sources generated_targets)
     set(${generated_sources} ${srcs} PARENT_SCOPE)
     set(${generated_targets} ${tgts} PARENT_SCOPE)
 endfunction()
+
+
+#------------------------------------------------------------------------------
+# generate the code of all the given files of a target with a single
+# regen command, which parses the files in parallel and leaves untouched
+# the generated files whose contents did not change. The generated
+# sources and headers are added to the target.
+#
+#   c4regen_target(<target>
+#       FILES <file>...            # the files to generate code from
+#       [CONFIG <regen.yml>]       # defaults to REGEN_CONFIG
+#       [FLAGS <flag>...]          # defaults to REGEN_FLAGS
+#       [JOBS <n>]                 # defaults to 0, ie one per core
+#       [WORKING_DIRECTORY <dir>]  # defaults to CMAKE_CURRENT_SOURCE_DIR
+#   )
+#
+# The file names are relative to the working directory.
+function(c4regen_target target)
+    cmake_parse_arguments(_rg "" "CONFIG;JOBS;WORKING_DIRECTORY" "FILES;FLAGS" ${ARGN})
+    set(wdir ${_rg_WORKING_DIRECTORY})
+    if(NOT wdir)
+        set(wdir ${CMAKE_CURRENT_SOURCE_DIR})
+    endif()
+    if(_rg_CONFIG)
+        set(REGEN_CONFIG ${_rg_CONFIG})
+    endif()
+    if(_rg_FLAGS)
+        set(REGEN_FLAGS ${_rg_FLAGS})
+    endif()
+    set(jobs 0)
+    if(NOT "${_rg_JOBS}" STREQUAL "")
+        set(jobs ${_rg_JOBS})
+    endif()
+    if(NOT TARGET regen)
+        add_custom_target(regen)
+    endif()
+    _regen_setup_args(${wdir} cfg regen_args)
+    _regen_use_depfile(use_depfile)
+
+    set(rsp_file "${CMAKE_CURRENT_BINARY_DIR}/${target}.regen.rsp")
+    set(stamp_file "${CMAKE_CURRENT_BINARY_DIR}/${target}.regen.stamp")
+    set(dep_file "${CMAKE_CURRENT_BINARY_DIR}/${target}.regen.d")
+    _regen_query_outputs(map ${wdir} ${rsp_file} "${regen_args}" ${_rg_FILES})
+
+    # the stamp goes first, as the depfile refers to it
+    set(output_files "${stamp_file}")
+    set(inputs)
+    set(hdrs)
+    set(srcs)
+    foreach(line ${map})
+        _regen_parse_map_line("${line}" r ghdrs gsrcs written)
+        list(APPEND inputs "${wdir}/${r}")
+        foreach(g ${ghdrs})
+            list(APPEND output_files "${wdir}/${g}")
+            list(APPEND hdrs "${wdir}/${g}")
+        endforeach()
+        foreach(g ${gsrcs})
+            list(APPEND output_files "${wdir}/${g}")
+            list(APPEND srcs "${wdir}/${g}")
+        endforeach()
+    endforeach()
+    list(LENGTH inputs num_inputs)
+    message(STATUS "regen: ${target}: ${num_inputs} files")
+
+    set(depfile_args)
+    set(depfile_opts)
+    if(use_depfile)
+        set(depfile_args DEPFILE "${dep_file}")
+        set(depfile_opts --MF "${dep_file}" --MT "${stamp_file}")
+    endif()
+    add_custom_command(OUTPUT ${output_files}
+        DEPENDS ${inputs} "${cfg}" "${rsp_file}" "${REGEN_EXECUTABLE}"
+        ${depfile_args}
+        COMMAND ${REGEN_EXECUTABLE} --cmd generate --jobs ${jobs} ${regen_args} ${depfile_opts} @${rsp_file}
+        COMMAND ${CMAKE_COMMAND} -E touch "${stamp_file}"
+        WORKING_DIRECTORY ${wdir}
+        COMMENT "regen@${CMAKE_CURRENT_SOURCE_DIR}: ${target}: ${num_inputs} files"
+        VERBATIM)
+    add_custom_target(${target}-regen DEPENDS ${stamp_file})
+    add_dependencies(regen ${target}-regen)
+    add_dependencies(${target} ${target}-regen)
+    target_sources(${target} PRIVATE ${hdrs} ${srcs})
+endfunction()
@@ -4,6 +4,7 @@
 #include "util.hpp"
 #include <cstring>
 #include <iterator>
+#include <type_traits>
 
 typedef enum : uint8_t {
     EOFFS_NONE = 0,
@@ -12,10 +13,54 @@ typedef enum : uint8_t {
     _EOFFS_LAST      //< reserved
 } EnumOffsetType;
 
+typedef enum : uint8_t {
+    ELOOKUP_LINEAR = 0, //< compare the value of each symbol
+    ELOOKUP_DENSE = 1,  //< index a table with the value
+    ELOOKUP_SORTED = 2, //< binary search the values
+} EnumLookupType;
+
+//-----------------------------------------------------------------------------
+/** How EnumSymbols< T >::find(T) finds a symbol by value. The default is
+ * a linear search. Regen decides from the values of the symbols, and
+ * generates a specialization for each enum type:
+ *
+ * - ELOOKUP_DENSE: the values fill most of [vmin, vmin+size). index()
+ *   has size entries: the position in esyms< T >() of the symbol with
+ *   the value vmin+i, or -1.
+ * - ELOOKUP_SORTED: index() has size entries: the positions in
+ *   esyms< T >() of the symbols, sorted by value.
+ *
+ * @begincode
+ * template<> struct EnumLookup< MyEnum >
+ * {
+ *     using I = std::underlying_type< MyEnum >::type;
+ *     static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+ *     static constexpr const I vmin = 0;
+ *     static constexpr const size_t size = 3;
+ *     static const int32_t* index();
+ * };
+ * @endcode
+ *
+ * The positions refer to the symbols of esyms< T >(), so the lookup is
+ * only used for the EnumSymbols object obtained from it.
+ *
+ * @warning find(T) picks the lookup from the specialization visible where
+ * it is instantiated, so the specialization must be visible wherever
+ * esyms< T >() is: a translation unit which does not see it would
+ * instantiate the linear search instead, breaking the one definition
+ * rule. The regen samples emit it in the same generated code as the
+ * declaration of esyms< T >(). */
+template< class T >
+struct EnumLookup
+{
+    static constexpr const EnumLookupType type = ELOOKUP_LINEAR;
+};
+
 //-----------------------------------------------------------------------------
 /** A simple (proxy) container for the value-name pairs of an enum type.
- * Uses linear search for finds; this could be improved for time-critical
- * code. */
+ * Finds by value use the lookup generated for the enum type, which is
+ * constant time or logarithmic; see EnumLookup. Finds by name use linear
+ * search. */
 template< class T >
 class EnumSymbols
 {
@@ -52,12 +97,23 @@ public:
 
     Sym const& operator[] (size_t i) { C4_CHECK(i < m_num); return m_symbols[i]; }
 
+    Sym const* data() const { return m_symbols; }
+
     Sym const* begin() const { return m_symbols; }
     Sym const* end  () const { return m_symbols + m_num; }
 
     const_reverse_iterator rbegin() const { return const_reverse_iterator(m_symbols + m_num); }
     const_reverse_iterator rend  () const { return const_reverse_iterator(m_symbols); }
 
+private:
+
+    template< EnumLookupType L >
+    using lookup_tag = std::integral_constant< EnumLookupType, L >;
+
+    Sym const* _find(T v, lookup_tag< ELOOKUP_LINEAR >) const;
+    Sym const* _find(T v, lookup_tag< ELOOKUP_DENSE  >) const;
+    Sym const* _find(T v, lookup_tag< ELOOKUP_SORTED >) const;
+
 private:
 
     Sym const* m_symbols;
@@ -156,6 +212,12 @@ const char* e2stroffs(T e, EnumOffsetType ot = EOFFS_PFX)
 /** Find a symbol by value. Returns nullptr when none is found */
 template< class T >
 typename EnumSymbols< T >::Sym const* EnumSymbols< T >::find(T v) const
+{
+    return _find(v, lookup_tag< EnumLookup< T >::type >());
+}
+
+template< class T >
+typename EnumSymbols< T >::Sym const* EnumSymbols< T >::_find(T v, lookup_tag< ELOOKUP_LINEAR >) const
 {
     for(Sym const* p = this->m_symbols, *e = p+this->m_num; p < e; ++p)
         if(p->value == v)
@@ -163,6 +225,45 @@ typename EnumSymbols< T >::Sym const* EnumSymbols< T >::find(T v) const
     return nullptr;
 }
 
+template< class T >
+typename EnumSymbols< T >::Sym const* EnumSymbols< T >::_find(T v, lookup_tag< ELOOKUP_DENSE >) const
+{
+    using L = EnumLookup< T >;
+    using I = typename std::underlying_type< T >::type;
+    using U = typename std::make_unsigned< I >::type;
+    // values below vmin wrap around to above size
+    size_t i = (size_t)(U)((U)(I)v - (U)L::vmin);
+    if(i >= L::size)
+        return nullptr;
+    int32_t pos = L::index()[i];
+    if(pos < 0)
+        return nullptr;
+    C4_ASSERT((size_t)pos < this->m_num);
+    return this->m_symbols + pos;
+}
+
+template< class T >
+typename EnumSymbols< T >::Sym const* EnumSymbols< T >::_find(T v, lookup_tag< ELOOKUP_SORTED >) const
+{
+    using L = EnumLookup< T >;
+    using I = typename std::underlying_type< T >::type;
+    int32_t const* idx = L::index();
+    size_t lo = 0, hi = L::size;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        C4_ASSERT((size_t)idx[mid] < this->m_num);
+        Sym const* p = this->m_symbols + idx[mid];
+        if((I)p->value < (I)v)
+            lo = mid + 1;
+        else if((I)v < (I)p->value)
+            hi = mid;
+        else
+            return p;
+    }
+    return nullptr;
+}
+
 /** Find a symbol by name. Returns nullptr when none is found */
 template< class T >
 typename EnumSymbols< T >::Sym const* EnumSymbols< T >::find(const char *s) const
@@ -1,3 +1,4 @@
+#include <initializer_list>
 #include <iostream>
 #include <vector>
 
@@ -111,3 +112,145 @@ void test_bm2str()
         } // while(1)
     } // for k
 }
+
+/** find each symbol by value, and check that the values in misses are
+ * not found. When several symbols have the same value, the first one is
+ * found. */
+template< typename E >
+void test_find(std::initializer_list< E > misses)
+{
+    using Sym = typename EnumSymbols< E >::Sym;
+    auto syms = esyms< E >();
+    for(auto &p : syms)
+    {
+        Sym const* first = &p;
+        for(auto &q : syms)
+        {
+            if(q.value == p.value)
+            {
+                first = &q;
+                break;
+            }
+        }
+        EXPECT_EQ(syms.find(p.value), first);
+    }
+    for(E v : misses)
+    {
+        EXPECT_EQ(syms.find(v), (Sym const*)nullptr);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// enums with the lookups which regen generates for their values, written
+// here by hand to test each path of EnumSymbols< T >::find(T)
+
+// dense: a table for [2,5], with a hole and a repeated value
+typedef enum {
+    LD_A = 2,
+    LD_B = 3,
+    LD_C = 5,
+    LD_D = 3,
+} LookupDense;
+
+template<> struct EnumLookup< LookupDense >
+{
+    using I = std::underlying_type< LookupDense >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 2;
+    static constexpr const size_t size = 4;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, 1, -1, 2, };
+        return idx;
+    }
+};
+
+template<> const EnumSymbols< LookupDense > esyms()
+{
+    static const EnumSymbols< LookupDense >::Sym vals[] = {
+        { LD_A, "LD_A"},
+        { LD_B, "LD_B"},
+        { LD_C, "LD_C"},
+        { LD_D, "LD_D"},
+    };
+    EnumSymbols< LookupDense > r(vals);
+    return r;
+}
+
+// dense with negative values: a table for [-3,2]
+enum class LookupNegative : int8_t {
+    A = -3,
+    B = -1,
+    C = 0,
+    D = 2,
+};
+
+template<> struct EnumLookup< LookupNegative >
+{
+    using I = std::underlying_type< LookupNegative >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = -3;
+    static constexpr const size_t size = 6;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, -1, 1, 2, -1, 3, };
+        return idx;
+    }
+};
+
+template<> const EnumSymbols< LookupNegative > esyms()
+{
+    static const EnumSymbols< LookupNegative >::Sym vals[] = {
+        { LookupNegative::A, "LookupNegative::A"},
+        { LookupNegative::B, "LookupNegative::B"},
+        { LookupNegative::C, "LookupNegative::C"},
+        { LookupNegative::D, "LookupNegative::D"},
+    };
+    EnumSymbols< LookupNegative > r(vals);
+    return r;
+}
+
+// sorted: sparse values, declared out of order, with a repeated value
+enum class LookupSorted : int32_t {
+    B = 7,
+    C = 1000000,
+    A = -100000,
+    D = 7,
+};
+
+template<> struct EnumLookup< LookupSorted >
+{
+    using I = std::underlying_type< LookupSorted >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_SORTED;
+    static constexpr const I vmin = -100000;
+    static constexpr const size_t size = 3;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 2, 0, 1, };
+        return idx;
+    }
+};
+
+template<> const EnumSymbols< LookupSorted > esyms()
+{
+    static const EnumSymbols< LookupSorted >::Sym vals[] = {
+        { LookupSorted::B, "LookupSorted::B"},
+        { LookupSorted::C, "LookupSorted::C"},
+        { LookupSorted::A, "LookupSorted::A"},
+        { LookupSorted::D, "LookupSorted::D"},
+    };
+    EnumSymbols< LookupSorted > r(vals);
+    return r;
+}
+
+void test_lookups()
+{
+    // below, in the holes of and above the table. The values below vmin
+    // wrap around to above the table.
+    test_find< LookupDense >({(LookupDense)0, (LookupDense)1, (LookupDense)4, (LookupDense)6, (LookupDense)-1});
+    test_find< LookupNegative >({(LookupNegative)-128, (LookupNegative)-4, (LookupNegative)-2,
+                                 (LookupNegative)1, (LookupNegative)3, (LookupNegative)127});
+    // below, between and above the values
+    test_find< LookupSorted >({(LookupSorted)-100001, (LookupSorted)0, (LookupSorted)8,
+                               (LookupSorted)999999, (LookupSorted)1000001});
+}
@@ -3,6 +3,11 @@
 #include "myenum.gen.hpp"
 
 /** enum: auto-generated from myenum.hpp:7: C4_ENUM: MyEnum */
+const int32_t* EnumLookup< MyEnum >::index()
+{
+    static const int32_t idx[] = { 0, 1, 2, };
+    return idx;
+}
 template<> const EnumSymbols< MyEnum > esyms()
 {
     static const EnumSymbols< MyEnum >::Sym vals[] = {
@@ -14,6 +19,11 @@ template<> const EnumSymbols< MyEnum > esyms()
     return r;
 }
 /** enum: auto-generated from myenum.hpp:14: C4_ENUM: MyEnumClass */
+const int32_t* EnumLookup< MyEnumClass >::index()
+{
+    static const int32_t idx[] = { 0, 1, 2, };
+    return idx;
+}
 template<> const EnumSymbols< MyEnumClass > esyms()
 {
     static const EnumSymbols< MyEnumClass >::Sym vals[] = {
@@ -25,6 +35,11 @@ template<> const EnumSymbols< MyEnumClass > esyms()
     return r;
 }
 /** enum: auto-generated from myenum.hpp:21: C4_ENUM: MyBitmask */
+const int32_t* EnumLookup< MyBitmask >::index()
+{
+    static const int32_t idx[] = { 0, 1, 2, 4, 3, -1, -1, 5, };
+    return idx;
+}
 template<> const EnumSymbols< MyBitmask > esyms()
 {
     static const EnumSymbols< MyBitmask >::Sym vals[] = {
@@ -39,6 +54,11 @@ template<> const EnumSymbols< MyBitmask > esyms()
     return r;
 }
 /** enum: auto-generated from myenum.hpp:31: C4_ENUM: MyBitmaskClass */
+const int32_t* EnumLookup< MyBitmaskClass >::index()
+{
+    static const int32_t idx[] = { 0, 1, 2, 4, 3, -1, -1, 5, };
+    return idx;
+}
 template<> const EnumSymbols< MyBitmaskClass > esyms()
 {
     static const EnumSymbols< MyBitmaskClass >::Sym vals[] = {
@@ -7,9 +7,25 @@
 
 /** enum: auto-generated from myenum.hpp:7: C4_ENUM: MyEnum */
 template<> const EnumSymbols< MyEnum > esyms();
+template<> struct EnumLookup< MyEnum >
+{
+    using I = std::underlying_type< MyEnum >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 3;
+    static const int32_t* index();
+};
 
 /** enum: auto-generated from myenum.hpp:14: C4_ENUM: MyEnumClass */
 template<> const EnumSymbols< MyEnumClass > esyms();
+template<> struct EnumLookup< MyEnumClass >
+{
+    using I = std::underlying_type< MyEnumClass >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 3;
+    static const int32_t* index();
+};
 template<> inline size_t eoffs_cls< MyEnumClass >()
 {
     // same as strlen("MyEnumClass::")
@@ -18,6 +34,14 @@ template<> inline size_t eoffs_cls< MyEnumClass >()
 
 /** enum: auto-generated from myenum.hpp:21: C4_ENUM: MyBitmask */
 template<> const EnumSymbols< MyBitmask > esyms();
+template<> struct EnumLookup< MyBitmask >
+{
+    using I = std::underlying_type< MyBitmask >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 8;
+    static const int32_t* index();
+};
 template<> inline size_t eoffs_pfx< MyBitmask >()
 {
     // same as strlen("BM_")
@@ -26,6 +50,14 @@ template<> inline size_t eoffs_pfx< MyBitmask >()
 
 /** enum: auto-generated from myenum.hpp:31: C4_ENUM: MyBitmaskClass */
 template<> const EnumSymbols< MyBitmaskClass > esyms();
+template<> struct EnumLookup< MyBitmaskClass >
+{
+    using I = std::underlying_type< MyBitmaskClass >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 8;
+    static const int32_t* index();
+};
 template<> inline size_t eoffs_cls< MyBitmaskClass >()
 {
     // same as strlen("MyBitmaskClass::")
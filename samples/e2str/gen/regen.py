@@ -5,6 +5,16 @@ import c4.regen as regen
 egen = regen.EnumGenerator(
     hdr="""
 template<> const EnumSymbols< {{enum.type}} > esyms();
+{% if enum.lookup != "linear" %}
+template<> struct EnumLookup< {{enum.type}} >
+{
+    using I = std::underlying_type< {{enum.type}} >::type;
+    static constexpr const EnumLookupType type = {% if enum.lookup == "dense" %}ELOOKUP_DENSE{% else %}ELOOKUP_SORTED{% endif %};
+    static constexpr const I vmin = {{enum.value_min}};
+    static constexpr const size_t size = {{enum.lookup_size}};
+    static const int32_t* index();
+};
+{% endif %}
 {% if enum.class_offset > 0 %}
 template<> inline size_t eoffs_cls< {{enum.type}} >()
 {
@@ -21,6 +31,13 @@ template<> inline size_t eoffs_pfx< {{enum.type}} >()
 {% endif %}
 """,
     src="""
+{% if enum.lookup != "linear" %}
+const int32_t* EnumLookup< {{enum.type}} >::index()
+{
+    static const int32_t idx[] = { {% for i in enum.lookup_index %}{{i.pos}}, {% endfor %}};
+    return idx;
+}
+{% endif %}
 template<> const EnumSymbols< {{enum.type}} > esyms()
 {
     static const EnumSymbols< {{enum.type}} >::Sym vals[] = {
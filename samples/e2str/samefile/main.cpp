@@ -76,5 +76,14 @@ int main(int argc, const char* argv[])
     test_bm2str< MyBitmask >();
     test_bm2str< MyBitmaskClass >();
 
+    // the lookups are generated with esyms(), so find() uses them
+    static_assert(EnumLookup< MyEnum >::type == ELOOKUP_DENSE, "");
+    static_assert(EnumLookup< MyBitmaskClass >::type == ELOOKUP_DENSE, "");
+    test_find< MyEnum >({(MyEnum)3});
+    test_find< MyEnumClass >({(MyEnumClass)3});
+    test_find< MyBitmask >({(MyBitmask)5, (MyBitmask)6, (MyBitmask)8});
+    test_find< MyBitmaskClass >({(MyBitmaskClass)5, (MyBitmaskClass)6, (MyBitmaskClass)8});
+    test_lookups();
+
     return error_status;
 }
@@ -40,6 +40,18 @@ enum class MyBitmaskClass {
 
 // regen:GENERATED:(BEGIN). DO NOT EDIT THE BLOCK BELOW. WILL BE OVERWRITTEN!
 /** enum: auto-generated from myenum.hpp:7: C4_ENUM: MyEnum */
+template<> struct EnumLookup< MyEnum >
+{
+    using I = std::underlying_type< MyEnum >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 3;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, 1, 2, };
+        return idx;
+    }
+};
 template<> inline const EnumSymbols< MyEnum > esyms()
 {
     static const EnumSymbols< MyEnum >::Sym vals[] = {
@@ -52,6 +64,18 @@ template<> inline const EnumSymbols< MyEnum > esyms()
 }
 
 /** enum: auto-generated from myenum.hpp:14: C4_ENUM: MyEnumClass */
+template<> struct EnumLookup< MyEnumClass >
+{
+    using I = std::underlying_type< MyEnumClass >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 3;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, 1, 2, };
+        return idx;
+    }
+};
 template<> inline const EnumSymbols< MyEnumClass > esyms()
 {
     static const EnumSymbols< MyEnumClass >::Sym vals[] = {
@@ -69,6 +93,18 @@ template<> inline size_t eoffs_cls< MyEnumClass >()
 }
 
 /** enum: auto-generated from myenum.hpp:21: C4_ENUM: MyBitmask */
+template<> struct EnumLookup< MyBitmask >
+{
+    using I = std::underlying_type< MyBitmask >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 8;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, 1, 2, 4, 3, -1, -1, 5, };
+        return idx;
+    }
+};
 template<> inline const EnumSymbols< MyBitmask > esyms()
 {
     static const EnumSymbols< MyBitmask >::Sym vals[] = {
@@ -89,6 +125,18 @@ template<> inline size_t eoffs_pfx< MyBitmask >()
 }
 
 /** enum: auto-generated from myenum.hpp:31: C4_ENUM: MyBitmaskClass */
+template<> struct EnumLookup< MyBitmaskClass >
+{
+    using I = std::underlying_type< MyBitmaskClass >::type;
+    static constexpr const EnumLookupType type = ELOOKUP_DENSE;
+    static constexpr const I vmin = 0;
+    static constexpr const size_t size = 8;
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { 0, 1, 2, 4, 3, -1, -1, 5, };
+        return idx;
+    }
+};
 template<> inline const EnumSymbols< MyBitmaskClass > esyms()
 {
     static const EnumSymbols< MyBitmaskClass >::Sym vals[] = {
@@ -4,6 +4,20 @@ import c4.regen as regen
 
 egen = regen.EnumGenerator(
     inl="""
+{% if enum.lookup != "linear" %}
+template<> struct EnumLookup< {{enum.type}} >
+{
+    using I = std::underlying_type< {{enum.type}} >::type;
+    static constexpr const EnumLookupType type = {% if enum.lookup == "dense" %}ELOOKUP_DENSE{% else %}ELOOKUP_SORTED{% endif %};
+    static constexpr const I vmin = {{enum.value_min}};
+    static constexpr const size_t size = {{enum.lookup_size}};
+    static const int32_t* index()
+    {
+        static const int32_t idx[] = { {% for i in enum.lookup_index %}{{i.pos}}, {% endfor %}};
+        return idx;
+    }
+};
+{% endif %}
 template<> inline const EnumSymbols< {{enum.type}} > esyms()
 {
     static const EnumSymbols< {{enum.type}} >::Sym vals[] = {
@@ -227,9 +227,8 @@ inline CXChildVisitResult detail::_visit_impl(CXCursor cursor, CXCursor parent,
 //-----------------------------------------------------------------------------
 
 //! The returned csubstr is zero-terminated!
-const char* StringCollection::store(CXString s)
+const char* StringCollection::store(csubstr ss)
 {
-    csubstr ss = to_csubstr(clang_getCString(s));
     if(ss.empty()) return "";
 
     // insert a page with an appropriate capacity
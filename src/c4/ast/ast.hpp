@@ -164,7 +164,37 @@ struct StringCollection
 {
 
     //! The returned csubstr is zero-terminated!
-    const char* store(CXString s);
+    const char* store(CXString s) { return store(to_csubstr(clang_getCString(s))); }
+    //! The returned csubstr is zero-terminated!
+    const char* store(csubstr s);
+
+    /** drop all the strings, keeping the first page for reuse */
+    void clear()
+    {
+        m_strings.clear();
+        if(m_pages.size() > 1)
+        {
+            m_pages.resize(1);
+        }
+        if( ! m_pages.empty())
+        {
+            m_pages[0].clear();
+        }
+    }
+
+    /** take over the strings of another collection. The strings are not
+     * relocated, so pointers to them remain valid. */
+    void merge(StringCollection &&that)
+    {
+        m_strings.insert(m_strings.end(), that.m_strings.begin(), that.m_strings.end());
+        m_pages.reserve(m_pages.size() + that.m_pages.size());
+        for(auto &pg : that.m_pages)
+        {
+            m_pages.emplace_back(std::move(pg));
+        }
+        that.m_strings.clear();
+        that.m_pages.clear();
+    }
 
     // use pages to ensure that no string is relocated
     std::vector<csubstr> m_strings;
@@ -242,6 +272,11 @@ public:
         return m_strings.store(s);
     }
 
+    const char* store_str(csubstr s)
+    {
+        return m_strings.store(s);
+    }
+
     /** move out the string collection for later use */
     StringCollection&& yield_strings()
     {
@@ -380,6 +415,17 @@ struct Cursor : public CXCursor
     const char* kind_spelling(Index &idx) const { return idx.store_str(clang_getCursorKindSpelling(kind())); }
     const char*   raw_comment(Index &idx) const { return idx.store_str(clang_Cursor_getRawCommentText(*this)); }
     const char* brief_comment(Index &idx) const { return idx.store_str(clang_Cursor_getBriefCommentText(*this)); }
+    const char*           usr(Index &idx) const { return idx.store_str(clang_getCursorUSR(*this)); }
+    const char*     file_name(Index &idx) const { return idx.store_str(clang_getFileName(file())); }
+
+    /** the file where this cursor is expanded */
+    CXFile file() const
+    {
+        CXFile f = nullptr;
+        clang_getExpansionLocation(clang_getCursorLocation(*this), &f, nullptr, nullptr, nullptr);
+        return f;
+    }
+    bool is_in_system_header() const { return clang_Location_isInSystemHeader(clang_getCursorLocation(*this)) != 0; }
 
     void print_recursive(const char* msg=nullptr, unsigned indent=0) const;
     void print(const char* msg=nullptr, unsigned indent=0) const;
@@ -472,6 +518,8 @@ struct TranslationUnit : pimpl_handle<CXTranslationUnit>
 {
     Index *m_index;
     std::vector<char> m_contents;
+    CXFile m_main_file{nullptr};
+    std::vector<CXUnsavedFile> m_unsaved;
 
 public:
 
@@ -510,6 +558,7 @@ public:
     void clear()
     {
         m_contents.clear();
+        m_main_file = nullptr;
         if(m_handle)
         {
             clang_disposeTranslationUnit(m_handle);
@@ -536,6 +585,38 @@ public:
         this->_parse_argv(idx, filename, cmds, cmds_sz, options);
     }
 
+    /** parse an in-memory buffer as if it were the contents of the given
+     * file, without touching the filesystem. Further overlays
+     * (eg for modified headers) can be given in unsaved. */
+    void reset(Index &idx, const char *filename, csubstr contents, const char * const* cmds, size_t cmds_sz, CXUnsavedFile const* unsaved=nullptr, size_t num_unsaved=0, unsigned options=default_options)
+    {
+        clear();
+        m_index = &idx;
+        m_contents.assign(contents.begin(), contents.end());
+        m_unsaved.clear();
+        m_unsaved.push_back(CXUnsavedFile{filename, m_contents.data(), (unsigned long)m_contents.size()});
+        m_unsaved.insert(m_unsaved.end(), unsaved, unsaved + num_unsaved);
+        this->_parse2(idx, filename, cmds, cmds_sz, options, m_unsaved.data(), m_unsaved.size());
+    }
+
+    /** load a unit previously serialized with save(), instead of parsing
+     * the source file.
+     * @return false if the serialized unit could not be loaded */
+    bool reset_from_ast(Index &idx, const char *filename, const char *ast_filename)
+    {
+        clear();
+        m_index = &idx;
+        CXErrorCode err = clang_createTranslationUnit2(idx, ast_filename, &m_handle);
+        if(err != CXError_Success || m_handle == nullptr)
+        {
+            m_handle = nullptr;
+            return false;
+        }
+        c4::fs::file_get_contents(filename, &m_contents);
+        _set_main_file();
+        return true;
+    }
+
     void reset(Index &idx, const char *filename, CompilationDb const& db, unsigned options=default_options)
     {
         clear();
@@ -559,18 +640,27 @@ private:
                                     options,
                                     &m_handle);
         check_err(err, m_handle);
+        _set_main_file();
     }
 
-    void _parse2(Index &idx, const char *filename, const char * const* cmds, size_t cmds_sz, unsigned options)
+    void _parse2(Index &idx, const char *filename, const char * const* cmds, size_t cmds_sz, unsigned options, CXUnsavedFile *unsaved=nullptr, size_t num_unsaved=0)
     {
-        C4_ASSERT(fs::path_exists(filename));
+        C4_ASSERT(num_unsaved > 0 || fs::path_exists(filename));
         CXErrorCode err = clang_parseTranslationUnit2(idx,
                                     filename, //nullptr informs that the filename is in the args
                                     cmds, (unsigned)cmds_sz,
-                                    nullptr, 0,
+                                    unsaved, (unsigned)num_unsaved,
                                     options,
                                     &m_handle);
         check_err(err, m_handle);
+        _set_main_file();
+    }
+
+    void _set_main_file()
+    {
+        CXString s = clang_getTranslationUnitSpelling(m_handle);
+        m_main_file = clang_getFile(m_handle, clang_getCString(s));
+        clang_disposeString(s);
     }
 
 public:
@@ -597,11 +687,52 @@ public:
         return clang_getTranslationUnitCursor(m_handle);
     }
 
+    /** get the contents of a file participating in this unit. For the
+     * main file, this is the buffer read before parsing; for included
+     * files, it is the buffer already loaded by libclang, so no files
+     * are read again. */
+    csubstr file_contents(CXFile f) const
+    {
+        if(f == nullptr) return {};
+        if(m_main_file && clang_File_isEqual(f, m_main_file)) return to_csubstr(m_contents);
+        size_t sz = 0;
+        const char *s = clang_getFileContents(m_handle, f, &sz);
+        return s ? csubstr(s, sz) : csubstr{};
+    }
+
+    csubstr file_contents(const char *filename) const
+    {
+        if(filename == nullptr || filename[0] == '\0') return {};
+        return file_contents(clang_getFile(m_handle, filename));
+    }
+
     void visit_children(visitor_pfn visitor, void *data=nullptr, bool same_unit_only=true) const
     {
         c4::ast::visit_children(root(), visitor, data, same_unit_only);
     }
 
+    /** get the names of all the files participating in this unit,
+     * including the main file */
+    void inclusions(std::vector<std::string> $ files) const
+    {
+        files->clear();
+        clang_getInclusions(m_handle, [](CXFile f, CXSourceLocation *stack, unsigned stack_len, CXClientData data){
+            C4_UNUSED(stack);
+            C4_UNUSED(stack_len);
+            CXString s = clang_getFileName(f);
+            ((std::vector<std::string> $)data)->emplace_back(clang_getCString(s));
+            clang_disposeString(s);
+        }, files);
+    }
+
+    /** serialize this unit into a file, eg to use it as a precompiled
+     * header. */
+    void save(const char *filename) const
+    {
+        int err = clang_saveTranslationUnit(m_handle, filename, clang_defaultSaveOptions(m_handle));
+        C4_CHECK_MSG(err == CXSaveError_None, "could not save translation unit to %s", filename);
+    }
+
 public:
 
     size_t select(CursorMatcher m, std::vector<Entity> *v, bool same_unit_only=true) const
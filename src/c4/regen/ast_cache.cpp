@@ -0,0 +1,82 @@
+#include "c4/regen/ast_cache.hpp"
+
+#include "c4/regen/hash.hpp"
+#include "c4/regen/manifest.hpp"
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void AstCache::load(c4::yml::NodeRef const root)
+{
+    m_dir.clear();
+    csubstr dir;
+    root.get_if("ast_cache", &dir);
+    set_dir(dir);
+}
+
+bool AstCache::load(ast::TranslationUnit $ unit, ast::Index $$ idx, const char *filename, const char* const* args, size_t num_args, std::string $ entry)
+{
+    entry->clear();
+    if( ! enabled()) return false;
+
+    Hasher h;
+    {
+        CXString v = clang_getClangVersion();
+        h(to_csubstr(clang_getCString(v)));
+        clang_disposeString(v);
+    }
+    h(to_csubstr(filename));
+    for(size_t i = 0; i < num_args; ++i)
+    {
+        h(to_csubstr(args[i]));
+    }
+    // the file itself is in the manifest, which is checked without
+    // reading the files which did not change
+    *entry = m_dir + "/" + h.hex();
+
+    std::string ast_file = *entry + ".ast";
+    std::string mnf_file = *entry + ".deps";
+    FileManifest mnf;
+    if(c4::fs::path_exists(ast_file.c_str()) && mnf.load(mnf_file.c_str()) && mnf.is_current())
+    {
+        if(unit->reset_from_ast(idx, filename, ast_file.c_str()))
+        {
+            ++m_num_hits;
+            return true;
+        }
+    }
+    ++m_num_misses;
+    return false;
+}
+
+void AstCache::store(ast::TranslationUnit c$$ unit, std::string c$$ entry, const char* const* args, size_t num_args)
+{
+    if(entry.empty()) return;
+    std::string dir = m_dir;
+    c4::fs::mkdirs(&dir[0]);
+    std::string ast_file = entry + ".ast";
+    std::string mnf_file = entry + ".deps";
+    unit.save(ast_file.c_str());
+    std::vector<std::string> inclusions;
+    unit.inclusions(&inclusions);
+    // a pch is rebuilt in place when its headers change, so its name in
+    // the flags does not identify its contents
+    for(size_t i = 0; i + 1 < num_args; ++i)
+    {
+        if(to_csubstr(args[i]) == "-include-pch")
+        {
+            inclusions.emplace_back(args[i + 1]);
+        }
+    }
+    FileManifest mnf;
+    mnf.add_files(inclusions);
+    mnf.save(mnf_file.c_str());
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,64 @@
+#ifndef _c4_REGEN_AST_CACHE_HPP_
+#define _c4_REGEN_AST_CACHE_HPP_
+
+#include <atomic>
+#include <string>
+
+#include <c4/yml/node.hpp>
+#include "c4/ast/ast.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** Persists each parsed unit as an .ast file, and reloads it instead of
+ * parsing when the source file, its includes and its flags did not
+ * change. This makes iterating on the generator templates cheap, as the
+ * sources are then not parsed again.
+ *
+ * The cache entry is named after a hash of the clang version, the file
+ * name and the flags. A manifest next to it records the file, each of
+ * its includes and the pch it was parsed with, if any; the entry is
+ * used only when the manifest is current.
+ * As the manifest is checked with the size and the time of the files,
+ * a hit does not read the sources. @see FileManifest
+ *
+ * YAML config example (this can also be set with --ast-cache):
+ *
+ * @begincode
+ * ast_cache: build/c4regen/ast
+ * @endcode
+ */
+struct AstCache
+{
+    std::string m_dir;
+    std::atomic<size_t> m_num_hits{0};
+    std::atomic<size_t> m_num_misses{0};
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+    void set_dir(csubstr dir) { m_dir.assign(dir.str, dir.len); }
+
+    bool enabled() const { return ! m_dir.empty(); }
+
+    /** try to load the unit for the file from the cache. This can be
+     * called concurrently from several threads.
+     * @param entry receives the base name of the cache entry for the file
+     * @return true on a cache hit. Otherwise, the caller should parse the
+     * unit and then call store() with the entry. */
+    bool load(ast::TranslationUnit $ unit, ast::Index $$ idx, const char *filename, const char* const* args, size_t num_args, std::string $ entry);
+
+    /** store a freshly parsed unit in the entry found by load()
+     * @param args the args given to load(). The pch given with
+     * -include-pch is added to the manifest. */
+    void store(ast::TranslationUnit c$$ unit, std::string c$$ entry, const char* const* args, size_t num_args);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_AST_CACHE_HPP_ */
@@ -90,6 +90,21 @@ void Class::create_prop_tree(c4::yml::NodeRef n) const
     TaggedEntity::create_prop_tree(n);
 }
 
+void Class::hash(Hasher $$ h, bool with_region) const
+{
+    h((uint64_t)m_members.size());
+    for(auto const& s : m_members)
+    {
+        s.hash(h, with_region);
+    }
+    h((uint64_t)m_methods.size());
+    for(auto const& s : m_methods)
+    {
+        s.hash(h, with_region);
+    }
+    TaggedEntity::hash(h, with_region);
+}
+
 
 } // namespace regen
 } // namespace c4
@@ -42,6 +42,7 @@ struct Class : public TaggedEntity
 
     void init(astEntityRef e) override;
     void create_prop_tree(c4::yml::NodeRef n) const override;
+    void hash(Hasher $$ h, bool with_region) const override;
 };
 
 
@@ -0,0 +1,448 @@
+#include "c4/regen/compiled_template.hpp"
+#include "c4/regen/enum.hpp"
+#include "c4/regen/class.hpp"
+#include "c4/regen/function.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+namespace {
+
+/** the kinds of entities seen by a template */
+typedef enum {
+    K_NONE,
+    K_ENUM,
+    K_SYMBOL,
+    K_CLASS,
+    K_MEMBER,
+    K_METHOD,
+    K_FUNCTION,
+    K_PARAM,
+} Kind_e;
+
+typedef enum {
+    F_NAME,
+    F_SPELLING,
+    F_KIND,
+    F_TYPE,
+    F_BRIEF_COMMENT,
+    F_RAW_COMMENT,
+    F_SYMBOL,
+    F_VALUE,
+} Field_e;
+
+typedef enum {
+    S_SYMBOLS,
+    S_MEMBERS,
+    S_METHODS,
+    S_PARAMETERS,
+} Seq_e;
+
+struct _scope
+{
+    csubstr var;
+    Kind_e  kind;
+};
+
+bool _is_tagged(Kind_e k)
+{
+    return k != K_PARAM && k != K_NONE;
+}
+
+bool _field(Kind_e k, csubstr name, size_t $ f)
+{
+    if     (name == "name"         ) *f = F_NAME;
+    else if(name == "spelling"     ) *f = F_SPELLING;
+    else if(name == "kind"         ) *f = F_KIND;
+    else if(name == "type"         ) *f = F_TYPE;
+    else if(name == "brief_comment") *f = F_BRIEF_COMMENT;
+    else if(name == "raw_comment"  ) *f = F_RAW_COMMENT;
+    else if(name == "symbol" && k == K_SYMBOL) *f = F_SYMBOL;
+    else if(name == "value"  && k == K_SYMBOL) *f = F_VALUE;
+    else return false;
+    return true;
+}
+
+bool _seq(Kind_e k, csubstr name, size_t $ s, Kind_e $ elm)
+{
+    if(name == "symbols" && k == K_ENUM)
+    {
+        *s = S_SYMBOLS;
+        *elm = K_SYMBOL;
+    }
+    else if(name == "members" && k == K_CLASS)
+    {
+        *s = S_MEMBERS;
+        *elm = K_MEMBER;
+    }
+    else if(name == "methods" && k == K_CLASS)
+    {
+        *s = S_METHODS;
+        *elm = K_METHOD;
+    }
+    else if(name == "parameters" && (k == K_FUNCTION || k == K_METHOD))
+    {
+        *s = S_PARAMETERS;
+        *elm = K_PARAM;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool _is_ident(csubstr s)
+{
+    if(s.empty()) return false;
+    if(s[0] >= '0' && s[0] <= '9') return false;
+    for(const char c : s)
+    {
+        if( ! ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** split a dotted path into its parts. @return false if it is not a path */
+bool _split_path(csubstr s, std::vector<csubstr> $ parts)
+{
+    parts->clear();
+    while(true)
+    {
+        size_t pos = s.find('.');
+        csubstr part = pos == csubstr::npos ? s : s.first(pos);
+        if( ! _is_ident(part)) return false;
+        parts->push_back(part);
+        if(pos == csubstr::npos) break;
+        s = s.sub(pos + 1);
+    }
+    return true;
+}
+
+/** find the scope of a path: the innermost loop whose variable is the
+ * first part of the path. The top-level properties are seen only
+ * outside loops. */
+bool _resolve(std::vector<_scope> c$$ scopes, std::vector<csubstr> $ parts, size_t $ scope)
+{
+    for(size_t i = scopes.size() - 1; i > 0; --i)
+    {
+        if(scopes[i].var == parts->front())
+        {
+            if(parts->size() < 2) return false;
+            parts->erase(parts->begin());
+            *scope = i;
+            return true;
+        }
+    }
+    if(scopes.size() > 1) return false;
+    *scope = 0;
+    return true;
+}
+
+} // namespace
+
+
+//-----------------------------------------------------------------------------
+
+std::shared_ptr<CompiledTemplate> CompiledTemplate::compile(csubstr src, EntityType_e type)
+{
+    Kind_e top = K_NONE;
+    switch(type)
+    {
+    case ENT_ENUM:     top = K_ENUM;     break;
+    case ENT_CLASS:    top = K_CLASS;    break;
+    case ENT_FUNCTION: top = K_FUNCTION; break;
+    default: return nullptr;
+    }
+
+    auto ct = std::make_shared<CompiledTemplate>();
+    ct->m_src.assign(src.str, src.len);
+    csubstr s = to_csubstr(ct->m_src);
+    std::vector<_scope> scopes = {{csubstr{}, top}};
+    std::vector<size_t> loops;
+    std::vector<csubstr> parts, words;
+    bool eat_newline = false;
+
+    size_t pos = 0;
+    while(pos < s.len)
+    {
+        // find the next tag
+        size_t b = pos;
+        while(true)
+        {
+            b = s.find('{', b);
+            if(b == csubstr::npos || b + 1 >= s.len) { b = csubstr::npos; break; }
+            if(s[b+1] == '{' || s[b+1] == '%' || s[b+1] == '#') break;
+            ++b;
+        }
+        csubstr text = b == csubstr::npos ? s.sub(pos) : s.range(pos, b);
+        // the newline following an opening block tag is not rendered
+        if(eat_newline)
+        {
+            if(text.begins_with("\r\n")) text = text.sub(2);
+            else if(text.begins_with('\n')) text = text.sub(1);
+            eat_newline = false;
+        }
+        if( ! text.empty())
+        {
+            ct->m_code.push_back({TEXT, 0, 0, 0, text});
+        }
+        if(b == csubstr::npos) break;
+
+        const char kind = s[b+1];
+        if(kind == '#') return nullptr; // comments are left to the engine
+        if(b + 2 < s.len && s[b+2] == '{') return nullptr; // ambiguous braces
+        size_t e = s.find(kind == '{' ? "}}" : "%}", b + 2);
+        if(e == csubstr::npos) return nullptr;
+        if(e + 2 < s.len && s[e+2] == '}') return nullptr;
+        csubstr body = s.range(b + 2, e).trim(" \t");
+        pos = e + 2;
+
+        if(kind == '{')
+        {
+            size_t scope = 0;
+            if( ! _split_path(body, &parts)) return nullptr;
+            if( ! _resolve(scopes, &parts, &scope)) return nullptr;
+            Kind_e k = scopes[scope].kind;
+            size_t f = 0;
+            if(parts.size() == 1 && _field(k, parts[0], &f))
+            {
+                ct->m_code.push_back({FIELD, scope, f, 0, {}});
+            }
+            else if(parts.size() == 2 && parts[0] == "meta" && _is_tagged(k))
+            {
+                ct->m_code.push_back({META, scope, 0, 0, parts[1]});
+            }
+            else
+            {
+                return nullptr;
+            }
+            continue;
+        }
+
+        words.clear();
+        for(csubstr rem = body; ! rem.empty(); )
+        {
+            size_t sp = rem.find(' ');
+            csubstr w = sp == csubstr::npos ? rem : rem.first(sp);
+            if( ! w.empty()) words.push_back(w);
+            rem = sp == csubstr::npos ? csubstr{} : rem.sub(sp + 1);
+        }
+        if(words.size() == 4 && words[0] == "for" && words[2] == "in")
+        {
+            csubstr var = words[1];
+            size_t f = 0, seq = 0, scope = 0;
+            Kind_e elm = K_NONE;
+            if( ! _is_ident(var) || var == "meta" || var == "tag") return nullptr;
+            for(auto c$$ sc : scopes)
+            {
+                if(sc.var == var || _field(sc.kind, var, &f) || _seq(sc.kind, var, &seq, &elm)) return nullptr;
+            }
+            if( ! _split_path(words[3], &parts)) return nullptr;
+            if( ! _resolve(scopes, &parts, &scope)) return nullptr;
+            if(parts.size() != 1 || ! _seq(scopes[scope].kind, parts[0], &seq, &elm)) return nullptr;
+            loops.push_back(ct->m_code.size());
+            ct->m_code.push_back({LOOP, scope, seq, 0, {}});
+            scopes.push_back({var, elm});
+            if(loops.size() > ct->m_max_depth) ct->m_max_depth = loops.size();
+            eat_newline = true;
+        }
+        else if(words.size() == 1 && words[0] == "endfor")
+        {
+            if(loops.empty()) return nullptr;
+            size_t loop = loops.back();
+            loops.pop_back();
+            scopes.pop_back();
+            ct->m_code[loop].m_jump = ct->m_code.size();
+            ct->m_code.push_back({END_LOOP, loops.size() + 1, 0, loop, {}});
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+    if( ! loops.empty()) return nullptr;
+    return ct;
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+csubstr _get_field(Entity c$$ e, size_t f)
+{
+    switch(f)
+    {
+    case F_NAME:          return e.m_name;
+    case F_SPELLING:      return e.m_spelling;
+    case F_KIND:          return e.m_kind;
+    case F_TYPE:          return e.m_type;
+    case F_BRIEF_COMMENT: return e.m_brief_comment;
+    case F_RAW_COMMENT:   return e.m_raw_comment;
+    case F_SYMBOL:        return static_cast<EnumSymbol c$$>(e).m_sym;
+    case F_VALUE:
+    {
+        auto c$$ sym = static_cast<EnumSymbol c$$>(e);
+        return csubstr(sym.m_val_buf, sym.m_val_size);
+    }
+    default:
+        C4_ERROR("unknown field");
+        break;
+    }
+    return {};
+}
+
+bool _get_meta(Entity c$$ e, csubstr key, csubstr $ val)
+{
+    auto c$$ t = static_cast<TaggedEntity c$$>(e);
+    if( ! t.is_tagged() || t.m_tag.m_spec_str.empty()) return false;
+    auto root = t.m_tag.m_annotations.rootref();
+    if( ! root.is_map()) return false;
+    auto n = root.find_child(key);
+    if( ! n.valid() || ! n.is_keyval()) return false;
+    *val = n.val();
+    return true;
+}
+
+size_t _seq_size(Entity c$$ e, size_t seq)
+{
+    switch(seq)
+    {
+    case S_SYMBOLS:    return static_cast<Enum     c$$>(e).m_symbols.size();
+    case S_MEMBERS:    return static_cast<Class    c$$>(e).m_members.size();
+    case S_METHODS:    return static_cast<Class    c$$>(e).m_methods.size();
+    case S_PARAMETERS: return static_cast<Function c$$>(e).m_parameters.size();
+    default:
+        C4_ERROR("unknown sequence");
+        break;
+    }
+    return 0;
+}
+
+Entity c$ _seq_elm(Entity c$$ e, size_t seq, size_t i)
+{
+    switch(seq)
+    {
+    case S_SYMBOLS:    return &static_cast<Enum     c$$>(e).m_symbols[i];
+    case S_MEMBERS:    return &static_cast<Class    c$$>(e).m_members[i];
+    case S_METHODS:    return &static_cast<Class    c$$>(e).m_methods[i];
+    case S_PARAMETERS: return &static_cast<Function c$$>(e).m_parameters[i];
+    default:
+        C4_ERROR("unknown sequence");
+        break;
+    }
+    return nullptr;
+}
+
+/** after a closing block tag which is followed by a newline, the line
+ * is emptied if it has only whitespace */
+void _trim_line(std::vector<csubstr> $ out)
+{
+    size_t num_pop = 0;
+    for(size_t i = out->size(); i > 0; --i)
+    {
+        csubstr s = (*out)[i - 1];
+        size_t pos = s.last_not_of(" \t");
+        if(pos == csubstr::npos)
+        {
+            ++num_pop;
+            continue;
+        }
+        if(s[pos] != '\n') return; // there is text in the line
+        (*out)[i - 1] = s.first(pos + 1);
+        break;
+    }
+    out->resize(out->size() - num_pop);
+}
+
+} // namespace
+
+
+bool CompiledTemplate::render(Entity c$$ e, c4::tpl::Rope $ r) const
+{
+    struct _frame
+    {
+        Entity c$ e;
+        size_t i, n;
+    };
+    std::vector<_frame> frames(m_max_depth + 1);
+    std::vector<csubstr> out;
+    out.reserve(m_code.size());
+    frames[0] = {&e, 0, 1};
+
+    auto closes_line = [this](size_t ip) {
+        if(ip + 1 >= m_code.size()) return false;
+        Instr c$$ next = m_code[ip + 1];
+        return next.m_op == TEXT && (next.m_str.begins_with('\n') || next.m_str.begins_with("\r\n"));
+    };
+
+    for(size_t ip = 0; ip < m_code.size(); ++ip)
+    {
+        Instr c$$ in = m_code[ip];
+        switch(in.m_op)
+        {
+        case TEXT:
+            out.push_back(in.m_str);
+            break;
+        case FIELD:
+            out.push_back(_get_field(*frames[in.m_scope].e, in.m_arg));
+            break;
+        case META:
+        {
+            csubstr val;
+            if( ! _get_meta(*frames[in.m_scope].e, in.m_str, &val)) return false;
+            out.push_back(val);
+            break;
+        }
+        case LOOP:
+        {
+            Entity c$$ owner = *frames[in.m_scope].e;
+            size_t n = _seq_size(owner, in.m_arg);
+            if(n == 0)
+            {
+                ip = in.m_jump;
+                if(closes_line(ip)) _trim_line(&out);
+                break;
+            }
+            frames[m_code[in.m_jump].m_scope] = {_seq_elm(owner, in.m_arg, 0), 0, n};
+            break;
+        }
+        case END_LOOP:
+        {
+            Instr c$$ loop = m_code[in.m_jump];
+            _frame $$ f = frames[in.m_scope];
+            if(++f.i < f.n)
+            {
+                f.e = _seq_elm(*frames[loop.m_scope].e, loop.m_arg, f.i);
+                ip = in.m_jump;
+            }
+            else if(closes_line(ip))
+            {
+                _trim_line(&out);
+            }
+            break;
+        }
+        default:
+            C4_ERROR("unknown instruction");
+            break;
+        }
+    }
+
+    r->clear();
+    for(csubstr s : out)
+    {
+        if( ! s.empty()) r->append(s);
+    }
+    return true;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,86 @@
+#ifndef _c4_REGEN_COMPILED_TEMPLATE_HPP_
+#define _c4_REGEN_COMPILED_TEMPLATE_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <c4/tpl/engine.hpp>
+#include "c4/regen/entity.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** A code template compiled to an instruction stream which reads the
+ * properties straight from the entity objects, so that rendering does
+ * not need to build the YAML property tree of the entity.
+ *
+ * Only a subset of the template language is compiled:
+ *
+ * @begincode
+ * {{name}} {{type}} {{spelling}} {{kind}} {{brief_comment}} {{raw_comment}}
+ * {{meta.key}}                      # scalar annotations of the tag
+ * {{symbol}} {{value}}              # of enum symbols
+ * {% for s in symbols %}...{% endfor %}     # of enums
+ * {% for m in members %}...{% endfor %}     # of classes
+ * {% for m in methods %}...{% endfor %}     # of classes
+ * {% for p in parameters %}...{% endfor %}  # of functions and methods
+ * @endcode
+ *
+ * Inside a loop the properties are accessed through the loop variable,
+ * eg {{s.name}}. A template using anything else (conditionals, comments,
+ * other properties) is not compiled, and is rendered by the template
+ * engine from the property tree.
+ *
+ * For the properties of this subset, the compiled template renders
+ * exactly what the engine renders from the property tree, including
+ * the whitespace control of the block tags; the tests check this for
+ * every instruction, with empty and non-empty sequences. It is not
+ * checked at run time. */
+struct CompiledTemplate
+{
+    typedef enum {
+        TEXT,      ///< append m_str
+        FIELD,     ///< append the field m_arg of the entity in scope m_scope
+        META,      ///< append the annotation m_str of the entity in scope m_scope
+        LOOP,      ///< loop over the sequence m_arg of the entity in scope m_scope
+        END_LOOP,  ///< go to the next element of the loop at m_jump
+    } Op_e;
+
+    struct Instr
+    {
+        Op_e    m_op;
+        size_t  m_scope; ///< the depth of the loop owning the entity; 0 is the top-level entity
+        size_t  m_arg;
+        size_t  m_jump;  ///< LOOP: the matching END_LOOP; END_LOOP: the matching LOOP
+        csubstr m_str;
+    };
+
+    std::string           m_src;
+    std::vector<Instr>    m_code;
+    size_t                m_max_depth{0};
+
+public:
+
+    /** compile a template for entities of the given type.
+     * @return null if the template uses constructs which are not compiled */
+    static std::shared_ptr<CompiledTemplate> compile(csubstr src, EntityType_e type);
+
+    /** render the template for the entity, replacing the contents of
+     * the rope. The rope entries point at the template and at the entity
+     * strings.
+     * @return false if the entity has properties which the compiled
+     * template cannot render, eg a missing or non-scalar annotation, so
+     * that the engine renders it instead; the rope is left untouched in
+     * that case */
+    bool render(Entity c$$ e, c4::tpl::Rope $ r) const;
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_COMPILED_TEMPLATE_HPP_ */
@@ -0,0 +1,155 @@
+#include "c4/regen/depfile.hpp"
+
+#include "c4/regen/registry.hpp"
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void DepFile::escape(csubstr name, std::string $ out)
+{
+    out->clear();
+    for(char c : name)
+    {
+        switch(c)
+        {
+        case ' ' : *out += "\\ "; break;
+        case '#' : *out += "\\#"; break;
+        case '$' : *out += "$$"; break;
+        case '\\': *out += '/'; break; // backslashes would escape the next char
+        default  : *out += c; break;
+        }
+    }
+}
+
+void DepFile::add_target(csubstr target)
+{
+    std::string t(target.str, target.len);
+    if(m_seen_targets.insert(t).second)
+    {
+        m_targets.emplace_back(std::move(t));
+    }
+}
+
+void DepFile::add_dep(csubstr dep)
+{
+    std::string d(dep.str, dep.len);
+    if(m_seen_deps.insert(d).second)
+    {
+        m_deps.emplace_back(std::move(d));
+    }
+}
+
+void DepFile::save(const char *filename) const
+{
+    std::string out, esc;
+    for(size_t i = 0; i < m_targets.size(); ++i)
+    {
+        if(i) out += ' ';
+        escape(to_csubstr(m_targets[i]), &esc);
+        out += esc;
+    }
+    out += ':';
+    for(auto c$$ d : m_deps)
+    {
+        escape(to_csubstr(d), &esc);
+        out += " \\\n  ";
+        out += esc;
+    }
+    out += '\n';
+    c4::fs::file_put_contents(filename, to_csubstr(out));
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void DepTracker::_abspath(csubstr name, std::string $ out) const
+{
+    normalize_path(name, to_csubstr(m_cwd), out);
+}
+
+void DepTracker::begin_run(csubstr cfg_file)
+{
+    m_run.clear();
+    m_num_written = 0;
+    std::vector<char> cwdbuf = c4::fs::cwd<std::vector<char>>();
+    csubstr cwd = to_csubstr(cwdbuf).trimr('\0');
+    m_cwd.assign(cwd.str, cwd.len);
+    _abspath(cfg_file, &m_cfg_file);
+    for(auto c$$ t : m_targets)
+    {
+        std::string p;
+        _abspath(to_csubstr(t), &p);
+        m_run.add_target(to_csubstr(p));
+    }
+}
+
+void DepTracker::_add_deps(DepFile $ df, std::vector<std::string> c$$ inputs)
+{
+    std::string p;
+    for(auto c$$ in : inputs)
+    {
+        if( ! c4::fs::path_exists(in.c_str())) continue; // eg, in-memory files
+        _abspath(to_csubstr(in), &p);
+        df->add_dep(to_csubstr(p));
+    }
+    df->add_dep(to_csubstr(m_cfg_file));
+}
+
+void DepTracker::add_unit(std::vector<std::string> c$$ inputs, std::set<std::string> c$$ outputs)
+{
+    if( ! enabled()) return;
+    std::string p;
+    // with --MT, the inputs go to the given targets, even when the unit
+    // has no outputs (eg when the code is written into the source)
+    if( ! m_file.empty() && ( ! m_targets.empty() || ! outputs.empty()))
+    {
+        if(m_targets.empty())
+        {
+            for(auto c$$ o : outputs)
+            {
+                _abspath(to_csubstr(o), &p);
+                m_run.add_target(to_csubstr(p));
+            }
+        }
+        _add_deps(&m_run, inputs);
+    }
+    if(m_per_unit && ! outputs.empty())
+    {
+        DepFile df;
+        for(auto c$$ o : outputs)
+        {
+            _abspath(to_csubstr(o), &p);
+            df.add_target(to_csubstr(p));
+        }
+        _add_deps(&df, inputs);
+        p = df.m_targets.front() + ".d";
+        df.save(p.c_str());
+        ++m_num_written;
+    }
+}
+
+void DepTracker::end_run()
+{
+    if(m_file.empty()) return;
+    if(m_run.empty())
+    {
+        // make sure the build system finds a valid depfile
+        std::string p;
+        _abspath(to_csubstr(m_file), &p);
+        m_run.add_target(to_csubstr(p));
+    }
+    m_run.add_dep(to_csubstr(m_cfg_file));
+    m_run.save(m_file.c_str());
+    ++m_num_written;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,100 @@
+#ifndef _c4_REGEN_DEPFILE_HPP_
+#define _c4_REGEN_DEPFILE_HPP_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <c4/substr.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** A Makefile/Ninja style dependency file:
+ * @code
+ * target1 target2: dep1 dep2 \
+ *   dep3
+ * @endcode */
+struct DepFile
+{
+    std::vector<std::string> m_targets;
+    std::vector<std::string> m_deps;
+    std::set<std::string>    m_seen_targets; ///< to add each target once
+    std::set<std::string>    m_seen_deps;    ///< to add each dependency once
+
+public:
+
+    void clear()
+    {
+        m_targets.clear();
+        m_deps.clear();
+        m_seen_targets.clear();
+        m_seen_deps.clear();
+    }
+
+    bool empty() const { return m_targets.empty(); }
+
+    void add_target(csubstr target);
+    void add_dep(csubstr dep);
+
+    void save(const char *filename) const;
+
+    /** escape a file name for a Makefile rule */
+    static void escape(csubstr name, std::string $ out);
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** Collects the files read to produce the outputs of a run, and writes
+ * them as depfiles, so that the build system reruns regen exactly when
+ * one of those files changes. The inputs of a unit are its source file,
+ * every file it includes, and the config file.
+ *
+ * There are two modes, which can be used together:
+ *   - per unit (--depfile): a depfile is written next to the outputs of
+ *     each unit, named after the first output with a .d suffix.
+ *   - per run (--MF=<file>, like the compiler's -MF): a single depfile
+ *     with all the outputs and inputs of the run. The targets can be
+ *     replaced with --MT=<target> (eg a stamp file), like -MT.
+ *
+ * All the names are written as absolute paths.
+ */
+struct DepTracker
+{
+    bool        m_per_unit{false};
+    std::string m_file;                  ///< the run's depfile; empty if none
+    std::vector<std::string> m_targets;  ///< the run's targets. Default to all the outputs.
+
+    DepFile     m_run;
+    std::string m_cfg_file;
+    std::string m_cwd;
+    size_t      m_num_written{0};
+
+public:
+
+    bool enabled() const { return m_per_unit || ! m_file.empty(); }
+
+    void begin_run(csubstr cfg_file);
+    /** @param inputs the files read to produce the outputs, in addition
+     * to the config file. Files which do not exist are skipped.
+     * @param outputs the files written from the unit. When there are
+     * none, the unit has no depfile of its own, and its inputs go to the
+     * run's depfile only if it has targets given with --MT. */
+    void add_unit(std::vector<std::string> c$$ inputs, std::set<std::string> c$$ outputs);
+    void end_run();
+
+private:
+
+    void _add_deps(DepFile $ df, std::vector<std::string> c$$ inputs);
+    void _abspath(csubstr name, std::string $ out) const;
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_DEPFILE_HPP_ */
@@ -21,16 +21,22 @@ void Entity::init(astEntityRef e)
     m_cursor = e.cursor;
     m_parent = e.parent;
     m_region.init_region(*e.idx, e.cursor);
-    m_str = m_region.get_str(to_csubstr(e.tu->m_contents));
+    // the entity may be declared in a header included from the main file
+    csubstr contents = e.tu->file_contents(m_cursor.file());
+    m_str = contents.empty() ? csubstr{} : m_region.get_str(contents);
     m_name = to_csubstr(m_cursor.display_name(*m_index));
+    m_usr = to_csubstr(m_cursor.usr(*m_index));
     m_spelling = to_csubstr(m_cursor.spelling(*m_index));
     m_type = to_csubstr(m_cursor.type_spelling(*m_index));
     m_brief_comment = to_csubstr(m_cursor.brief_comment(*m_index));
     m_raw_comment = to_csubstr(m_cursor.raw_comment(*m_index));
     if(m_name.empty()) m_name = _get_spelling();
 
+    m_is_tpl = m_cursor.is_tpl();
+    m_is_tpl_class = m_is_tpl && m_cursor.is_tpl_class();
+    m_is_tpl_function = m_is_tpl && m_cursor.is_tpl_function();
     m_tpl_args.clear();
-    if(m_cursor.is_tpl())
+    if(m_is_tpl)
     {
         for(unsigned i = 0; i < m_cursor.num_tpl_args(); ++i)
         {
@@ -50,11 +56,13 @@ void Entity::create_prop_tree(c4::yml::NodeRef n) const
     n["brief_comment"] = m_brief_comment;
     n["raw_comment"] = m_raw_comment;
 
-    if(m_cursor.is_tpl())
+    // use the stored flags rather than the cursor, as the entity may
+    // have been restored from a snapshot
+    if(m_is_tpl)
     {
         n["is_tpl"] = "1";
-        if(m_cursor.is_tpl_class()) n["is_tpl_class"] = "1";
-        if(m_cursor.is_tpl_function()) n["is_tpl_function"] = "1";
+        if(m_is_tpl_class) n["is_tpl_class"] = "1";
+        if(m_is_tpl_function) n["is_tpl_function"] = "1";
         for(auto const& tpl_arg : m_tpl_args)
         {
             C4_UNUSED(tpl_arg); // @todo populate with template properties
@@ -73,6 +81,18 @@ void Entity::create_prop_tree(c4::yml::NodeRef n) const
     n["region"]["end"]["offset"] << m_region.m_start.offset;
 }
 
+void Entity::hash(Hasher $$ h, bool with_region) const
+{
+    h(m_name)(m_spelling)(m_kind)(m_type)(m_brief_comment)(m_raw_comment);
+    h((uint64_t)((m_is_tpl ? 1u : 0u) | (m_is_tpl_class ? 2u : 0u) | (m_is_tpl_function ? 4u : 0u)));
+    if(with_region)
+    {
+        h(m_region.m_file ? to_csubstr(m_region.m_file) : csubstr{});
+        h((uint64_t)m_region.m_start.line)((uint64_t)m_region.m_start.column)((uint64_t)m_region.m_start.offset);
+        h((uint64_t)m_region.m_end.line)((uint64_t)m_region.m_end.column);
+    }
+}
+
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -115,6 +135,18 @@ void Tag::_parse_annotations()
     c4::yml::parse(yml_src, &m_annotations);
 }
 
+void Tag::_restore_annotations(csubstr normalized_spec)
+{
+    m_annotations.clear();
+    m_annotations.clear_arena();
+    m_spec_str = normalized_spec;
+    if(m_spec_str.empty()) return;
+    m_annotations.copy_to_arena(normalized_spec);
+    substr yml_src = m_annotations.arena();
+    m_spec_str = yml_src;
+    c4::yml::parse(yml_src, &m_annotations);
+}
+
 /** convert the code with a relaxed map to a strict YAML map so that it can be parsed */
 substr Tag::_normalize_map_str(csubstr s)
 {
@@ -192,6 +224,17 @@ void TaggedEntity::create_prop_tree(c4::yml::NodeRef n) const
     Entity::create_prop_tree(n);
 }
 
+void TaggedEntity::hash(Hasher $$ h, bool with_region) const
+{
+    h((uint64_t)is_tagged());
+    if(is_tagged())
+    {
+        m_tag.hash(h, with_region);
+        h(m_tag.m_spec_str); // the annotations are parsed from the spec
+    }
+    Entity::hash(h, with_region);
+}
+
 
 } // namespace regen
 } // namespace c4
@@ -6,6 +6,7 @@
 #include <c4/yml/node.hpp>
 
 #include "c4/ast/ast.hpp"
+#include "c4/regen/hash.hpp"
 #include <c4/c4_push.hpp>
 
 namespace c4 {
@@ -52,13 +53,16 @@ struct Entity
     ast::Region              m_region;
     csubstr                  m_str;
     csubstr                  m_name;
+    csubstr                  m_usr;
     csubstr                  m_spelling;
     csubstr                  m_kind;
     csubstr                  m_type;
     csubstr                  m_brief_comment;
     csubstr                  m_raw_comment;
 
-    bool                     m_is_tpl;
+    bool                     m_is_tpl{false};
+    bool                     m_is_tpl_class{false};
+    bool                     m_is_tpl_function{false};
     std::vector<TemplateArg> m_tpl_args;
 
 public:
@@ -67,6 +71,10 @@ public:
     virtual void init(astEntityRef e);
 
     virtual void create_prop_tree(c4::yml::NodeRef root) const;
+    /** hash the properties of the entity, ie what create_prop_tree()
+     * exposes to the templates. The regions are hashed only if asked
+     * for, so that moving an entity does not change its hash. */
+    virtual void hash(Hasher $$ h, bool with_region) const;
 
     void clear_handles()
     {
@@ -110,6 +118,9 @@ struct Tag : public Entity
     }
 
     void _parse_annotations();
+    /** set the annotations from a spec which is already normalized, as
+     * is m_spec_str after parsing */
+    void _restore_annotations(csubstr normalized_spec);
     substr _normalize_map_str(csubstr s);
 };
 
@@ -128,6 +139,7 @@ struct TaggedEntity : public Entity
     }
 
     virtual void create_prop_tree(c4::yml::NodeRef root) const override;
+    virtual void hash(Hasher $$ h, bool with_region) const override;
 };
 
 
@@ -0,0 +1,228 @@
+#include "c4/regen/entity_db.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+bool EntityDb::open(const char *filename)
+{
+    if( ! m_file.open(filename)) return false;
+    bool ok = m_file.m_size >= sizeof(edb::Header);
+    if(ok)
+    {
+        edb::Header c$$ h = header();
+        ok = memcmp(h.magic, edb::magic, sizeof(h.magic)) == 0
+            && h.version == edb::version
+            && h.byte_order == snap::byte_order
+            && m_file.fits(h.strings.offset, h.strings.count, 1)
+            && m_file.fits(h.records.offset, h.records.count, sizeof(edb::Record))
+            && m_file.fits(h.by_usr.offset , h.by_usr.count , sizeof(uint32_t))
+            && m_file.fits(h.by_file.offset, h.by_file.count, sizeof(uint32_t))
+            && m_file.fits(h.by_tag.offset , h.by_tag.count , sizeof(uint32_t));
+    }
+    if( ! ok)
+    {
+        close();
+    }
+    return ok;
+}
+
+csubstr EntityDb::str(snap::Str s) const
+{
+    snap::Section t = header().strings;
+    C4_CHECK(s.offset < t.count && s.len < t.count - s.offset);
+    return csubstr(m_file.m_data + t.offset + s.offset, s.len);
+}
+
+template<class Field>
+EntityDb::Range EntityDb::_equal_range(snap::Section index, Field field, csubstr key) const
+{
+    uint32_t c$ b = _index(index);
+    uint32_t c$ e = b + index.count;
+    Record c$ records = _records();
+    uint32_t c$ lo = std::lower_bound(b, e, key, [this, records, field](uint32_t i, csubstr k){
+        return str(field(records[i])) < k;
+    });
+    uint32_t c$ hi = std::upper_bound(lo, e, key, [this, records, field](csubstr k, uint32_t i){
+        return k < str(field(records[i]));
+    });
+    return Range{lo, hi};
+}
+
+EntityDb::Record c$ EntityDb::find_usr(csubstr usr) const
+{
+    if( ! valid() || usr.empty()) return nullptr;
+    Range r = _equal_range(header().by_usr, [](Record c$$ rec){ return rec.usr; }, usr);
+    return r.empty() ? nullptr : &_records()[*r.b];
+}
+
+EntityDb::Range EntityDb::find_file(csubstr file) const
+{
+    if( ! valid()) return Range{nullptr, nullptr};
+    return _equal_range(header().by_file, [](Record c$$ rec){ return rec.file; }, file);
+}
+
+EntityDb::Range EntityDb::find_tag(csubstr tag) const
+{
+    if( ! valid()) return Range{nullptr, nullptr};
+    return _equal_range(header().by_tag, [](Record c$$ rec){ return rec.tag; }, tag);
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void EntityDbBuilder::load(c4::yml::NodeRef const root)
+{
+    m_file = ".c4regen/entities.c4db";
+    csubstr file;
+    root.get_if("entity_db", &file);
+    if( ! file.empty())
+    {
+        set_file(file);
+    }
+}
+
+void EntityDbBuilder::clear()
+{
+    m_strings = snap::StringTable();
+    m_records.clear();
+    m_usrs.clear();
+    std::vector<char> cwdbuf = c4::fs::cwd<std::vector<char>>();
+    csubstr cwd = to_csubstr(cwdbuf).trimr('\0');
+    m_cwd.assign(cwd.str, cwd.len);
+}
+
+uint32_t EntityDbBuilder::_add(edb::Kind_e kind, TaggedEntity c$$ e, Generator c$ g, uint32_t parent)
+{
+    std::string path;
+    normalize_path(to_csubstr(e.m_region.m_file), to_csubstr(m_cwd), &path);
+    edb::Record r;
+    r.usr = m_strings.add(e.m_usr);
+    r.name = m_strings.add(e.m_name);
+    r.type = m_strings.add(e.m_type);
+    r.file = m_strings.add(to_csubstr(path));
+    r.tag = e.is_tagged() ? m_strings.add(e.m_tag.m_name) : snap::Str{0, 0};
+    r.tag_spec = e.is_tagged() ? m_strings.add(e.m_tag.m_spec_str) : snap::Str{0, 0};
+    r.generator = m_strings.add(g->m_name);
+    r.brief_comment = m_strings.add(e.m_brief_comment);
+    r.kind = kind;
+    r.line = e.m_region.m_start.line;
+    r.column = e.m_region.m_start.column;
+    r.parent = parent;
+    r.children = {0, 0};
+    m_records.push_back(r);
+    return (uint32_t)(m_records.size() - 1);
+}
+
+void EntityDbBuilder::add(SourceFile c$$ sf)
+{
+    if(m_cwd.empty()) clear();
+    for(auto c$$ p : sf.m_pos)
+    {
+        Entity c$ e = sf.resolve(p);
+        if( ! e->m_usr.empty() && ! m_usrs.insert(std::string(e->m_usr.str, e->m_usr.len)).second)
+        {
+            continue;
+        }
+        // the children follow their parent
+        switch(p.entity_type)
+        {
+        case ENT_ENUM:
+        {
+            Enum c$$ en = static_cast<Enum c$$>(*e);
+            uint32_t id = _add(edb::ENUM, en, p.generator, edb::npos);
+            m_records[id].children = {id + 1, (uint32_t)en.m_symbols.size()};
+            for(auto c$$ s : en.m_symbols)
+            {
+                _add(edb::ENUM_SYMBOL, s, p.generator, id);
+            }
+            break;
+        }
+        case ENT_CLASS:
+        {
+            Class c$$ cl = static_cast<Class c$$>(*e);
+            uint32_t id = _add(edb::CLASS, cl, p.generator, edb::npos);
+            m_records[id].children = {id + 1, (uint32_t)(cl.m_members.size() + cl.m_methods.size())};
+            for(auto c$$ m : cl.m_members)
+            {
+                _add(edb::MEMBER, m, p.generator, id);
+            }
+            for(auto c$$ m : cl.m_methods)
+            {
+                _add(edb::METHOD, m, p.generator, id);
+            }
+            break;
+        }
+        case ENT_FUNCTION:
+            _add(edb::FUNCTION, static_cast<Function c$$>(*e), p.generator, edb::npos);
+            break;
+        default:
+            C4_ERROR("unknown entity type");
+        }
+    }
+}
+
+void EntityDbBuilder::save(const char *filename) const
+{
+    auto s = [this](snap::Str str) { return m_strings.get(str); };
+
+    std::vector<uint32_t> by_usr, by_file, by_tag;
+    for(uint32_t i = 0; i < (uint32_t)m_records.size(); ++i)
+    {
+        edb::Record c$$ r = m_records[i];
+        if(r.usr.len) by_usr.push_back(i);
+        by_file.push_back(i);
+        if(r.tag.len) by_tag.push_back(i);
+    }
+    std::sort(by_usr.begin(), by_usr.end(), [&](uint32_t l, uint32_t r){
+        return s(m_records[l].usr) < s(m_records[r].usr);
+    });
+    std::sort(by_file.begin(), by_file.end(), [&](uint32_t l, uint32_t r){
+        edb::Record c$$ rl = m_records[l];
+        edb::Record c$$ rr = m_records[r];
+        csubstr fl = s(rl.file), fr = s(rr.file);
+        if(fl != fr) return fl < fr;
+        if(rl.line != rr.line) return rl.line < rr.line;
+        return rl.column < rr.column;
+    });
+    std::stable_sort(by_tag.begin(), by_tag.end(), [&](uint32_t l, uint32_t r){
+        return s(m_records[l].tag) < s(m_records[r].tag);
+    });
+
+    edb::Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, edb::magic, sizeof(h.magic));
+    h.version = edb::version;
+    h.byte_order = snap::byte_order;
+    std::string out(sizeof(edb::Header), '\0');
+    snap::append_strings(&out, m_strings, &h.strings);
+    snap::append_section(&out, m_records, &h.records);
+    snap::append_section(&out, by_usr, &h.by_usr);
+    snap::append_section(&out, by_file, &h.by_file);
+    snap::append_section(&out, by_tag, &h.by_tag);
+    C4_CHECK_MSG(out.size() <= UINT32_MAX, "entity db too big");
+    memcpy(&out[0], &h, sizeof(h));
+
+    std::string dir(filename);
+    substr d = to_substr(dir).dirname().trimr("/\\");
+    if( ! d.empty())
+    {
+        dir[d.len] = '\0';
+        c4::fs::mkdirs(&dir[0]);
+    }
+    c4::fs::file_put_contents(filename, to_csubstr(out));
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
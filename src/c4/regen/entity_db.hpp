@@ -0,0 +1,198 @@
+#ifndef _c4_REGEN_ENTITY_DB_HPP_
+#define _c4_REGEN_ENTITY_DB_HPP_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <c4/yml/node.hpp>
+#include "c4/regen/snapshot.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** The binary layout of the entity database. Like the snapshots, this
+ * is made of fixed size records of 32 bit fields, and of a table of
+ * interned zero-terminated strings, so it is used in place after mapping
+ * the file.
+ *
+ * @code
+ * Header
+ * strings  char[]      (the string table)
+ * records  Record[]    (each entity is followed by its children)
+ * by_usr   uint32_t[]  (record indices sorted by usr)
+ * by_file  uint32_t[]  (record indices sorted by file, then line)
+ * by_tag   uint32_t[]  (indices of the tagged records, sorted by tag name)
+ * @endcode
+ */
+namespace edb {
+
+constexpr const char magic[8] = {'c', '4', 'r', 'g', 'e', 'n', 'd', 'b'};
+constexpr const uint32_t version = 1;
+constexpr const uint32_t npos = uint32_t(-1);
+
+typedef enum : uint32_t {
+    ENUM,
+    ENUM_SYMBOL,
+    CLASS,
+    MEMBER,
+    METHOD,
+    FUNCTION,
+} Kind_e;
+
+struct Record
+{
+    snap::Str     usr, name, type, file;
+    snap::Str     tag, tag_spec; ///< the tag macro and its (normalized) annotations
+    snap::Str     generator;     ///< the generator which extracted the entity
+    snap::Str     brief_comment;
+    uint32_t      kind;          ///< @see Kind_e
+    uint32_t      line, column;
+    uint32_t      parent;        ///< the record index of the parent, or npos
+    snap::Section children;      ///< the record indices of the children
+};
+
+struct Header
+{
+    char          magic[8];
+    uint32_t      version;
+    uint32_t      byte_order;
+    snap::Section strings, records, by_usr, by_file, by_tag;
+};
+
+} // namespace edb
+
+
+//-----------------------------------------------------------------------------
+
+/** A read-only, indexed view of an entity database written by
+ * `regen --cmd dump`. This is meant for tools which need the entities
+ * found by regen without parsing the sources again. The file is mapped
+ * and the lookups are binary searches on the mapped indices, so opening
+ * the database costs nothing regardless of its size.
+ *
+ * @begincode
+ * c4::regen::EntityDb db;
+ * if(db.open("build/entities.c4db"))
+ * {
+ *     for(uint32_t i : db.find_tag("C4_CLASS"))
+ *     {
+ *         auto const& r = db[i];
+ *         printf("%s @ %s:%u\n", db.str(r.name).str, db.str(r.file).str, r.line);
+ *         for(uint32_t j = r.children.offset; j < r.children.offset + r.children.count; ++j)
+ *         {
+ *             printf("    %s\n", db.str(db[j].name).str);
+ *         }
+ *     }
+ * }
+ * @endcode
+ */
+struct EntityDb
+{
+    using Record = edb::Record;
+
+    /** a range of record indices */
+    struct Range
+    {
+        uint32_t c$ b;
+        uint32_t c$ e;
+
+        uint32_t c$ begin() const { return b; }
+        uint32_t c$ end() const { return e; }
+        size_t size() const { return (size_t)(e - b); }
+        bool empty() const { return b == e; }
+    };
+
+    MappedFile m_file;
+
+public:
+
+    /** @return false if the file does not exist or is not a database of
+     * the current version */
+    bool open(const char *filename);
+    void close() { m_file.close(); }
+
+    bool valid() const { return m_file.valid(); }
+
+    edb::Header c$$ header() const { return *reinterpret_cast<edb::Header c$>(m_file.m_data); }
+
+    size_t size() const { return valid() ? header().records.count : 0; }
+    Record c$$ operator[] (size_t i) const { C4_ASSERT(i < size()); return _records()[i]; }
+
+    /** get a string from the string table. The string is zero-terminated. */
+    csubstr str(snap::Str s) const;
+
+    /** @return the parent of an entity, or nullptr. The children of an
+     * entity are the r.children.count records after it, starting at
+     * index r.children.offset. */
+    Record c$ parent(Record c$$ r) const { return r.parent == edb::npos ? nullptr : &_records()[r.parent]; }
+
+    /** @return the entity with this USR, or nullptr */
+    Record c$ find_usr(csubstr usr) const;
+    /** @return the entities declared in this file, ordered by line. The
+     * file names are stored as absolute paths with unix separators; use
+     * normalize_path() to look up a relative name. */
+    Range find_file(csubstr file) const;
+    /** @return the entities tagged with this macro */
+    Range find_tag(csubstr tag) const;
+
+private:
+
+    Record c$ _records() const { return reinterpret_cast<Record c$>(m_file.m_data + header().records.offset); }
+    uint32_t c$ _index(snap::Section s) const { return reinterpret_cast<uint32_t c$>(m_file.m_data + s.offset); }
+
+    /** find the records whose field is equal to the key, in an index
+     * sorted by that field */
+    template<class Field>
+    Range _equal_range(snap::Section index, Field field, csubstr key) const;
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** Accumulates the entities extracted during a run, and writes them to
+ * an entity database.
+ *
+ * YAML config example (this can also be set with --entity-db):
+ *
+ * @begincode
+ * entity_db: build/c4regen/entities.c4db
+ * @endcode
+ */
+struct EntityDbBuilder
+{
+    std::string m_file{".c4regen/entities.c4db"};
+
+    snap::StringTable        m_strings;
+    std::vector<edb::Record> m_records;
+    std::set<std::string>    m_usrs; ///< the entities already added
+    std::string              m_cwd;
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+    void set_file(csubstr file) { m_file.assign(file.str, file.len); }
+
+    void clear();
+    size_t size() const { return m_records.size(); }
+
+    /** add the extracted entities of a source file. Entities already
+     * added from another file are skipped. */
+    void add(SourceFile c$$ sf);
+
+    void save() const { save(m_file.c_str()); }
+    void save(const char *filename) const;
+
+private:
+
+    uint32_t _add(edb::Kind_e kind, TaggedEntity c$$ e, Generator c$ g, uint32_t parent);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_ENTITY_DB_HPP_ */
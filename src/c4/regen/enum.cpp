@@ -1,5 +1,7 @@
 #include "c4/regen/enum.hpp"
 
+#include <algorithm>
+
 namespace c4 {
 namespace regen {
 
@@ -47,9 +49,114 @@ void Enum::create_prop_tree(c4::yml::NodeRef n) const
         sn |= yml::MAP;
         s.create_prop_tree(sn);
     }
+    EnumLookup l;
+    lookup(&l);
+    n["lookup"] = l.type_str();
+    n["value_min"] = l.m_min;
+    n["value_max"] = l.m_max;
+    n["lookup_size"] << l.m_index.size();
+    auto li = n["lookup_index"];
+    li |= yml::SEQ;
+    for(size_t pos : l.m_index)
+    {
+        auto ln = li.append_child();
+        ln |= yml::MAP;
+        if(pos == EnumLookup::npos)
+        {
+            ln["pos"] = "-1";
+        }
+        else
+        {
+            ln["pos"] << pos;
+        }
+    }
     TaggedEntity::create_prop_tree(n);
 }
 
+void Enum::lookup(EnumLookup $ l) const
+{
+    l->m_type = EnumLookup::LINEAR;
+    l->m_min = l->m_max = {};
+    l->m_index.clear();
+    if(m_symbols.empty()) return;
+
+    // the values are compared as unsigned. Signed values get their sign
+    // bit flipped, which keeps their order.
+    bool is_signed = false;
+    for(auto const& s : m_symbols)
+    {
+        is_signed |= (s.m_val_size > 0 && s.m_val_buf[0] == '-');
+    }
+    std::vector<uint64_t> vals(m_symbols.size());
+    size_t imin = 0, imax = 0;
+    for(size_t i = 0; i < m_symbols.size(); ++i)
+    {
+        csubstr v(m_symbols[i].m_val_buf, m_symbols[i].m_val_size);
+        if(v.empty()) return;
+        if(is_signed)
+        {
+            int64_t iv;
+            if( ! from_chars(v, &iv)) return;
+            vals[i] = static_cast<uint64_t>(iv) ^ (uint64_t(1) << 63);
+        }
+        else
+        {
+            if( ! from_chars(v, &vals[i])) return;
+        }
+        if(vals[i] < vals[imin]) imin = i;
+        if(vals[i] > vals[imax]) imax = i;
+    }
+    l->m_min = csubstr(m_symbols[imin].m_val_buf, m_symbols[imin].m_val_size);
+    l->m_max = csubstr(m_symbols[imax].m_val_buf, m_symbols[imax].m_val_size);
+
+    uint64_t range = vals[imax] - vals[imin]; // the slots of a table, minus one
+    size_t max_slots = std::max(EnumLookup::max_density * m_symbols.size(), EnumLookup::min_dense_slots);
+    if(range < max_slots && range < EnumLookup::max_dense_slots)
+    {
+        l->m_type = EnumLookup::DENSE;
+        l->m_index.assign((size_t)range + 1, EnumLookup::npos);
+        for(size_t i = 0; i < m_symbols.size(); ++i)
+        {
+            size_t &slot = l->m_index[(size_t)(vals[i] - vals[imin])];
+            if(slot == EnumLookup::npos) slot = i;
+        }
+        return;
+    }
+
+    l->m_type = EnumLookup::SORTED;
+    l->m_index.resize(m_symbols.size());
+    for(size_t i = 0; i < m_symbols.size(); ++i)
+    {
+        l->m_index[i] = i;
+    }
+    std::stable_sort(l->m_index.begin(), l->m_index.end(), [&vals](size_t a, size_t b){ return vals[a] < vals[b]; });
+    auto last = std::unique(l->m_index.begin(), l->m_index.end(), [&vals](size_t a, size_t b){ return vals[a] == vals[b]; });
+    l->m_index.erase(last, l->m_index.end());
+}
+
+csubstr EnumLookup::type_str() const
+{
+    switch(m_type)
+    {
+    case LINEAR: return "linear";
+    case DENSE:  return "dense";
+    case SORTED: return "sorted";
+    default:
+        C4_ERROR("unknown lookup type");
+    }
+    return {};
+}
+
+void Enum::hash(Hasher $$ h, bool with_region) const
+{
+    h((uint64_t)m_symbols.size());
+    for(auto const& s : m_symbols)
+    {
+        s.hash(h, with_region);
+    }
+    TaggedEntity::hash(h, with_region);
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -78,5 +185,11 @@ void EnumSymbol::create_prop_tree(c4::yml::NodeRef n) const
     TaggedEntity::create_prop_tree(n);
 }
 
+void EnumSymbol::hash(Hasher $$ h, bool with_region) const
+{
+    h(m_sym)(csubstr(m_val_buf, m_val_size));
+    TaggedEntity::hash(h, with_region);
+}
+
 } // namespace regen
 } // namespace c4
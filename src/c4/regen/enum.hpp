@@ -20,11 +20,41 @@ struct EnumSymbol : public TaggedEntity
 
     void init_symbol(astEntityRef r, Enum *e);
     void create_prop_tree(c4::yml::NodeRef n) const override;
+    void hash(Hasher $$ h, bool with_region) const override;
 };
 
 
 //-----------------------------------------------------------------------------
 
+/** how the symbols of an enum are found by value at runtime, as decided
+ * from the values of the symbols. The templates get this as the enum
+ * properties lookup, value_min, value_max, lookup_size and lookup_index. */
+struct EnumLookup
+{
+    typedef enum {
+        LINEAR, ///< compare each symbol: there are no symbols, or their values are not known
+        DENSE,  ///< index a table with the value minus the least value
+        SORTED, ///< binary search the values
+    } Type_e;
+
+    Type_e              m_type{LINEAR};
+    csubstr             m_min;   ///< the least value
+    csubstr             m_max;   ///< the greatest value
+    /** DENSE: the position of the symbol of each value from m_min to m_max,
+     * or npos. SORTED: the positions of the symbols with distinct values,
+     * sorted by value. When several symbols have the same value, the first
+     * one is used. */
+    std::vector<size_t> m_index;
+
+    constexpr static const size_t npos = size_t(-1);
+    constexpr static const size_t max_density = 2;         ///< the most table slots per symbol
+    constexpr static const size_t min_dense_slots = 16;    ///< smaller tables are always dense
+    constexpr static const size_t max_dense_slots = 65536; ///< larger tables are never dense
+
+    csubstr type_str() const;
+};
+
+
 /** an enumeration type */
 struct Enum : public TaggedEntity
 {
@@ -33,6 +63,10 @@ struct Enum : public TaggedEntity
 
     virtual void init(astEntityRef e) override;
     virtual void create_prop_tree(c4::yml::NodeRef n) const override;
+    virtual void hash(Hasher $$ h, bool with_region) const override;
+
+    /** decide how to find the symbols by value */
+    void lookup(EnumLookup $ l) const;
 };
 
 
@@ -10,21 +10,61 @@ namespace c4 {
 namespace regen {
 
 
-enum { UNKNOWN, HELP, CMD, CFG, DIR, FLAGS };
+enum { UNKNOWN, HELP, CMD, CFG, DIR, FLAGS, STATS, UNITY, ASTCACHE, FROMSNAP, SNAPDIR, ENTITYDB, DEPFILE, DEPFILE_MF, DEPFILE_MT, MAP, MAP_HEADERS, JOBS };
 const option::Descriptor usage[] =
 {
-    {UNKNOWN, 0, "" , ""     , c4::opt::none    , "USAGE: regen generate [options] <source-file> [<more source-files>]\n\nOptions:" },
+    {UNKNOWN, 0, "" , ""     , c4::opt::none    , "USAGE: regen --cmd <cmd> [options] <source-file> [<more source-files>]\n\nThe source files can also be given in response files, as @<file>, with one file name per line.\n\nOptions:" },
     {HELP   , 0, "h", "help" , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },
-    {CMD    , 0, "x", "cmd"  , c4::opt::required, "  -x <cmd>, --cmd=<cmd>  \t(required) The command to execute. Must be one of [generate,outfiles]." },
+    {CMD    , 0, "x", "cmd"  , c4::opt::required, "  -x <cmd>, --cmd=<cmd>  \t(required) The command to execute. Must be one of [generate,extract,dump,outfiles]. extract parses the source files and saves their entities to snapshots, without generating code. dump writes the entities of all the source files to an indexed entity database." },
     {CFG    , 0, "c", "cfg"  , c4::opt::required, "  -c <cfg-yml>, --cfg=<cfg-yml>  \t(required) The full path to the regen config YAML file." },
     {DIR    , 0, "d", "dir"  , c4::opt::nonempty, "  -d <build-dir>, --dir=<build-dir>  \tThe full path to the directory containing the compile_commands.json file." },
     {FLAGS  , 0, "f", "flag" , c4::opt::nonempty, "  -f <compiler-flag>, --flag=<compiler-flag>  \tAdd a flag to pass to the compiler, generally --flag '-x' --flag 'c++' should be used." },
+    {STATS  , 0, "s", "stats", c4::opt::none    , "  -s, --stats  \tPrint statistics of the run to stderr." },
+    {UNITY  , 0, "u", "unity", c4::opt::none    , "  -u, --unity  \tParse all the source files at once, in a single translation unit including all of them. All the files are parsed with the same flags, so this cannot be used with --dir." },
+    {ASTCACHE, 0, "a", "ast-cache", c4::opt::nonempty, "  -a <dir>, --ast-cache=<dir>  \tStore the parsed units in this directory, and reload them instead of parsing when the file, its includes and its flags did not change. Overrides the ast_cache config key." },
+    {FROMSNAP, 0, "", "from-snapshot", c4::opt::none, "  --from-snapshot  \tWith --cmd generate: do not parse the source files; generate the code from the snapshots saved by --cmd extract." },
+    {SNAPDIR, 0, "", "snapshot-dir", c4::opt::nonempty, "  --snapshot-dir=<dir>  \tThe directory of the snapshots. Overrides the snapshot_dir config key." },
+    {ENTITYDB, 0, "", "entity-db", c4::opt::nonempty, "  --entity-db=<file>  \tWith --cmd dump: the entity database file to write. Overrides the entity_db config key." },
+    {DEPFILE, 0, "", "depfile", c4::opt::none, "  --depfile  \tWrite a Makefile/Ninja depfile next to the outputs of each source file, named after the first output with a .d suffix. It lists the source file, every file it includes and the config file." },
+    {DEPFILE_MF, 0, "", "MF", c4::opt::nonempty, "  --MF=<file>  \tWrite a single depfile with all the outputs and inputs of the run, like the compiler's -MF." },
+    {DEPFILE_MT, 0, "", "MT", c4::opt::nonempty, "  --MT=<target>  \tUse this target in the --MF depfile instead of the outputs, like the compiler's -MT. Can be given several times." },
+    {JOBS, 0, "j", "jobs", c4::opt::nonempty, "  -j <n>, --jobs=<n>  \tParse up to this many source files in parallel. 0 uses one job per hardware thread. The generated code does not depend on the number of jobs. Overrides the jobs setting of the config file." },
+    {MAP, 0, "", "map", c4::opt::none, "  --map  \tWith --cmd outfiles: print a line for each source file, with the source file and all the files written from it (every shard, and the files of every generator), separated by tabs. The files are not parsed." },
+    {MAP_HEADERS, 0, "", "map-headers", c4::opt::none, "  --map-headers  \tWith --map: also list the files of the headers whose code is written from each source file, in the line of that file. This parses the files as --cmd generate does (with --flag or --dir), so it is as slow as a parse of every file." },
     {0,0,0,0,0,0}
 };
 
 inline bool valid_cmd(csubstr cmd)
 {
-    return cmd == "generate" || cmd == "outfiles";
+    return cmd == "generate" || cmd == "extract" || cmd == "dump" || cmd == "outfiles";
+}
+
+/** get the source files from the positional arguments, expanding the
+ * response files (@<file>), which have one file name per line */
+template<class Args>
+inline void collect_files(Args c$$ posn_args, std::vector<std::string> $ files)
+{
+    files->clear();
+    std::string contents;
+    for(const char *a : posn_args)
+    {
+        if(a[0] != '@')
+        {
+            files->emplace_back(a);
+            continue;
+        }
+        C4_CHECK_MSG(c4::fs::path_exists(a + 1), "response file not found: %s", a + 1);
+        c4::fs::file_get_contents(a + 1, &contents);
+        csubstr rem = to_csubstr(contents);
+        while( ! rem.empty())
+        {
+            size_t pos = rem.find('\n');
+            csubstr line = (pos != csubstr::npos ? rem.first(pos) : rem).trim(" \t\r");
+            rem = pos != csubstr::npos ? rem.sub(pos + 1) : csubstr{};
+            if(line.empty()) continue;
+            files->emplace_back(line.str, line.len);
+        }
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -43,17 +83,64 @@ inline int exec(regen::Regen *rg, int argc, const char *argv[], bool skip_exe_na
     auto opts = opt::make_parser(usage, argc, argv, HELP, {CFG});
 
     rg->load_config(opts(CFG));
+    if(opts[ASTCACHE])
+    {
+        rg->m_ast_cache.set_dir(to_csubstr(opts[ASTCACHE].arg));
+    }
+    if(opts[SNAPDIR])
+    {
+        rg->m_snapshots.set_dir(to_csubstr(opts[SNAPDIR].arg));
+    }
+    if(opts[ENTITYDB])
+    {
+        rg->m_entity_db.set_file(to_csubstr(opts[ENTITYDB].arg));
+    }
+    if(opts[DEPFILE])
+    {
+        rg->m_deps.m_per_unit = true;
+    }
+    if(opts[DEPFILE_MF])
+    {
+        rg->m_deps.m_file = opts[DEPFILE_MF].arg;
+    }
+    for(auto const& t : opts.opts(DEPFILE_MT))
+    {
+        rg->m_deps.m_targets.emplace_back(t.arg);
+    }
+    if(opts[JOBS])
+    {
+        size_t num_jobs = 0;
+        C4_CHECK_MSG(from_chars(to_csubstr(opts[JOBS].arg), &num_jobs), "invalid number of jobs: %s", opts[JOBS].arg);
+        rg->m_parse_queue.set_jobs(num_jobs);
+    }
 
     if(rg->empty()) return 0;
 
     csubstr cmd = to_csubstr(opts(CMD));
     C4_CHECK(valid_cmd(cmd));
 
-    if(cmd == "generate")
+    std::vector<std::string> file_names;
+    collect_files(opts.posn_args(), &file_names);
+    std::vector<const char*> files;
+    for(auto const& f : file_names)
+    {
+        files.push_back(f.c_str());
+    }
+
+    if(cmd == "generate" && opts[FROMSNAP])
+    {
+        rg->gencode_from_snapshots(files);
+        if(opts[STATS])
+        {
+            rg->print_stats();
+        }
+    }
+    else if(cmd == "generate")
     {
         if(opts[DIR])
         {
-            rg->gencode(opts.posn_args(), opts[DIR].arg);
+            C4_CHECK_MSG( ! opts[UNITY], "--unity cannot be used with --dir");
+            rg->gencode(files, opts[DIR].arg);
         }
         else
         {
@@ -62,12 +149,62 @@ inline int exec(regen::Regen *rg, int argc, const char *argv[], bool skip_exe_na
             {
                 flags.push_back(f.arg);
             }
-            rg->gencode(opts.posn_args(), nullptr, flags.data(), flags.size());
+            if(opts[UNITY])
+            {
+                rg->gencode_unity(files, flags.data(), flags.size());
+            }
+            else
+            {
+                rg->gencode(files, nullptr, flags.data(), flags.size());
+            }
+        }
+        if(opts[STATS])
+        {
+            rg->print_stats();
+        }
+    }
+    else if(cmd == "extract" || cmd == "dump")
+    {
+        C4_CHECK_MSG( ! opts[UNITY], "--unity cannot be used with --cmd %.*s", (int)cmd.len, cmd.str);
+        std::vector<const char*> flags;
+        for(auto const& f : opts.opts(FLAGS))
+        {
+            flags.push_back(f.arg);
+        }
+        const char *db_dir = opts[DIR] ? opts[DIR].arg : nullptr;
+        if(cmd == "extract")
+        {
+            rg->extract(files, db_dir, flags.data(), flags.size());
+        }
+        else
+        {
+            rg->dump(files, db_dir, flags.data(), flags.size());
+        }
+        if(opts[STATS])
+        {
+            rg->print_stats();
         }
     }
     else if(cmd == "outfiles")
     {
-        rg->print_output_filenames(opts.posn_args());
+        if(opts[MAP] && opts[MAP_HEADERS])
+        {
+            std::vector<const char*> flags;
+            for(auto const& f : opts.opts(FLAGS))
+            {
+                flags.push_back(f.arg);
+            }
+            const char *db_dir = opts[DIR] ? opts[DIR].arg : nullptr;
+            rg->print_output_map_with_headers(files, db_dir, flags.data(), flags.size());
+        }
+        else if(opts[MAP])
+        {
+            rg->print_output_map(files);
+        }
+        else
+        {
+            rg->print_output_filenames(files);
+        }
     }
     else
     {
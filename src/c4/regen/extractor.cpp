@@ -141,7 +141,7 @@ Extractor::Data Extractor::extract(SourceFile c$$ sf, c4::ast::Cursor c) const
                     }
                     else if(m_type == EXTR_TAGGED_MACRO_ANNOTATED)
                     {
-                        csubstr annotations = c.tag_annotations(sf.m_str);
+                        csubstr annotations = c.tag_annotations(sf.m_tu->file_contents(c.file()));
                         annotation_ok = has_true_annotation(annotations, to_csubstr(m_entry));
                     }
                     else
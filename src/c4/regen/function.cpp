@@ -26,6 +26,29 @@ void Function::init(astEntityRef e)
     }
 }
 
+void Function::create_prop_tree(c4::yml::NodeRef n) const
+{
+    auto params = n["parameters"];
+    params |= yml::SEQ;
+    for(auto c$$ p : m_parameters)
+    {
+        auto pn = params.append_child();
+        pn |= yml::MAP;
+        p.create_prop_tree(pn);
+    }
+    TaggedEntity::create_prop_tree(n);
+}
+
+void Function::hash(Hasher $$ h, bool with_region) const
+{
+    h((uint64_t)m_parameters.size());
+    for(auto c$$ p : m_parameters)
+    {
+        p.hash(h, with_region);
+    }
+    TaggedEntity::hash(h, with_region);
+}
+
 
 } // namespace regen
 } // namespace c4
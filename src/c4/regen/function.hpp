@@ -27,6 +27,8 @@ struct Function : public TaggedEntity
     std::vector<FunctionParameter> m_parameters;
 
     virtual void init(astEntityRef e) override;
+    virtual void create_prop_tree(c4::yml::NodeRef n) const override;
+    virtual void hash(Hasher $$ h, bool with_region) const override;
 };
 
 
@@ -3,6 +3,8 @@
 
 #include <c4/tpl/engine.hpp>
 #include "c4/regen/entity.hpp"
+#include "c4/regen/compiled_template.hpp"
+#include "c4/regen/template_library.hpp"
 #include "c4/regen/extractor.hpp"
 
 #include <c4/c4_push.hpp>
@@ -31,27 +33,45 @@ struct CodeInstances
 
 struct CodeTemplate
 {
-    std::shared_ptr<c4::tpl::Engine> engine;
-    c4::tpl::Rope parsed_rope;
+    std::shared_ptr<ParsedTemplate> parsed;
+    std::shared_ptr<c4::tpl::Engine> engine; ///< the engine of the parsed template
+    std::shared_ptr<CompiledTemplate> compiled;
+    uint64_t src_hash{0};     ///< the hash of the template source
+    bool     uses_region{false}; ///< whether the template may read the entity regions
 
     bool empty() const { return engine.get() == nullptr; }
 
-    bool load(c4::yml::NodeRef const n, csubstr name, csubstr fallback_tpl={})
+    /** @param entity_type when given, the template is also compiled to
+     * render entities of this type without their property tree
+     * @param lib when given, the includes of the template are expanded,
+     * and the template is shared with the other templates of the
+     * library with the same source */
+    bool load(c4::yml::NodeRef const n, csubstr name, csubstr fallback_tpl={}, EntityType_e entity_type=_ENT_NONE, TemplateLibrary $ lib=nullptr)
     {
+        parsed.reset();
         engine.reset();
+        compiled.reset();
         csubstr src = fallback_tpl;
         if(n.valid())
         {
             n.get_if(name, &src);
         }
+        src_hash = hash_str(src);
+        uses_region = false;
         if(src.not_empty())
         {
-            engine = std::make_shared<c4::tpl::Engine>();
-            engine->parse(src, &parsed_rope);
+            parsed = lib ? lib->get(src) : ParsedTemplate::create(src, src_hash);
+            engine = std::shared_ptr<c4::tpl::Engine>(parsed, &parsed->m_engine);
+            compiled = parsed->compiled(entity_type);
+            src_hash = parsed->m_hash;
+            uses_region = parsed->m_uses_region;
         }
         return ! empty();
     }
 
+    /** whether entities can be rendered without their property tree */
+    bool is_compiled() const { return compiled != nullptr; }
+
     void render(c4::yml::NodeRef properties, c4::tpl::Rope *r) const
     {
         engine->render(properties, r);
@@ -73,6 +93,26 @@ struct CodeChunk : public CodeInstances<c4::tpl::Rope>
 };
 
 
+/** appends code to the chunk of an entity, for generators written in
+ * C++. The code is copied to the strings of the source file, which live
+ * as long as the chunk, so it can be formatted in a scratch buffer. */
+struct CodeWriter
+{
+    CodeChunk             $ m_chunk;
+    ast::StringCollection $ m_strings;
+
+    void hdr(csubstr code) { _append(&m_chunk->m_hdr, code); }
+    void inl(csubstr code) { _append(&m_chunk->m_inl, code); }
+    void src(csubstr code) { _append(&m_chunk->m_src, code); }
+
+    void _append(c4::tpl::Rope $ r, csubstr code)
+    {
+        if(code.empty()) return;
+        r->append(csubstr(m_strings->store(code), code.len));
+    }
+};
+
+
 //-----------------------------------------------------------------------------
 
 struct CodePreamble
@@ -105,6 +145,8 @@ struct Generator : public CodeInstances<CodeTemplate>
     EntityType_e m_entity_type;
     csubstr      m_name;
     bool         m_empty;
+    uint64_t     m_tpl_hash{0};        ///< the hash of the templates, which keys the rendered chunks
+    bool         m_uses_region{false}; ///< whether any template may read the entity regions
 
     Generator() :
         CodeInstances<CodeTemplate>(),
@@ -123,21 +165,65 @@ struct Generator : public CodeInstances<CodeTemplate>
     Generator(Generator &&) = default;
     Generator& operator= (Generator &&) = default;
 
-    void load(c4::yml::NodeRef n)
+    void load(c4::yml::NodeRef n, TemplateLibrary $ lib=nullptr)
     {
         m_name = n["name"].val();
         m_extractor.load(n["extract"]);
-        load_templates(n);
+        load_templates(n, lib);
     }
 
-    void generate(Entity c$$ o, c4::yml::NodeRef root, CodeChunk *ch) const
+    /** render the code of an entity. The compiled templates read the
+     * entity directly; the property tree of the entity is built in root
+     * only if any of the templates needs it.
+     * @param strings keeps the code written by generate_code() */
+    void generate(Entity c$$ o, c4::yml::NodeRef root, CodeChunk *ch, ast::StringCollection $ strings) const
     {
         ch->m_generator = this;
         ch->m_originator = &o;
+        ch->m_hdr.clear();
+        ch->m_inl.clear();
+        ch->m_src.clear();
+        CodeWriter w{ch, strings};
+        if(generate_code(o, w)) return;
+        bool has_tree = false;
+        _generate(o, root, m_hdr, &ch->m_hdr, &has_tree);
+        _generate(o, root, m_inl, &ch->m_inl, &has_tree);
+        _generate(o, root, m_src, &ch->m_src, &has_tree);
+    }
+
+    /** write the code of an entity with C++ rather than with the
+     * templates. This is overridden by the generators of plugins; see
+     * plugin.hpp.
+     * @return false to render the templates instead */
+    virtual bool generate_code(Entity c$$ o, CodeWriter $$ w) const
+    {
+        C4_UNUSED(o);
+        C4_UNUSED(w);
+        return false;
+    }
+
+    void _generate(Entity c$$ o, c4::yml::NodeRef root, CodeTemplate c$$ ctpl, c4::tpl::Rope $ dst, bool $ has_tree) const
+    {
+        if(ctpl.empty())
+        {
+            dst->clear();
+            return;
+        }
+        if(ctpl.is_compiled() && ctpl.compiled->render(o, dst))
+        {
+            return;
+        }
+        _create_prop_tree(o, root, has_tree);
+        ctpl.render(root, dst);
+    }
+
+    void _create_prop_tree(Entity c$$ o, c4::yml::NodeRef root, bool $ has_tree) const
+    {
+        if(*has_tree) return;
         root.clear_children();
         root |= yml::MAP;
         o.create_prop_tree(root);
-        render(root, ch);
+        *has_tree = true;
     }
 
     void render(c4::yml::NodeRef const properties, CodeChunk *ch) const
@@ -159,15 +245,19 @@ struct Generator : public CodeInstances<CodeTemplate>
         }
     }
 
-    void load_templates(c4::yml::NodeRef const n)
+    void load_templates(c4::yml::NodeRef const n, TemplateLibrary $ lib=nullptr)
     {
         m_empty  = false;
         m_empty |= m_preambles.m_hdr.load(n, "hdr_preamble");
         m_empty |= m_preambles.m_inl.load(n, "inl_preamble");
         m_empty |= m_preambles.m_src.load(n, "src_preamble");
-        m_empty |= m_hdr         .load(n, "hdr");
-        m_empty |= m_inl         .load(n, "inl");
-        m_empty |= m_src         .load(n, "src");
+        m_empty |= m_hdr         .load(n, "hdr", {}, m_entity_type, lib);
+        m_empty |= m_inl         .load(n, "inl", {}, m_entity_type, lib);
+        m_empty |= m_src         .load(n, "src", {}, m_entity_type, lib);
+        Hasher h;
+        h((uint64_t)m_entity_type)(m_hdr.src_hash)(m_inl.src_hash)(m_src.src_hash);
+        m_tpl_hash = h.value();
+        m_uses_region = m_hdr.uses_region || m_inl.uses_region || m_src.uses_region;
     }
 
 };
@@ -0,0 +1,69 @@
+#ifndef _c4_REGEN_HASH_HPP_
+#define _c4_REGEN_HASH_HPP_
+
+#include <cstdint>
+#include <string>
+
+#include <c4/substr.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** an incremental FNV-1a 64-bit hash, used to key the caches */
+struct Hasher
+{
+    uint64_t m_val{14695981039346656037ull};
+
+    Hasher& operator() (csubstr s)
+    {
+        for(char c : s)
+        {
+            m_val ^= (uint64_t)(uint8_t)c;
+            m_val *= 1099511628211ull;
+        }
+        // mark the end of the string, so that ("ab","c") != ("a","bc")
+        m_val ^= 0xffu;
+        m_val *= 1099511628211ull;
+        return *this;
+    }
+
+    Hasher& operator() (uint64_t v)
+    {
+        for(int i = 0; i < 8; ++i)
+        {
+            m_val ^= (v >> (8 * i)) & 0xffu;
+            m_val *= 1099511628211ull;
+        }
+        return *this;
+    }
+
+    uint64_t value() const { return m_val; }
+
+    /** get the hash as a fixed-size hexadecimal string */
+    std::string hex() const { return to_hex(m_val); }
+
+    static std::string to_hex(uint64_t v)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string s(16, '0');
+        for(int i = 15; i >= 0; --i, v >>= 4)
+        {
+            s[(size_t)i] = digits[v & 0xfu];
+        }
+        return s;
+    }
+};
+
+inline uint64_t hash_str(csubstr s)
+{
+    return Hasher{}(s).value();
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_HASH_HPP_ */
@@ -0,0 +1,142 @@
+#include "c4/regen/manifest.hpp"
+
+#include <c4/charconv.hpp>
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+
+#include <sys/stat.h>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+bool FileManifest::hash_file(const char *filename, uint64_t $ hash)
+{
+    if( ! c4::fs::path_exists(filename)) return false;
+    std::string contents;
+    c4::fs::file_get_contents(filename, &contents);
+    *hash = hash_str(to_csubstr(contents));
+    return true;
+}
+
+bool FileManifest::stat_file(const char *filename, uint64_t $ size, uint64_t $ mtime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if(::_stat64(filename, &st) != 0) return false;
+#else
+    struct stat st;
+    if(::stat(filename, &st) != 0) return false;
+#endif
+    *size = (uint64_t)st.st_size;
+    *mtime = (uint64_t)st.st_mtime;
+    return true;
+}
+
+void FileManifest::add(csubstr file)
+{
+    m_entries.emplace_back();
+    Entry &e = m_entries.back();
+    e.file.assign(file.str, file.len);
+    e.hash = e.size = e.mtime = 0;
+    // stat first, so that a change while hashing makes the time stale
+    stat_file(e.file.c_str(), &e.size, &e.mtime);
+    hash_file(e.file.c_str(), &e.hash);
+}
+
+void FileManifest::add_files(std::vector<std::string> const& files)
+{
+    for(auto const& f : files)
+    {
+        add(to_csubstr(f));
+    }
+}
+
+bool FileManifest::is_current() const
+{
+    for(auto const& e : m_entries)
+    {
+        uint64_t size, mtime, h;
+        if( ! stat_file(e.file.c_str(), &size, &mtime) || size != e.size)
+        {
+            return false;
+        }
+        // a file modified in the second the manifest was written may
+        // have changed since with the same time
+        if(mtime == e.mtime && mtime < m_time)
+        {
+            continue;
+        }
+        if( ! hash_file(e.file.c_str(), &h) || h != e.hash)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FileManifest::save(const char *filename) const
+{
+    std::string out;
+    for(auto const& e : m_entries)
+    {
+        out += Hasher::to_hex(e.hash);
+        out += ' ';
+        out += std::to_string(e.size);
+        out += ' ';
+        out += std::to_string(e.mtime);
+        out += ' ';
+        out += e.file;
+        out += '\n';
+    }
+    c4::fs::file_put_contents(filename, to_csubstr(out));
+}
+
+bool FileManifest::load(const char *filename)
+{
+    clear();
+    uint64_t size;
+    if( ! stat_file(filename, &size, &m_time)) return false;
+    std::string contents;
+    c4::fs::file_get_contents(filename, &contents);
+    csubstr rem = to_csubstr(contents);
+    while( ! rem.empty())
+    {
+        size_t pos = rem.find('\n');
+        csubstr line = pos != csubstr::npos ? rem.first(pos) : rem;
+        rem = pos != csubstr::npos ? rem.sub(pos + 1) : csubstr{};
+        if(line.empty()) continue;
+        // <16 hex digits> <size> <mtime> <file name>
+        if(line.len < 18 || line[16] != ' ') return false;
+        uint64_t h = 0;
+        for(char c : line.first(16))
+        {
+            h <<= 4;
+            if(c >= '0' && c <= '9') h |= (uint64_t)(c - '0');
+            else if(c >= 'a' && c <= 'f') h |= (uint64_t)(c - 'a' + 10);
+            else return false;
+        }
+        m_entries.emplace_back();
+        Entry &e = m_entries.back();
+        e.hash = h;
+        csubstr rest = line.sub(17);
+        size_t s0 = rest.find(' ');
+        size_t s1 = s0 != csubstr::npos ? rest.find(' ', s0 + 1) : csubstr::npos;
+        if(s1 == csubstr::npos
+           || ! c4::from_chars(rest.first(s0), &e.size)
+           || ! c4::from_chars(rest.range(s0 + 1, s1), &e.mtime))
+        {
+            m_entries.clear();
+            return false;
+        }
+        csubstr file = rest.sub(s1 + 1);
+        e.file.assign(file.str, file.len);
+    }
+    return true;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
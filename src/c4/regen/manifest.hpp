@@ -0,0 +1,61 @@
+#ifndef _c4_REGEN_MANIFEST_HPP_
+#define _c4_REGEN_MANIFEST_HPP_
+
+#include <string>
+#include <vector>
+
+#include "c4/regen/hash.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** A list of files with the hash of their contents. This is stored next
+ * to a cached artifact (eg a precompiled header) to find out whether
+ * any of the inputs used to produce it has since changed.
+ *
+ * The size and the modification time of each file are recorded too, so
+ * that checking the manifest does not read the files: a file with
+ * another size has changed, and a file with the same size and time is
+ * unchanged. Only the files with the same size and another time (or
+ * modified in the second the manifest was written) are hashed again. */
+struct FileManifest
+{
+    struct Entry
+    {
+        std::string file;
+        uint64_t    hash;
+        uint64_t    size;
+        uint64_t    mtime;
+    };
+    std::vector<Entry> m_entries;
+    uint64_t m_time{0}; ///< the modification time of the loaded manifest
+
+public:
+
+    void clear() { m_entries.clear(); m_time = 0; }
+
+    /** add a file, hashing its current contents */
+    void add(csubstr file);
+    void add_files(std::vector<std::string> const& files);
+
+    /** @return true if all the files still exist and have the same contents */
+    bool is_current() const;
+
+    void save(const char *filename) const;
+    /** @return false if the manifest file does not exist or is malformed */
+    bool load(const char *filename);
+
+    static bool hash_file(const char *filename, uint64_t $ hash);
+    /** get the size and the modification time (in seconds) of a file
+     * @return false if the file does not exist */
+    static bool stat_file(const char *filename, uint64_t $ size, uint64_t $ mtime);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_MANIFEST_HPP_ */
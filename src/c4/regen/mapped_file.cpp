@@ -0,0 +1,75 @@
+#include "c4/regen/mapped_file.hpp"
+
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+bool MappedFile::open(const char *filename)
+{
+    close();
+    if( ! c4::fs::path_exists(filename)) return false;
+#ifndef _WIN32
+    int fd = ::open(filename, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED)
+        {
+            m_data = static_cast<char c$>(p);
+            m_size = (size_t)st.st_size;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+    if( ! m_mapped)
+    {
+        c4::fs::file_get_contents(filename, &m_buf);
+        m_data = m_buf.data();
+        m_size = m_buf.size();
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if(m_mapped)
+    {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_buf.clear();
+}
+
+void MappedFile::_move(MappedFile $ that)
+{
+    m_mapped = that->m_mapped;
+    m_size = that->m_size;
+    m_buf = std::move(that->m_buf);
+    m_data = m_mapped ? that->m_data : (that->m_data ? m_buf.data() : nullptr);
+    that->m_data = nullptr;
+    that->m_size = 0;
+    that->m_mapped = false;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,58 @@
+#ifndef _c4_REGEN_MAPPED_FILE_HPP_
+#define _c4_REGEN_MAPPED_FILE_HPP_
+
+#include <string>
+
+#include <c4/substr.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** A read-only view of the contents of a file. The file is mapped into
+ * memory where possible (POSIX), or otherwise read into a buffer. The
+ * mapped data is suitably aligned for any record type. */
+struct MappedFile
+{
+    char  c$ m_data{nullptr};
+    size_t   m_size{0};
+    bool     m_mapped{false};
+    std::string m_buf; ///< the file contents, when mapping is not possible
+
+public:
+
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator= (MappedFile const&) = delete;
+
+    MappedFile(MappedFile &&that) { _move(&that); }
+    MappedFile& operator= (MappedFile &&that) { close(); _move(&that); return *this; }
+
+    /** @return false if the file does not exist or cannot be read */
+    bool open(const char *filename);
+    void close();
+
+    bool valid() const { return m_data != nullptr; }
+    csubstr contents() const { return csubstr(m_data, m_size); }
+
+    /** @return true if count records of the given size starting at the
+     * given offset are within the file */
+    bool fits(size_t offset, size_t count, size_t record_size) const
+    {
+        return offset <= m_size && count * record_size <= m_size - offset;
+    }
+
+private:
+
+    void _move(MappedFile $ that);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_MAPPED_FILE_HPP_ */
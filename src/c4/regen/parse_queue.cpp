@@ -0,0 +1,154 @@
+#include "c4/regen/parse_queue.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void ParseQueue::load(c4::yml::NodeRef const root)
+{
+    size_t num_jobs = 1;
+    root.get_if("jobs", &num_jobs, size_t(1));
+    set_jobs(num_jobs);
+}
+
+void ParseQueue::set_jobs(size_t num_jobs)
+{
+    m_num_jobs = num_jobs;
+}
+
+size_t ParseQueue::num_jobs() const
+{
+    if(m_num_jobs > 0) return m_num_jobs;
+    size_t n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+void ParseQueue::start(size_t num_files, parse_fn parse)
+{
+    _stop();
+    size_t jobs = num_jobs();
+    if(jobs > num_files) jobs = num_files;
+    size_t num_slots = jobs > 1 ? 2 * jobs : 1;
+    if(m_slots.size() != num_slots)
+    {
+        m_slots.clear();
+        for(size_t i = 0; i < num_slots; ++i)
+        {
+            m_slots.emplace_back(new Slot);
+        }
+    }
+    for(auto &s : m_slots)
+    {
+        s->m_ready = false;
+    }
+    m_parse = std::move(parse);
+    m_num_files = num_files;
+    m_next = 0;
+    m_released = 0;
+    m_stop = false;
+    if(jobs > 1)
+    {
+        for(size_t i = 0; i < jobs; ++i)
+        {
+            m_threads.emplace_back(&ParseQueue::_work, this);
+        }
+    }
+}
+
+void ParseQueue::_work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        // wait until the slot of the next file is released
+        m_cv.wait(lock, [this]{
+            return m_stop || m_next >= m_num_files || m_next < m_released + m_slots.size();
+        });
+        if(m_stop || m_next >= m_num_files) return;
+        size_t ifile = m_next++;
+        Slot &s = _slot(ifile);
+        lock.unlock();
+        s.m_unit.clear();
+        m_parse(ifile, s.m_idx, &s.m_unit);
+        lock.lock();
+        s.m_file = ifile;
+        s.m_ready = true;
+        m_cv.notify_all();
+    }
+}
+
+ast::TranslationUnit $$ ParseQueue::wait(size_t ifile)
+{
+    C4_CHECK(ifile < m_num_files);
+    Slot &s = _slot(ifile);
+    if(m_threads.empty())
+    {
+        s.m_unit.clear();
+        m_parse(ifile, s.m_idx, &s.m_unit);
+        s.m_file = ifile;
+        s.m_ready = true;
+        return s.m_unit;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [&s, ifile]{ return s.m_ready && s.m_file == ifile; });
+    return s.m_unit;
+}
+
+void ParseQueue::release(size_t ifile)
+{
+    C4_CHECK(ifile == m_released);
+    Slot &s = _slot(ifile);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if( ! m_threads.empty())
+    {
+        if(m_next == ifile)
+        {
+            // not claimed by a worker yet, so it will not be parsed
+            ++m_next;
+        }
+        else
+        {
+            // a worker may still be parsing it into the slot
+            m_cv.wait(lock, [&s, ifile]{ return s.m_ready && s.m_file == ifile; });
+        }
+    }
+    if(s.m_ready && s.m_file == ifile)
+    {
+        s.m_ready = false;
+        s.m_unit.clear();
+    }
+    m_released = ifile + 1;
+    m_cv.notify_all();
+}
+
+void ParseQueue::finish(ast::StringCollection $ strings)
+{
+    _stop();
+    for(auto &s : m_slots)
+    {
+        s->m_unit.clear();
+        s->m_ready = false;
+        strings->merge(std::move(s->m_idx.m_strings));
+    }
+    m_parse = nullptr;
+}
+
+void ParseQueue::_stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_cv.notify_all();
+    }
+    for(auto &t : m_threads)
+    {
+        t.join();
+    }
+    m_threads.clear();
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,99 @@
+#ifndef _c4_REGEN_PARSE_QUEUE_HPP_
+#define _c4_REGEN_PARSE_QUEUE_HPP_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <c4/yml/node.hpp>
+#include "c4/ast/ast.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** Parses the units of a run ahead of their use, in a pool of worker
+ * threads. The units are handed out in the order of the files, so the
+ * generated code does not depend on the number of jobs. With a single
+ * job there are no threads: each unit is parsed on the calling thread
+ * when it is requested.
+ *
+ * Each unit in flight is parsed with its own clang index, so the cursors
+ * of a unit can be used on the calling thread while the workers parse
+ * the next units. At most twice as many units as jobs are alive at any
+ * time.
+ *
+ * YAML config example (this can also be set with -j/--jobs):
+ *
+ * @begincode
+ * jobs: 8   # 0 uses one job per hardware thread
+ * @endcode
+ */
+struct ParseQueue
+{
+    /** parse the file at index ifile into the unit, using the given index */
+    using parse_fn = std::function<void(size_t ifile, ast::Index $$ idx, ast::TranslationUnit $ unit)>;
+
+    struct Slot
+    {
+        ast::Index           m_idx;
+        ast::TranslationUnit m_unit;
+        size_t               m_file{0};
+        bool                 m_ready{false};
+    };
+
+    size_t m_num_jobs{1};
+
+    parse_fn                           m_parse;
+    size_t                             m_num_files{0};
+    size_t                             m_next{0};     ///< the next file to parse
+    size_t                             m_released{0}; ///< the files before this were released
+    bool                               m_stop{false};
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    std::vector<std::thread>           m_threads;
+    std::mutex                         m_mutex;
+    std::condition_variable            m_cv;
+
+public:
+
+    ~ParseQueue() { _stop(); }
+
+    void load(c4::yml::NodeRef const root);
+    void set_jobs(size_t num_jobs);
+
+    /** the number of jobs used in a run */
+    size_t num_jobs() const;
+
+    /** start parsing the files of a run */
+    void start(size_t num_files, parse_fn parse);
+
+    /** get the unit of a file, waiting for it to be parsed. The files
+     * must be requested in order. */
+    ast::TranslationUnit $$ wait(size_t ifile);
+
+    /** release the unit of a file, so that its slot can be used for the
+     * next files. Every file must be released in order, even if its
+     * unit was not requested. */
+    void release(size_t ifile);
+
+    /** finish the run, and move the strings stored in the indices of the
+     * units into the given collection */
+    void finish(ast::StringCollection $ strings);
+
+private:
+
+    Slot $$ _slot(size_t ifile) { return *m_slots[ifile % m_slots.size()]; }
+    void _work();
+    void _stop();
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_PARSE_QUEUE_HPP_ */
@@ -0,0 +1,215 @@
+#include "c4/regen/pch.hpp"
+
+#include "c4/regen/hash.hpp"
+#include "c4/regen/manifest.hpp"
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void SharedPch::load(c4::yml::NodeRef const root)
+{
+    m_enabled = false;
+    m_cfg_headers.clear();
+    m_dir = ".c4regen";
+    m_pch_file.clear();
+
+    c4::yml::NodeRef n = root.find_child("pch");
+    if( ! n.valid()) return;
+    if(n.is_keyval())
+    {
+        C4_CHECK_MSG(n.val() == "auto", "pch: expected 'auto' or a map");
+        m_enabled = true;
+        return;
+    }
+    m_enabled = true;
+    c4::yml::NodeRef h = n.find_child("headers");
+    if(h.valid())
+    {
+        for(auto const ch : h.children())
+        {
+            csubstr hdr = ch.val().trim(' ');
+            if(hdr.empty()) continue;
+            m_cfg_headers.emplace_back();
+            std::string &s = m_cfg_headers.back();
+            if(hdr.begins_with('<') || hdr.begins_with('"'))
+            {
+                s.assign(hdr.str, hdr.len);
+            }
+            else
+            {
+                s = '"';
+                s.append(hdr.str, hdr.len);
+                s += '"';
+            }
+        }
+    }
+    csubstr dir;
+    n.get_if("dir", &dir);
+    if( ! dir.empty())
+    {
+        m_dir.assign(dir.str, dir.len);
+    }
+}
+
+void SharedPch::detect_prefix(csubstr src, std::vector<std::string> $ includes)
+{
+    includes->clear();
+    csubstr guard;
+    bool in_comment = false;
+    while( ! src.empty())
+    {
+        size_t pos = src.find('\n');
+        csubstr line = (pos != csubstr::npos ? src.first(pos) : src).trim(" \t\r");
+        src = pos != csubstr::npos ? src.sub(pos + 1) : csubstr{};
+        if(in_comment)
+        {
+            size_t e = line.find("*/");
+            if(e == csubstr::npos) continue;
+            in_comment = false;
+            line = line.sub(e + 2).trim(" \t\r");
+        }
+        if(line.begins_with("/*"))
+        {
+            size_t e = line.find("*/");
+            if(e == csubstr::npos)
+            {
+                in_comment = true;
+                continue;
+            }
+            line = line.sub(e + 2).trim(" \t\r");
+        }
+        if(line.empty() || line.begins_with("//") || line == "#pragma once")
+        {
+            continue;
+        }
+        if(line.begins_with("#ifndef ") && guard.empty() && includes->empty())
+        {
+            guard = line.sub(8).trim(' ');
+            continue;
+        }
+        if(line.begins_with("#define ") && ! guard.empty() && line.sub(8).trim(' ') == guard)
+        {
+            continue;
+        }
+        if(line.begins_with("#include"))
+        {
+            csubstr spec = line.sub(8).trim(' ');
+            if(spec.begins_with('<'))
+            {
+                size_t e = spec.find('>');
+                if(e != csubstr::npos)
+                {
+                    spec = spec.first(e + 1);
+                    includes->emplace_back(spec.str, spec.len);
+                    continue;
+                }
+            }
+        }
+        // anything else ends the prefix
+        break;
+    }
+}
+
+void SharedPch::setup(const char* const* files, size_t num_files, const char* const* flags, size_t num_flags)
+{
+    m_pch_file.clear();
+    m_num_headers = 0;
+    m_rebuilt = false;
+    if( ! m_enabled || num_files == 0) return;
+
+    // find the headers to precompile
+    std::vector<std::string> headers;
+    if( ! m_cfg_headers.empty())
+    {
+        headers = m_cfg_headers;
+    }
+    else
+    {
+        std::string contents;
+        std::vector<std::string> prefix;
+        for(size_t i = 0; i < num_files; ++i)
+        {
+            c4::fs::file_get_contents(files[i], &contents);
+            detect_prefix(to_csubstr(contents), &prefix);
+            if(i == 0)
+            {
+                headers = prefix;
+                continue;
+            }
+            size_t common = 0;
+            while(common < headers.size() && common < prefix.size() && headers[common] == prefix[common])
+            {
+                ++common;
+            }
+            headers.resize(common);
+            if(headers.empty()) break;
+        }
+    }
+    if(headers.empty()) return;
+    m_num_headers = headers.size();
+
+    // name the pch after everything that affects its contents
+    Hasher h;
+    {
+        CXString v = clang_getClangVersion();
+        h(to_csubstr(clang_getCString(v)));
+        clang_disposeString(v);
+    }
+    for(size_t i = 0; i < num_flags; ++i)
+    {
+        h(to_csubstr(flags[i]));
+    }
+    for(auto const& hdr : headers)
+    {
+        h(to_csubstr(hdr));
+    }
+    std::string base = m_dir + "/c4regen-" + h.hex();
+    std::string hdr_file = base + ".hpp";
+    std::string pch_file = base + ".pch";
+    std::string mnf_file = base + ".deps";
+
+    // reuse the pch if none of its inputs changed
+    FileManifest mnf;
+    if(c4::fs::path_exists(pch_file.c_str()) && mnf.load(mnf_file.c_str()) && mnf.is_current())
+    {
+        m_pch_file = pch_file;
+        return;
+    }
+
+    std::string dir = m_dir;
+    c4::fs::mkdirs(&dir[0]);
+    std::string src;
+    for(auto const& hdr : headers)
+    {
+        src += "#include ";
+        src += hdr;
+        src += '\n';
+    }
+    c4::fs::file_put_contents(hdr_file.c_str(), to_csubstr(src));
+
+    std::vector<const char*> args(flags, flags + num_flags);
+    args.push_back("-x");
+    args.push_back("c++-header");
+    ast::Index idx;
+    ast::TranslationUnit tu;
+    tu.reset(idx, hdr_file.c_str(), args.data(), args.size(),
+             ast::default_options|CXTranslationUnit_ForSerialization|CXTranslationUnit_Incomplete);
+    tu.save(pch_file.c_str());
+
+    std::vector<std::string> inclusions;
+    tu.inclusions(&inclusions);
+    mnf.clear();
+    mnf.add_files(inclusions);
+    mnf.save(mnf_file.c_str());
+
+    m_pch_file = pch_file;
+    m_rebuilt = true;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
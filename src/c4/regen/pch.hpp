@@ -0,0 +1,86 @@
+#ifndef _c4_REGEN_PCH_HPP_
+#define _c4_REGEN_PCH_HPP_
+
+#include <string>
+#include <vector>
+
+#include <c4/yml/node.hpp>
+#include "c4/ast/ast.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** Precompiles the includes common to all the parsed files once per
+ * run, and injects the resulting pch into every parse, so that the
+ * common prefix is not parsed again for each file.
+ *
+ * The pch is named after a hash of the flags and of the included
+ * headers; next to it is a manifest with the hashes of all the files
+ * which went into it. The pch is rebuilt when the manifest is not
+ * current, ie when any of those files changed.
+ *
+ * YAML config examples:
+ *
+ * @begincode
+ * # use the include prefix common to all the source files
+ * pch: auto
+ * @endcode
+ *
+ * @begincode
+ * pch:
+ *   # the headers to precompile. When omitted, the include
+ *   # prefix common to all the source files is used.
+ *   headers: [<vector>, <string>, '"myframework/all.hpp"']
+ *   # where to place the pch. Defaults to .c4regen
+ *   dir: build/c4regen
+ * @endcode
+ *
+ * @note when automatically detecting the prefix, only angle-bracket
+ * includes are considered, as quoted includes depend on the location
+ * of the including file.
+ *
+ * @note the pch must be parsed with the same flags as the files using
+ * it, so it is not used when the flags are obtained from a compilation
+ * database.
+ */
+struct SharedPch
+{
+    bool m_enabled{false};
+    std::vector<std::string> m_cfg_headers; ///< the headers given in the config, if any
+    std::string m_dir{".c4regen"};
+
+    std::string m_pch_file;      ///< the pch used in the current run; empty if none
+    size_t      m_num_headers{0};
+    bool        m_rebuilt{false};
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+
+    bool enabled() const { return m_enabled; }
+    bool active() const { return ! m_pch_file.empty(); }
+
+    /** find or build the pch to use for these files and flags */
+    void setup(const char* const* files, size_t num_files, const char* const* flags, size_t num_flags);
+
+    /** add the arguments for using the pch */
+    void add_args(std::vector<const char*> $ args) const
+    {
+        if(m_pch_file.empty()) return;
+        args->push_back("-include-pch");
+        args->push_back(m_pch_file.c_str());
+    }
+
+    /** get the angle-bracket includes at the beginning of a source file,
+     * ie before any other code */
+    static void detect_prefix(csubstr src, std::vector<std::string> $ includes);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_PCH_HPP_ */
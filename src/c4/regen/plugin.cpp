@@ -0,0 +1,95 @@
+#include "c4/regen/plugin.hpp"
+
+#include "c4/regen/mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void GeneratorPlugin::load(c4::yml::NodeRef const n, TemplateLibrary $ lib)
+{
+    unload();
+    csubstr library;
+    n.get_if("library", &library);
+    C4_CHECK_MSG(library.not_empty(), "plugin generator %.*s: missing library", (int)n["name"].val().len, n["name"].val().str);
+    m_library.assign(library.str, library.len);
+
+#ifdef _WIN32
+    m_handle = ::LoadLibraryA(m_library.c_str());
+    C4_CHECK_MSG(m_handle != nullptr, "%s: could not load the plugin library", m_library.c_str());
+#else
+    m_handle = ::dlopen(m_library.c_str(), RTLD_NOW|RTLD_LOCAL);
+    C4_CHECK_MSG(m_handle != nullptr, "%s: could not load the plugin library: %s", m_library.c_str(), ::dlerror());
+#endif
+
+    using version_fn = int (*)();
+    using create_fn = Generator $ (*)();
+    auto version = (version_fn) _symbol("c4regen_plugin_version");
+    auto create = (create_fn) _symbol("c4regen_create_generator");
+    m_destroy = (destroy_fn) _symbol("c4regen_destroy_generator");
+    C4_CHECK_MSG(version() == C4REGEN_PLUGIN_VERSION, "%s: the plugin has version %d, expected %d",
+                 m_library.c_str(), version(), C4REGEN_PLUGIN_VERSION);
+
+    m_gen = create();
+    C4_CHECK(m_gen != nullptr);
+    C4_CHECK_MSG(m_gen->m_entity_type == ENT_ENUM || m_gen->m_entity_type == ENT_CLASS || m_gen->m_entity_type == ENT_FUNCTION,
+                 "%s: the plugin generator must derive from EnumGenerator, ClassGenerator or FunctionGenerator", m_library.c_str());
+    m_gen->load(n, lib);
+
+    // the code of the plugin is not in the templates, so the chunks it
+    // rendered are keyed by the library too
+    Hasher h;
+    h(m_gen->m_tpl_hash);
+    MappedFile f;
+    if(f.open(m_library.c_str()))
+    {
+        h(f.contents());
+    }
+    else
+    {
+        h(to_csubstr(m_library));
+    }
+    m_gen->m_tpl_hash = h.value();
+}
+
+void GeneratorPlugin::unload()
+{
+    if(m_gen)
+    {
+        m_destroy(m_gen);
+        m_gen = nullptr;
+        m_destroy = nullptr;
+    }
+    if(m_handle)
+    {
+#ifdef _WIN32
+        ::FreeLibrary((HMODULE)m_handle);
+#else
+        ::dlclose(m_handle);
+#endif
+        m_handle = nullptr;
+    }
+}
+
+void $ GeneratorPlugin::_symbol(const char *name) const
+{
+#ifdef _WIN32
+    void $ sym = (void $) ::GetProcAddress((HMODULE)m_handle, name);
+#else
+    void $ sym = ::dlsym(m_handle, name);
+#endif
+    C4_CHECK_MSG(sym != nullptr, "%s: the plugin library does not export %s", m_library.c_str(), name);
+    return sym;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,115 @@
+#ifndef _c4_REGEN_PLUGIN_HPP_
+#define _c4_REGEN_PLUGIN_HPP_
+
+#include <string>
+
+#include "c4/regen/enum.hpp"
+#include "c4/regen/class.hpp"
+#include "c4/regen/function.hpp"
+
+#include <c4/c4_push.hpp>
+
+/** bumped whenever the layout of the entities or of the generators
+ * changes, so that stale plugins are rejected rather than crash */
+#define C4REGEN_PLUGIN_VERSION 1
+
+#ifdef _WIN32
+#   define C4REGEN_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#   define C4REGEN_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/** export the factory of a plugin generator from a shared library. The
+ * generator must derive from EnumGenerator, ClassGenerator or
+ * FunctionGenerator. */
+#define C4REGEN_PLUGIN(GeneratorT)                                      \
+extern "C" C4REGEN_PLUGIN_EXPORT int c4regen_plugin_version()           \
+{                                                                       \
+    return C4REGEN_PLUGIN_VERSION;                                      \
+}                                                                       \
+extern "C" C4REGEN_PLUGIN_EXPORT c4::regen::Generator* c4regen_create_generator() \
+{                                                                       \
+    return new GeneratorT;                                              \
+}                                                                       \
+extern "C" C4REGEN_PLUGIN_EXPORT void c4regen_destroy_generator(c4::regen::Generator *g) \
+{                                                                       \
+    delete g;                                                           \
+}
+
+namespace c4 {
+namespace regen {
+
+/** A generator written in C++ and loaded from a shared library. The
+ * library exports a factory for a generator overriding generate_code(),
+ * which writes the code of each entity straight into its chunk instead
+ * of rendering templates. The generator goes through the same extraction
+ * and writers as the template generators: the name, the extract and the
+ * preambles are read from its config entry.
+ *
+ * @begincode
+ * // mygen.cpp, built into libmygen.so
+ * #include <c4/regen/plugin.hpp>
+ * struct EnumCount : public c4::regen::EnumGenerator
+ * {
+ *     bool generate_code(c4::regen::Entity const& e, c4::regen::CodeWriter &w) const override
+ *     {
+ *         auto const& en = static_cast<c4::regen::Enum const&>(e);
+ *         std::string s;
+ *         c4::catrs(&s, "template<> constexpr size_t enum_count<", en.m_name, ">() { return ", en.m_symbols.size(), "; }\n");
+ *         w.hdr(c4::to_csubstr(s));
+ *         return true;
+ *     }
+ * };
+ * C4REGEN_PLUGIN(EnumCount)
+ * @endcode
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * generators:
+ *   - name: enum_count
+ *     type: plugin
+ *     library: build/libmygen.so
+ *     extract:
+ *       macro: C4_ENUM
+ * @endcode
+ *
+ * The plugin resolves the symbols of c4regen from the executable which
+ * loads it, so it should be built against the same headers and not link
+ * the c4regen library itself.
+ */
+struct GeneratorPlugin
+{
+    using destroy_fn = void (*)(Generator $);
+
+    std::string m_library;
+    void      $ m_handle{nullptr};
+    Generator $ m_gen{nullptr};
+    destroy_fn  m_destroy{nullptr};
+
+public:
+
+    GeneratorPlugin() = default;
+    ~GeneratorPlugin() { unload(); }
+
+    C4_NO_COPY_CTOR(GeneratorPlugin);
+    C4_NO_COPY_ASSIGN(GeneratorPlugin);
+
+    /** open the library of a generator entry, and create and load its
+     * generator */
+    void load(c4::yml::NodeRef const n, TemplateLibrary $ lib=nullptr);
+    void unload();
+
+    Generator $ generator() const { return m_gen; }
+
+private:
+
+    void $ _symbol(const char *name) const;
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_PLUGIN_HPP_ */
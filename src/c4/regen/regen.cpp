@@ -7,22 +7,57 @@ namespace regen {
 
 void Regen::load_config(const char* file_name)
 {
-    // read the yml config and parse it
-    m_config_file_name = file_name;
-    fs::file_get_contents(m_config_file_name.c_str(), &m_config_file_yml);
+    std::string yml;
+    fs::file_get_contents(file_name, &yml);
+    load_config_yml(to_csubstr(yml), file_name);
+}
+
+void Regen::load_config_yml(csubstr yml, const char* name)
+{
+    // keep the yml config and parse it in place
+    m_config_file_name = name;
+    m_config_file_yml.assign(yml.str, yml.len);
     c4::yml::parse(to_csubstr(m_config_file_name), to_substr(m_config_file_yml), &m_config_data);
     c4::yml::NodeRef r = m_config_data.rootref();
     c4::yml::NodeRef n;
 
-    m_writer.load(r);
+    m_templates.load(r);
+    m_writer.load(r, &m_templates);
+    m_pch.load(r);
+    m_ast_cache.load(r);
+    m_snapshots.load(r);
+    m_entity_db.load(r);
+    m_parse_queue.load(r);
+    m_write_queue.load(r);
+    m_render_cache.load(r);
+    m_parallel_render.load(r);
+    if(m_writer.m_type == Writer::SAMEFILE)
+    {
+        // the writer uses the buffers of the units, which are recycled
+        // once the files of a unit are pushed to the write queue
+        m_write_queue.set_depth(0);
+    }
 
     m_gens_all.clear();
     m_gens_enum.clear();
     m_gens_class.clear();
     m_gens_function.clear();
+    m_gens_plugin.clear();
 
     n = r.find_child("generators");
     if( ! n.valid()) return;
+    // m_gens_all points into the vectors, so reserve them all up front
+    size_t num_enum = 0, num_class = 0, num_function = 0;
+    for(auto const ch : n.children())
+    {
+        csubstr gtype = ch["type"].val();
+        num_enum += (gtype == "enum");
+        num_class += (gtype == "class");
+        num_function += (gtype == "function");
+    }
+    m_gens_enum.reserve(num_enum);
+    m_gens_class.reserve(num_class);
+    m_gens_function.reserve(num_function);
     for(auto const ch : n.children())
     {
         csubstr gtype = ch["type"].val();
@@ -38,11 +73,119 @@ void Regen::load_config(const char* file_name)
         {
             _loadgen(ch, &m_gens_function);
         }
+        else if(gtype == "plugin")
+        {
+            m_gens_plugin.emplace_back(new GeneratorPlugin);
+            m_gens_plugin.back()->load(ch, &m_templates);
+            m_gens_all.push_back(m_gens_plugin.back()->generator());
+        }
         else
         {
             C4_ERROR("unknown generator type");
         }
     }
+    m_writer.set_generators(m_gens_all.data(), m_gens_all.size());
+}
+
+void Regen::gencode_buffers(CXUnsavedFile c$ sources, size_t num_sources,
+                            CXUnsavedFile c$ overlays, size_t num_overlays,
+                            const char* c$ flags, size_t num_flags,
+                            std::vector<RenderedFile> $ out)
+{
+    ast::Index idx;
+    ast::TranslationUnit unit;
+    yml::Tree workspace;
+    SourceFile sf;
+    std::vector<CXUnsavedFile> others;
+
+    out->clear();
+    m_registry.clear();
+    m_render_cache.begin_run();
+    m_writer.capture(out);
+    m_writer.begin_files();
+    for(size_t i = 0; i < num_sources; ++i)
+    {
+        CXUnsavedFile c$$ src = sources[i];
+        size_t uid = m_registry.begin_unit(to_csubstr(src.Filename));
+        if(uid == EntityRegistry::npos) continue;
+
+        others.assign(overlays, overlays + num_overlays);
+        for(size_t j = 0; j < num_sources; ++j)
+        {
+            if(j != i) others.push_back(sources[j]);
+        }
+        unit.reset(idx, src.Filename, csubstr(src.Contents, src.Length), flags, num_flags, others.data(), others.size());
+        sf.init_source_file(idx, unit);
+        sf.extract(m_gens_all.data(), m_gens_all.size(), &m_registry, uid);
+        sf.gencode(m_gens_all.data(), m_gens_all.size(), workspace, _render_cache(), &m_parallel_render);
+        m_writer.write(sf);
+        sf.clear();
+        workspace.clear_arena();
+        idx.m_strings.clear();
+    }
+    m_writer.end_files();
+    m_writer.capture(nullptr);
+}
+
+void Regen::_track_deps(SourceFile c$$ sf, std::vector<std::string> c$$ inputs)
+{
+    Writer::set_type outputs;
+    if(sf.m_owners.empty())
+    {
+        m_writer.insert_filenames(sf.m_name, &outputs);
+    }
+    for(csubstr owner : sf.m_owners)
+    {
+        m_writer.insert_filenames(owner, &outputs);
+    }
+    m_deps.add_unit(inputs, outputs);
+}
+
+void Regen::print_stats() const
+{
+    fprintf(stderr, "regen: processed %zu units\n", m_registry.m_num_units);
+    fprintf(stderr, "regen: skipped %zu units whose file was already generated\n", m_registry.m_num_skipped_units);
+    fprintf(stderr, "regen: %zu of the skipped units were not parsed\n", m_registry.m_num_unparsed_units);
+    fprintf(stderr, "regen: skipped %zu duplicate entities from %zu files already claimed by other units\n",
+            m_registry.m_num_skipped_entities, m_registry.m_num_skipped_files);
+    fprintf(stderr, "regen: parsed with %zu jobs\n", m_parse_queue.num_jobs());
+    fprintf(stderr, "regen: wrote %zu files, %zu unchanged files were not written\n", m_writer.num_saved(), m_writer.num_unchanged());
+    if(m_write_queue.m_depth > 0)
+    {
+        fprintf(stderr, "regen: write queue: depth %zu, at most %zu files waiting, full %zu times\n",
+                m_write_queue.m_depth, m_write_queue.m_max_pending, m_write_queue.m_num_full);
+    }
+    fprintf(stderr, "regen: templates: %zu parsed for %zu templates\n", m_templates.num_parsed(), m_templates.num_requests());
+    if(m_ast_cache.enabled())
+    {
+        fprintf(stderr, "regen: ast cache: %zu hits, %zu misses\n", m_ast_cache.m_num_hits.load(), m_ast_cache.m_num_misses.load());
+    }
+    if(m_render_cache.enabled())
+    {
+        fprintf(stderr, "regen: render cache: %zu hits, %zu misses\n", m_render_cache.num_hits(), m_render_cache.num_misses());
+        for(auto c$$ s : m_render_cache.m_stats)
+        {
+            fprintf(stderr, "regen: render cache: %.*s: %zu hits, %zu misses\n",
+                    (int)s.m_gen->m_name.len, s.m_gen->m_name.str, s.m_hits, s.m_misses);
+        }
+    }
+    if(m_snapshots.m_num_saved || m_snapshots.m_num_loaded)
+    {
+        fprintf(stderr, "regen: snapshots: %zu saved, %zu loaded\n", m_snapshots.m_num_saved, m_snapshots.m_num_loaded);
+    }
+    if(m_entity_db.size())
+    {
+        fprintf(stderr, "regen: entity db: %zu entities: %s\n", m_entity_db.size(), m_entity_db.m_file.c_str());
+    }
+    if(m_deps.enabled())
+    {
+        fprintf(stderr, "regen: wrote %zu depfiles\n", m_deps.m_num_written);
+    }
+    if(m_pch.active())
+    {
+        fprintf(stderr, "regen: %s pch with %zu headers: %s\n", m_pch.m_rebuilt ? "built" : "reused",
+                m_pch.m_num_headers, m_pch.m_pch_file.c_str());
+    }
 }
 
 } // namespace regen
@@ -4,7 +4,16 @@
 #include "c4/regen/enum.hpp"
 #include "c4/regen/function.hpp"
 #include "c4/regen/class.hpp"
+#include "c4/regen/plugin.hpp"
 #include "c4/regen/writer.hpp"
+#include "c4/regen/pch.hpp"
+#include "c4/regen/ast_cache.hpp"
+#include "c4/regen/snapshot.hpp"
+#include "c4/regen/entity_db.hpp"
+#include "c4/regen/depfile.hpp"
+#include "c4/regen/parse_queue.hpp"
+#include "c4/regen/write_queue.hpp"
+#include "c4/regen/render_cache.hpp"
 
 #include <c4/c4_push.hpp>
 
@@ -24,12 +33,28 @@ struct Regen
     std::vector<EnumGenerator    > m_gens_enum;
     std::vector<ClassGenerator   > m_gens_class;
     std::vector<FunctionGenerator> m_gens_function;
+    std::vector<std::unique_ptr<GeneratorPlugin>> m_gens_plugin;
     std::vector<Generator*       > m_gens_all;
 
+    TemplateLibrary m_templates; ///< the named templates, and the templates parsed so far
+
     Writer m_writer;
 
     std::vector<SourceFile> m_src_files;
     bool                    m_save_src_files;
+    SourceFileCollector     m_src_files_sink{&m_src_files};
+
+    EntityRegistry          m_registry; ///< makes sure that each file is generated once per run
+    SharedPch               m_pch;      ///< precompiled common includes
+    AstCache                m_ast_cache; ///< serialized units, to skip parsing unchanged files
+    SnapshotStore           m_snapshots; ///< extracted entities, to render without parsing
+    std::vector<Snapshot>   m_snapshot_views; ///< keeps the saved source files' snapshots open
+    EntityDbBuilder         m_entity_db; ///< the entities of the run, for downstream tools
+    DepTracker              m_deps;      ///< the files read to produce the outputs
+    ParseQueue              m_parse_queue; ///< parses the units in parallel
+    WriteQueue              m_write_queue; ///< writes the files while the next units are parsed
+    RenderCache             m_render_cache; ///< the code rendered for each entity, to render only changed entities
+    ParallelRender          m_parallel_render; ///< renders the chunks of large files in several threads
 
     ast::StringCollection   m_strings;
 
@@ -45,62 +70,447 @@ public:
     bool empty() const { return m_gens_all.empty(); }
 
     void load_config(const char* file_name);
+    /** load the config from a YAML buffer. The name is used as the
+     * config file name in diagnostics and depfiles. */
+    void load_config_yml(csubstr yml, const char* name="");
 
     void save_src_files(bool yes) { m_save_src_files = yes; }
 
+    /** print statistics of the last run to stderr */
+    void print_stats() const;
+
 public:
 
     template<class SourceFileNameCollection>
     void gencode(SourceFileNameCollection c$$ collection, const char* db_dir=nullptr, const char* const* flags=nullptr, size_t num_flags=0)
+    {
+        _process(collection, db_dir, flags, num_flags, GENCODE, nullptr);
+    }
+
+    /** generate the code, handing each source file to the sink once its
+     * code is written. The sink is used instead of m_src_files. It is
+     * called from the thread writing the files. @see SourceFileSink */
+    template<class SourceFileNameCollection>
+    void gencode(SourceFileNameCollection c$$ collection, SourceFileSink $$ sink, const char* db_dir=nullptr, const char* const* flags=nullptr, size_t num_flags=0)
+    {
+        _process(collection, db_dir, flags, num_flags, GENCODE, &sink);
+    }
+
+    /** Generate the code of source buffers, with no filesystem I/O:
+     * each buffer is parsed in place of the file with its name, and the
+     * code which would be written for it is rendered into out. This is
+     * meant for editors and other tools working on unsaved files; the
+     * config and its templates stay loaded across calls.
+     *
+     * @param overlays the contents of other files, eg modified headers
+     * included by the sources. The sources are also overlays for each
+     * other. */
+    void gencode_buffers(CXUnsavedFile c$ sources, size_t num_sources,
+                         CXUnsavedFile c$ overlays, size_t num_overlays,
+                         const char* c$ flags, size_t num_flags,
+                         std::vector<RenderedFile> $ out);
+
+    /** parse the files and save their extracted entities to snapshots,
+     * without generating code. The code can then be generated from the
+     * snapshots with gencode_from_snapshots(). */
+    template<class SourceFileNameCollection>
+    void extract(SourceFileNameCollection c$$ collection, const char* db_dir=nullptr, const char* const* flags=nullptr, size_t num_flags=0)
+    {
+        _process(collection, db_dir, flags, num_flags, SNAPSHOT, nullptr);
+    }
+
+    /** parse the files and write all their extracted entities to the
+     * entity database, without generating code. @see EntityDb */
+    template<class SourceFileNameCollection>
+    void dump(SourceFileNameCollection c$$ collection, const char* db_dir=nullptr, const char* const* flags=nullptr, size_t num_flags=0)
+    {
+        m_entity_db.clear();
+        _process(collection, db_dir, flags, num_flags, DUMP, nullptr);
+        m_entity_db.save();
+    }
+
+    /** generate the code from the snapshots previously saved by
+     * extract(), so that no file is parsed. The snapshots must have been
+     * extracted with the same generators and the same files. As in the
+     * parse, a file whose code is in the snapshot of a previous file
+     * is skipped, so it needs no snapshot of its own. */
+    template<class SourceFileNameCollection>
+    void gencode_from_snapshots(SourceFileNameCollection c$$ collection, SourceFileSink $ sink=nullptr)
+    {
+        yml::Tree workspace;
+        SourceFile buf;
+        Snapshot snapshot;
+
+        sink = _begin_sink(sink);
+        m_snapshot_views.clear();
+
+        std::vector<std::string> inputs;
+        m_registry.clear();
+        m_render_cache.begin_run();
+        m_deps.begin_run(to_csubstr(m_config_file_name));
+        m_writer.begin_files();
+        for(const char* filename : collection)
+        {
+            size_t unit = m_registry.begin_unit(to_csubstr(filename));
+            if(unit == EntityRegistry::npos) continue;
+
+            C4_CHECK_MSG(m_snapshots.open(to_csubstr(filename), &snapshot),
+                         "%s: no valid snapshot in %s. Run the extract command first.", filename, m_snapshots.m_dir.c_str());
+            snapshot.restore(&buf, m_gens_all.data(), m_gens_all.size());
+            // the other files whose code is in the snapshot are owned by
+            // this unit, so that their own units are skipped, as in the
+            // parse which extracted the snapshot
+            for(size_t i = 1; i < buf.m_owners.size(); ++i)
+            {
+                m_registry.claim(unit, buf.m_owners[i], {}, {});
+            }
+            buf.gencode(m_gens_all.data(), m_gens_all.size(), workspace, _render_cache(), &m_parallel_render);
+
+            m_writer.write(buf);
+            if(m_deps.enabled())
+            {
+                inputs.resize(1);
+                m_snapshots.path(to_csubstr(filename), &inputs[0]);
+                _track_deps(buf, inputs);
+            }
+            // the restored entities point into the snapshot
+            if(sink && sink->retains())
+            {
+                m_snapshot_views.emplace_back(std::move(snapshot));
+            }
+            _end_file(&buf, nullptr, &workspace, sink);
+        }
+        m_writer.end_files();
+        m_deps.end_run();
+    }
+
+private:
+
+    typedef enum { GENCODE, SNAPSHOT, DUMP, EXTRACT } Process_e;
+
+    template<class SourceFileNameCollection>
+    void _process(SourceFileNameCollection c$$ collection, const char* db_dir, const char* const* flags, size_t num_flags, Process_e what, SourceFileSink $ sink)
     {
         ast::CompilationDb db(db_dir);
         ast::Index idx;
-        ast::TranslationUnit unit;
         yml::Tree workspace;
 
+        std::vector<const char*> files;
+        for(const char* filename : collection)
+        {
+            files.push_back(filename);
+        }
+
         SourceFile buf;
-        if(m_save_src_files)
+        sink = _begin_sink(sink);
+
+        // the flags for each parse, which may use a precompiled header
+        std::vector<const char*> args;
+        if( ! db_dir)
         {
-            size_t fsz = 0;
-            for(const char* filename : collection)
+            args.assign(flags, flags + num_flags);
+            if(m_pch.enabled())
             {
-                C4_UNUSED(filename);
-                fsz++;
+                m_pch.setup(files.data(), files.size(), flags, num_flags);
+                m_pch.add_args(&args);
             }
-            m_src_files.resize(fsz);
         }
 
+        // the units are parsed (possibly in parallel) with their own
+        // index; idx stores the strings of the extracted entities. The
+        // files whose code was already written from a previous unit are
+        // not parsed.
+        m_registry.clear();
+        m_parse_queue.start(files.size(), [&](size_t i, ast::Index $$ uidx, ast::TranslationUnit $ unit) {
+            if(m_registry.skip_parse(to_csubstr(files[i]))) return;
+            _parse(files[i], db_dir ? &db : nullptr, args, uidx, unit);
+        });
+
+        std::vector<std::string> inputs;
+        if(what == GENCODE)
+        {
+            m_render_cache.begin_run();
+            m_deps.begin_run(to_csubstr(m_config_file_name));
+        }
         m_writer.begin_files();
-        size_t ifile = 0;
-        for(const char* filename : collection)
+        // the generated code is written (and handed to the sink) in the
+        // writer thread, so each file owns its strings and workspace
+        // until then
+        const bool retained = sink && sink->retains();
+        if(what == GENCODE)
+        {
+            m_write_queue.start([this, sink](WriteQueue::Item $$ item) {
+                m_writer.write(item.m_sf);
+                if(sink) sink->consume(item.m_sf);
+            });
+        }
+        for(size_t i = 0; i < files.size(); ++i)
         {
-            if( ! m_save_src_files)
+            const char *filename = files[i];
+            // skip files which were already generated from a previous unit
+            size_t uid = m_registry.begin_unit(to_csubstr(filename));
+            if(uid == EntityRegistry::npos)
             {
-                buf.clear();
-                idx.clear();
+                m_parse_queue.release(i);
+                continue;
             }
 
-            SourceFile &sf = m_save_src_files ? m_src_files[ifile++] : buf;
+            ast::TranslationUnit $$ unit = m_parse_queue.wait(i);
+            if(what == GENCODE)
+            {
+                WriteQueue::Item $$ item = m_write_queue.acquire();
+                _recycle(item, &idx, retained);
+                SourceFile &sf = item.m_sf;
+                std::swap(idx.m_strings, item.m_strings);
+                sf.init_source_file(idx, unit);
+                sf.extract(m_gens_all.data(), m_gens_all.size(), &m_registry, uid);
+                sf.gencode(m_gens_all.data(), m_gens_all.size(), item.m_workspace, _render_cache(), &m_parallel_render);
+                std::swap(idx.m_strings, item.m_strings);
+                if(m_deps.enabled())
+                {
+                    unit.inclusions(&inputs);
+                    _track_deps(sf, inputs);
+                }
+                m_write_queue.push(item);
+                m_parse_queue.release(i);
+                continue;
+            }
+            SourceFile &sf = buf;
+            sf.init_source_file(idx, unit);
+            sf.extract(m_gens_all.data(), m_gens_all.size(), &m_registry, uid);
+            if(what == SNAPSHOT)
+            {
+                m_snapshots.save(sf);
+            }
+            else if(what == DUMP)
+            {
+                m_entity_db.add(sf);
+            }
+            _end_file(&sf, &idx, &workspace, sink);
+            m_parse_queue.release(i);
+        }
+        if(what == GENCODE)
+        {
+            m_write_queue.finish([&](WriteQueue::Item $$ item) {
+                _recycle(item, &idx, retained);
+            });
+        }
+        m_writer.end_files();
+        if(what == GENCODE) m_deps.end_run();
+
+        m_parse_queue.finish(&idx.m_strings);
+        m_strings = std::move(idx.yield_strings());
+    }
 
-            if(db_dir)
+    /** get the unit of a file, either from the ast cache or by parsing
+     * it. This is called from the parse queue's threads. */
+    void _parse(const char* filename, ast::CompilationDb c$ db, std::vector<const char*> c$$ args, ast::Index $$ idx, ast::TranslationUnit $ unit)
+    {
+        std::string entry;
+        if(db)
+        {
+            auto c$$ cmd = db->get_cmd(filename);
+            if( ! m_ast_cache.load(unit, idx, filename, cmd.data(), cmd.size(), &entry))
             {
-                unit.reset(idx, filename, db);
+                unit->reset(idx, filename, *db);
+                m_ast_cache.store(*unit, entry, cmd.data(), cmd.size());
             }
-            else
+        }
+        else
+        {
+            if( ! m_ast_cache.load(unit, idx, filename, args.data(), args.size(), &entry))
             {
-                unit.reset(idx, filename, flags, num_flags);
+                unit->reset(idx, filename, args.data(), args.size());
+                m_ast_cache.store(*unit, entry, args.data(), args.size());
             }
-            sf.init_source_file(idx, unit);
-            sf.extract(m_gens_all.data(), m_gens_all.size());
-            sf.gencode(m_gens_all.data(), m_gens_all.size(), workspace);
+        }
+    }
+
+    RenderCache $ _render_cache()
+    {
+        return m_render_cache.enabled() ? &m_render_cache : nullptr;
+    }
 
-            m_writer.write(sf);
+    /** the sink of a run: the given one, or the one collecting the
+     * source files into m_src_files when they are to be saved */
+    SourceFileSink $ _begin_sink(SourceFileSink $ sink)
+    {
+        if(sink) return sink;
+        if( ! m_save_src_files) return nullptr;
+        m_src_files.clear();
+        return &m_src_files_sink;
+    }
+
+    /** hand the source file to the sink, and then recycle it and the
+     * memory used for it, unless the sink retains the source files */
+    void _end_file(SourceFile $ sf, ast::Index $ idx, yml::Tree $ workspace, SourceFileSink $ sink)
+    {
+        bool retained = false;
+        if(sink)
+        {
+            sink->consume(*sf);
+            retained = sink->retains();
+        }
+        sf->clear();
+        workspace->clear_arena();
+        if(idx && ! retained)
+        {
+            idx->m_strings.clear();
         }
+    }
+
+    /** recycle a written item of the write queue. The strings of its
+     * entities are kept in the index if the sink retains the source
+     * files. */
+    void _recycle(WriteQueue::Item $$ item, ast::Index $ idx, bool retained)
+    {
+        if( ! item.m_written) return;
+        item.m_sf.clear();
+        item.m_workspace.clear_arena();
+        if(retained)
+        {
+            idx->m_strings.merge(std::move(item.m_strings));
+        }
+        else
+        {
+            item.m_strings.clear();
+        }
+        item.m_written = false;
+    }
+
+    /** add the inputs and outputs of a source file to the depfiles */
+    void _track_deps(SourceFile c$$ sf, std::vector<std::string> c$$ inputs);
+
+public:
+
+    /** Parse all the given files in a single translation unit, which is
+     * synthesized in memory by including each of the files. The common
+     * includes of the files are thus processed only once. The extracted
+     * entities are then split back to their originating files, so the
+     * output is the same as when each file is parsed on its own. This is
+     * meant for header-only generation; all the files are parsed with the
+     * same flags. */
+    template<class SourceFileNameCollection>
+    void gencode_unity(SourceFileNameCollection c$$ collection, const char* const* flags=nullptr, size_t num_flags=0, SourceFileSink $ sink=nullptr)
+    {
+        ast::Index idx;
+        ast::TranslationUnit unit;
+        yml::Tree workspace;
+
+        std::vector<csubstr> files;
+        std::string unity_src, cwd, path;
+        {
+            std::vector<char> cwdbuf = c4::fs::cwd<std::vector<char>>();
+            csubstr cwd_ = to_csubstr(cwdbuf).trimr('\0');
+            cwd.assign(cwd_.str, cwd_.len);
+        }
+        for(const char* filename : collection)
+        {
+            // the code is attributed to these names, so keep them
+            // alive with the other strings of the run
+            files.push_back(to_csubstr(idx.store_str(to_csubstr(filename))));
+            // use the full path so that the include does not
+            // depend on the location of the unity file
+            normalize_path(files.back(), to_csubstr(cwd), &path);
+            unity_src += "#include \"";
+            unity_src += path;
+            unity_src += "\"\n";
+        }
+        path = cwd + "/c4regen.unity.cpp";
+
+        sink = _begin_sink(sink);
+        m_registry.clear();
+        m_render_cache.begin_run();
+        m_writer.begin_files();
+        SourceFile sf;
+        size_t uid = m_registry.begin_unit(to_csubstr(path));
+        unit.reset(idx, path.c_str(), to_csubstr(unity_src), flags, num_flags);
+        sf.init_source_file(idx, unit);
+        sf.extract(m_gens_all.data(), m_gens_all.size(), &m_registry, uid);
+        sf.assign_owners(files.data(), files.size());
+        sf.gencode(m_gens_all.data(), m_gens_all.size(), workspace, _render_cache(), &m_parallel_render);
+        m_writer.write(sf);
         m_writer.end_files();
+        if(m_deps.enabled())
+        {
+            std::vector<std::string> inputs;
+            unit.inclusions(&inputs);
+            m_deps.begin_run(to_csubstr(m_config_file_name));
+            _track_deps(sf, inputs);
+            m_deps.end_run();
+        }
+        // the file names are used after the source file is consumed,
+        // so the strings are kept
+        if(sink) sink->consume(sf);
 
         m_strings = std::move(idx.yield_strings());
     }
 
+    /** print a line for each source file, with the source file and all
+     * the files written from it, separated by tabs:
+     * `<source>\t<output>\t<output>...`. The outputs are every shard
+     * and the files of every generator; when the code is written into
+     * the source file, the source file is listed too. This is meant to
+     * be read by build systems, which can then query all the outputs of
+     * a target in a single call. Only the names are used: no file is
+     * parsed or read.
+     *
+     * @note The code of the entities declared in an included header goes
+     * to the files of the header, which are not in the line of the
+     * including file. Use print_output_map_with_headers() to have them. */
+    template<class SourceFileNameCollection>
+    void print_output_map(SourceFileNameCollection c$$ collection)
+    {
+        Writer::set_type names;
+        for(const char* source_file : collection)
+        {
+            names.clear();
+            m_writer.map_filenames(to_csubstr(source_file), &names);
+            _print_map_line(source_file, names);
+        }
+    }
+
+    /** like print_output_map(), but also list the files of the included
+     * headers, in the line of the first unit including each header. To
+     * find these, the files are parsed as when generating, so this costs
+     * as much as a parse of every file; a file whose code was already
+     * written from a previous unit is listed without outputs. */
+    template<class SourceFileNameCollection>
+    void print_output_map_with_headers(SourceFileNameCollection c$$ collection, const char* db_dir=nullptr, const char* const* flags=nullptr, size_t num_flags=0)
+    {
+        struct OwnerCollector : public SourceFileSink
+        {
+            std::map<std::string, std::vector<std::string>> m_owners; ///< the other owners of each unit
+            void consume(SourceFile $$ sf) override
+            {
+                auto $$ owners = m_owners[std::string(sf.m_name.str, sf.m_name.len)];
+                for(size_t i = 1; i < sf.m_owners.size(); ++i)
+                {
+                    owners.emplace_back(sf.m_owners[i].str, sf.m_owners[i].len);
+                }
+            }
+        } collector;
+        _process(collection, db_dir, flags, num_flags, EXTRACT, &collector);
+
+        Writer::set_type names;
+        for(const char* source_file : collection)
+        {
+            names.clear();
+            auto it = collector.m_owners.find(source_file);
+            if(it != collector.m_owners.end())
+            {
+                m_writer.map_filenames(to_csubstr(source_file), &names);
+                for(auto c$$ owner : it->second)
+                {
+                    // files written into the headers are not outputs
+                    m_writer.insert_filenames(to_csubstr(owner), &names);
+                }
+                collector.m_owners.erase(it);
+            }
+            _print_map_line(source_file, names);
+        }
+    }
+
     template<class SourceFileNameCollection>
     void print_output_filenames(SourceFileNameCollection c$$ collection)
     {
@@ -117,12 +527,22 @@ public:
 
 private:
 
+    static void _print_map_line(const char* source_file, Writer::set_type c$$ names)
+    {
+        printf("%s", source_file);
+        for(auto c$$ name : names)
+        {
+            printf("\t%s", name.c_str());
+        }
+        printf("\n");
+    }
+
     template<class GeneratorT>
     void _loadgen(c4::yml::NodeRef const& n, std::vector<GeneratorT> *gens)
     {
         gens->emplace_back();
         GeneratorT &g = gens->back();
-        g.load(n);
+        g.load(n, &m_templates);
         m_gens_all.push_back(&g);
     }
 };
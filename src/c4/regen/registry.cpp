@@ -0,0 +1,143 @@
+#include "c4/regen/registry.hpp"
+
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+#include <c4/std/vector.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void normalize_path(csubstr path, csubstr cwd, std::string $ out)
+{
+    out->clear();
+    bool is_abs = path.begins_with('/') || path.begins_with('\\') || (path.len > 1 && path[1] == ':');
+    if( ! is_abs)
+    {
+        out->append(cwd.str, cwd.len);
+        out->append(1, '/');
+    }
+    out->append(path.str, path.len);
+    for(char &c : *out)
+    {
+        if(c == '\\') c = '/';
+    }
+    // resolve the . and .. segments in place
+    std::string &s = *out;
+    size_t w = 0; // write position
+    for(size_t r = 0; r < s.size(); )
+    {
+        size_t e = s.find('/', r);
+        if(e == std::string::npos) e = s.size();
+        csubstr seg(s.data() + r, e - r);
+        if(seg == ".." && w > 0)
+        {
+            // go back to the previous separator
+            size_t prev = s.rfind('/', w - 1);
+            w = (prev == std::string::npos) ? 0 : prev;
+        }
+        else if((seg.empty() && r > 0) || seg == ".")
+        {
+            // skip repeated separators and current-dir segments
+        }
+        else
+        {
+            if(r > 0) s[w++] = '/';
+            for(size_t i = r; i < e; ++i) s[w++] = s[i];
+        }
+        r = e + 1;
+    }
+    s.resize(w);
+}
+
+
+//-----------------------------------------------------------------------------
+
+void EntityRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file_owners.clear();
+    m_unit_files.clear();
+    m_entities.clear();
+    m_skipped_ws.clear();
+    m_cwd = c4::fs::cwd<std::vector<char>>();
+    while( ! m_cwd.empty() && m_cwd.back() == '\0') m_cwd.pop_back();
+    m_num_units = 0;
+    m_num_skipped_units = 0;
+    m_num_skipped_entities = 0;
+    m_num_skipped_files = 0;
+    m_num_unparsed_units = 0;
+}
+
+std::string const& EntityRegistry::_key(csubstr file)
+{
+    normalize_path(file, to_csubstr(m_cwd), &m_key_ws);
+    return m_key_ws;
+}
+
+size_t EntityRegistry::begin_unit(csubstr main_file)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_file_owners.find(_key(main_file));
+    if(it != m_file_owners.end())
+    {
+        ++m_num_skipped_units;
+        return npos;
+    }
+    size_t unit = m_num_units++;
+    it = m_file_owners.emplace(m_key_ws, unit).first;
+    m_unit_files.push_back(&it->first);
+    return unit;
+}
+
+bool EntityRegistry::skip_parse(csubstr main_file)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string key;
+    normalize_path(main_file, to_csubstr(m_cwd), &key);
+    auto it = m_file_owners.find(key);
+    // a file is claimed by its own unit before it is parsed
+    if(it == m_file_owners.end() || m_unit_files[it->second] == &it->first) return false;
+    ++m_num_unparsed_units;
+    return true;
+}
+
+bool EntityRegistry::claim(size_t unit, csubstr file, csubstr usr, csubstr generator)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    C4_ASSERT(unit < m_num_units);
+    auto it = m_file_owners.find(_key(file));
+    if(it == m_file_owners.end())
+    {
+        it = m_file_owners.emplace(m_key_ws, unit).first;
+    }
+    else if(it->second != unit)
+    {
+        ++m_num_skipped_entities;
+        if(m_skipped_ws.emplace(unit, m_key_ws).second)
+        {
+            ++m_num_skipped_files;
+        }
+        return false;
+    }
+    // the file belongs to this unit. Make sure the entity is extracted
+    // only once for each generator.
+    if(usr.empty()) return true; // cannot identify the entity
+    std::string key = m_key_ws;
+    key += '\n';
+    key.append(usr.str, usr.len);
+    key += '\n';
+    key.append(generator.str, generator.len);
+    if( ! m_entities.insert(std::move(key)).second)
+    {
+        ++m_num_skipped_entities;
+        return false;
+    }
+    return true;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,86 @@
+#ifndef _c4_REGEN_REGISTRY_HPP_
+#define _c4_REGEN_REGISTRY_HPP_
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <c4/substr.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** normalize a path so that it can be used as a key: the path is made
+ * absolute (relative to the current working directory), uses unix
+ * separators, and has no . or .. segments */
+void normalize_path(csubstr path, csubstr cwd, std::string $ out);
+
+
+/** Keeps track of the files and entities processed during a run.
+ *
+ * A header included from several translation units is visited in every
+ * one of them. To generate its code exactly once, each file owning
+ * extracted entities is claimed by the first unit where its entities are
+ * seen; all other units skip the file's entities. Within a unit, entities
+ * are identified by their USR and owning file, so that an entity seen
+ * several times (eg a header without include guards) is extracted only
+ * once. */
+struct EntityRegistry
+{
+    constexpr static const size_t npos = size_t(-1);
+
+    std::map<std::string, size_t> m_file_owners; ///< maps normalized file names to the unit that claimed them
+    std::vector<std::string c$>   m_unit_files;  ///< the main file of each unit, pointing at its key in m_file_owners
+    std::set<std::string>         m_entities;    ///< keys: unit + file + USR + generator
+    std::vector<char>             m_cwd;
+    size_t                        m_num_units;
+
+    size_t m_num_skipped_units;    ///< translation units which were not parsed, because their file was already generated
+    size_t m_num_skipped_entities; ///< entities which were not extracted, because they were already extracted
+    size_t m_num_skipped_files;    ///< number of times that a file was skipped from a unit because it was claimed by another
+    size_t m_num_unparsed_units;   ///< translation units which were skipped before being parsed
+
+public:
+
+    EntityRegistry() { clear(); }
+
+    void clear();
+
+    /** start processing a translation unit. Returns npos if the main file
+     * of the unit was already claimed by a previous unit, in which case
+     * the unit should not be processed. */
+    size_t begin_unit(csubstr main_file);
+
+    /** whether the unit of a file need not be parsed, as the file was
+     * already claimed by the entities of a previous unit. This can be
+     * called from other threads while the units are processed, so that
+     * a unit which begin_unit() is going to skip is not parsed. It may
+     * return false for such a unit if the previous unit was not
+     * processed yet. */
+    bool skip_parse(csubstr main_file);
+
+    /** @return true if the entity should be extracted in the given unit */
+    bool claim(size_t unit, csubstr file, csubstr usr, csubstr generator);
+
+    size_t num_units() const { return m_num_units; }
+
+private:
+
+    std::string m_key_ws;
+    std::set<std::pair<size_t, std::string>> m_skipped_ws;
+    std::mutex m_mutex; ///< guards the claims against skip_parse()
+
+    std::string const& _key(csubstr file);
+
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_REGISTRY_HPP_ */
@@ -0,0 +1,148 @@
+#include "c4/regen/render_cache.hpp"
+
+#include "c4/regen/mapped_file.hpp"
+#include <c4/std/string.hpp>
+
+#include <cstring>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+namespace {
+
+/** the layout of a chunk file: the magic, the sizes of the hdr, inl and
+ * src code, and then the code */
+constexpr const char s_chunk_magic[8] = {'c', '4', 'r', 'g', 'c', 'h', 'k', '1'};
+constexpr const size_t s_chunk_header_size = sizeof(s_chunk_magic) + 3 * sizeof(uint32_t);
+
+void _append_rope(c4::tpl::Rope c$$ r, std::string $ out)
+{
+    for(csubstr entry : r.entries())
+    {
+        out->append(entry.str, entry.len);
+    }
+}
+
+} // namespace
+
+
+void RenderCache::load(c4::yml::NodeRef const root)
+{
+    m_dir.clear();
+    csubstr dir;
+    root.get_if("render_cache", &dir);
+    set_dir(dir);
+}
+
+void RenderCache::begin_run()
+{
+    m_loaded.clear();
+    m_stats.clear();
+    if(enabled())
+    {
+        std::string dir = m_dir;
+        c4::fs::mkdirs(&dir[0]);
+    }
+}
+
+void RenderCache::_entry(Generator c$$ g, Entity c$$ e, std::string $ entry) const
+{
+    Hasher h;
+    h(csubstr(s_chunk_magic, sizeof(s_chunk_magic)));
+    h(g.m_tpl_hash);
+    e.hash(h, g.m_uses_region);
+    catrs(entry, to_csubstr(m_dir), '/', to_csubstr(h.hex()), ".chunk");
+}
+
+void RenderCache::_count(Generator c$ g, bool hit)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(auto $$ s : m_stats)
+    {
+        if(s.m_gen == g)
+        {
+            ++(hit ? s.m_hits : s.m_misses);
+            return;
+        }
+    }
+    m_stats.push_back({g, hit ? 1u : 0u, hit ? 0u : 1u});
+}
+
+bool RenderCache::load(Generator c$$ g, Entity c$$ e, CodeChunk $ ch)
+{
+    C4_ASSERT(enabled());
+    std::string entry;
+    _entry(g, e, &entry);
+
+    MappedFile f;
+    if(f.open(entry.c_str()))
+    {
+        csubstr c = f.contents();
+        uint32_t sizes[3];
+        if(c.len >= s_chunk_header_size && memcmp(c.str, s_chunk_magic, sizeof(s_chunk_magic)) == 0)
+        {
+            memcpy(sizes, c.str + sizeof(s_chunk_magic), sizeof(sizes));
+            if((size_t)sizes[0] + sizes[1] + sizes[2] == c.len - s_chunk_header_size)
+            {
+                ch->m_generator = &g;
+                ch->m_originator = &e;
+                c4::tpl::Rope $ ropes[3] = {&ch->m_hdr, &ch->m_inl, &ch->m_src};
+                size_t pos = s_chunk_header_size;
+                for(size_t i = 0; i < 3; ++i)
+                {
+                    ropes[i]->clear();
+                    if(sizes[i] == 0) continue;
+                    // the file is closed on return, so the code is kept
+                    // until the next run
+                    const char *s;
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        s = m_loaded.store(c.sub(pos, sizes[i]));
+                    }
+                    ropes[i]->append(csubstr(s, sizes[i]));
+                    pos += sizes[i];
+                }
+                _count(&g, true);
+                return true;
+            }
+        }
+    }
+    _count(&g, false);
+    return false;
+}
+
+void RenderCache::store(CodeChunk c$$ ch)
+{
+    C4_ASSERT(ch.m_generator != nullptr && ch.m_originator != nullptr);
+    std::string entry, buf;
+    _entry(*ch.m_generator, *ch.m_originator, &entry);
+    buf.assign(s_chunk_magic, sizeof(s_chunk_magic));
+    buf.resize(s_chunk_header_size);
+    uint32_t sizes[3] = {(uint32_t)ch.m_hdr.str_size(), (uint32_t)ch.m_inl.str_size(), (uint32_t)ch.m_src.str_size()};
+    memcpy(&buf[sizeof(s_chunk_magic)], sizes, sizeof(sizes));
+    _append_rope(ch.m_hdr, &buf);
+    _append_rope(ch.m_inl, &buf);
+    _append_rope(ch.m_src, &buf);
+    c4::fs::file_put_contents(entry.c_str(), buf.data(), buf.size());
+}
+
+size_t RenderCache::num_hits() const
+{
+    size_t n = 0;
+    for(auto c$$ s : m_stats) n += s.m_hits;
+    return n;
+}
+
+size_t RenderCache::num_misses() const
+{
+    size_t n = 0;
+    for(auto c$$ s : m_stats) n += s.m_misses;
+    return n;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
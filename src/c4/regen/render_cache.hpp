@@ -0,0 +1,84 @@
+#ifndef _c4_REGEN_RENDER_CACHE_HPP_
+#define _c4_REGEN_RENDER_CACHE_HPP_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <c4/yml/node.hpp>
+#include "c4/regen/generator.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** Stores the code rendered for each entity, so that later runs render
+ * only the entities which changed. This is finer than the file-level
+ * caches: when an entity of a large header changes, the code of the
+ * other entities of the header is reused.
+ *
+ * The store is content-addressed: each chunk is in a file named after a
+ * hash of the generator's templates and of the properties of the entity
+ * which the templates can see. The regions of the entities are hashed
+ * only for the generators whose templates use them, so that moving an
+ * entity within its file does not render it again.
+ *
+ * The chunks of a file may be looked up and stored from several threads
+ * at once; see ParallelRender.
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * render_cache: build/c4regen/chunks
+ * @endcode
+ */
+struct RenderCache
+{
+    struct GenStats
+    {
+        Generator c$ m_gen;
+        size_t       m_hits;
+        size_t       m_misses;
+    };
+
+    std::string           m_dir;
+    ast::StringCollection m_loaded; ///< the code loaded in this run, which the chunks point at
+    std::vector<GenStats> m_stats;
+    std::mutex            m_mutex;  ///< guards m_loaded and m_stats
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+    void set_dir(csubstr dir) { m_dir.assign(dir.str, dir.len); }
+
+    bool enabled() const { return ! m_dir.empty(); }
+
+    /** start a run. The code loaded in the previous run is released, so
+     * the chunks of the previous run must be written by now. */
+    void begin_run();
+
+    /** try to load the code of the entity for the generator into the
+     * chunk.
+     * @return true on a hit. Otherwise, the caller should render the
+     * chunk and then call store(). */
+    bool load(Generator c$$ g, Entity c$$ e, CodeChunk $ ch);
+
+    /** store a freshly rendered chunk, after a load() which missed */
+    void store(CodeChunk c$$ ch);
+
+    size_t num_hits() const;
+    size_t num_misses() const;
+
+private:
+
+    void _entry(Generator c$$ g, Entity c$$ e, std::string $ entry) const;
+    void _count(Generator c$ g, bool hit);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_RENDER_CACHE_HPP_ */
@@ -0,0 +1,124 @@
+#include "c4/regen/rope_file.hpp"
+#include "c4/regen/mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+bool file_has_contents(const char *filename, c4::tpl::Rope c$$ r)
+{
+    MappedFile f;
+    if( ! f.open(filename)) return false;
+    csubstr contents = f.contents();
+    if(contents.len != r.str_size()) return false;
+    size_t pos = 0;
+    for(csubstr entry : r.entries())
+    {
+        if(entry.len == 0) continue;
+        if(memcmp(contents.str + pos, entry.str, entry.len) != 0) return false;
+        pos += entry.len;
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+void RopeFileWriter::add(csubstr filename, c4::tpl::Rope c$$ r)
+{
+    PendingFile f{std::string(filename.str, filename.len), m_entries.size(), 0};
+    for(csubstr entry : r.entries())
+    {
+        if(entry.len == 0) continue;
+        m_entries.push_back(entry);
+        ++f.m_count;
+    }
+    m_files.emplace_back(std::move(f));
+}
+
+void RopeFileWriter::flush()
+{
+    for(auto c$$ f : m_files)
+    {
+        _write(f);
+    }
+    clear();
+}
+
+void RopeFileWriter::clear()
+{
+    m_files.clear();
+    m_entries.clear();
+}
+
+#ifndef _WIN32
+void RopeFileWriter::_write(PendingFile c$$ f) const
+{
+    int fd = ::open(f.m_name.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    C4_CHECK_MSG(fd >= 0, "could not open file for writing: %s", f.m_name.c_str());
+    // write at most IOV_MAX entries at a time, and resume after partial writes
+    iovec iov[IOV_MAX > 1024 ? 1024 : IOV_MAX];
+    constexpr const size_t max_iov = sizeof(iov) / sizeof(iov[0]);
+    size_t next = f.m_first, last = f.m_first + f.m_count;
+    size_t skip = 0; // bytes of the next entry which were already written
+    while(next < last)
+    {
+        size_t n = 0;
+        for(size_t i = next; i < last && n < max_iov; ++i, ++n)
+        {
+            csubstr e = m_entries[i];
+            size_t off = (i == next) ? skip : 0;
+            iov[n].iov_base = const_cast<char*>(e.str + off);
+            iov[n].iov_len = e.len - off;
+        }
+        ssize_t ret = ::writev(fd, iov, (int)n);
+        if(ret < 0)
+        {
+            ::close(fd);
+            C4_ERROR("could not write to file: %s", f.m_name.c_str());
+        }
+        size_t written = (size_t)ret;
+        while(written > 0)
+        {
+            size_t remaining = m_entries[next].len - skip;
+            if(written < remaining)
+            {
+                skip += written;
+                break;
+            }
+            written -= remaining;
+            skip = 0;
+            ++next;
+        }
+    }
+    ::close(fd);
+}
+#else
+void RopeFileWriter::_write(PendingFile c$$ f) const
+{
+    FILE *fp = fopen(f.m_name.c_str(), "wb");
+    C4_CHECK_MSG(fp != nullptr, "could not open file for writing: %s", f.m_name.c_str());
+    for(size_t i = f.m_first, e = f.m_first + f.m_count; i < e; ++i)
+    {
+        csubstr s = m_entries[i];
+        C4_CHECK_MSG(fwrite(s.str, 1, s.len, fp) == s.len, "could not write to file: %s", f.m_name.c_str());
+    }
+    fclose(fp);
+}
+#endif
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,56 @@
+#ifndef _c4_REGEN_ROPE_FILE_HPP_
+#define _c4_REGEN_ROPE_FILE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <c4/tpl/engine.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** @return true if the file exists and its contents are the same as the
+ * contents of the rope. The file is compared entry by entry, without
+ * joining the rope. */
+bool file_has_contents(const char *filename, c4::tpl::Rope c$$ r);
+
+
+/** Writes ropes to files straight from their entries, with vectored
+ * writes (POSIX), so that the rendered code is not joined into a string
+ * before it is written. The files are queued with add() and written
+ * together with flush(); the entries are not copied, so the ropes and
+ * their strings must be alive until flush() returns. */
+struct RopeFileWriter
+{
+    struct PendingFile
+    {
+        std::string m_name;
+        size_t      m_first;
+        size_t      m_count;
+    };
+
+    std::vector<PendingFile> m_files;
+    std::vector<csubstr>     m_entries;
+
+public:
+
+    void add(csubstr filename, c4::tpl::Rope c$$ r);
+    /** write the queued files, and clear the queue */
+    void flush();
+    void clear();
+
+    bool empty() const { return m_files.empty(); }
+
+private:
+
+    void _write(PendingFile c$$ f) const;
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_ROPE_FILE_HPP_ */
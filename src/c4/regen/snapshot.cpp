@@ -0,0 +1,422 @@
+#include "c4/regen/snapshot.hpp"
+
+#include <cstring>
+
+#include "c4/regen/hash.hpp"
+#include <c4/fs/fs.hpp>
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+namespace {
+
+/** accumulates the records and the interned strings of a snapshot */
+struct _SnapshotBuilder
+{
+    snap::StringTable m_strings;
+
+    std::vector<snap::Str>      m_owners;
+    std::vector<snap::Pos>      m_pos;
+    std::vector<snap::Enum>     m_enums;
+    std::vector<snap::Symbol>   m_symbols;
+    std::vector<snap::Class>    m_classes;
+    std::vector<snap::Tagged>   m_members;
+    std::vector<snap::Function> m_methods;
+    std::vector<snap::Function> m_functions;
+    std::vector<snap::Entity>   m_params;
+
+    template<class T>
+    snap::Str str(T const& s) { return m_strings.add(s); }
+
+    snap::Entity entity(Entity c$$ e)
+    {
+        snap::Entity se;
+        se.name = str(e.m_name);
+        se.usr = str(e.m_usr);
+        se.spelling = str(e.m_spelling);
+        se.kind = str(e.m_kind);
+        se.type = str(e.m_type);
+        se.brief_comment = str(e.m_brief_comment);
+        se.raw_comment = str(e.m_raw_comment);
+        se.region.file = str(e.m_region.m_file);
+        se.region.start = {e.m_region.m_start.line, e.m_region.m_start.column, e.m_region.m_start.offset};
+        se.region.end = {e.m_region.m_end.line, e.m_region.m_end.column, e.m_region.m_end.offset};
+        se.flags = 0;
+        if(e.m_is_tpl) se.flags |= snap::IS_TPL;
+        if(e.m_is_tpl_class) se.flags |= snap::IS_TPL_CLASS;
+        if(e.m_is_tpl_function) se.flags |= snap::IS_TPL_FUNCTION;
+        return se;
+    }
+
+    snap::Tagged tagged(TaggedEntity c$$ e)
+    {
+        snap::Tagged st;
+        st.e = entity(e);
+        if(e.is_tagged())
+        {
+            st.e.flags |= snap::HAS_TAG;
+            st.tag = entity(e.m_tag);
+            st.tag_spec = str(e.m_tag.m_spec_str);
+        }
+        else
+        {
+            memset(&st.tag, 0, sizeof(st.tag));
+            st.tag_spec = snap::Str{0, 0};
+        }
+        return st;
+    }
+
+    snap::Function function(Function c$$ f)
+    {
+        snap::Function sf;
+        sf.t = tagged(f);
+        sf.params = {(uint32_t)m_params.size(), (uint32_t)f.m_parameters.size()};
+        for(auto c$$ p : f.m_parameters)
+        {
+            m_params.push_back(entity(p));
+        }
+        return sf;
+    }
+};
+
+} // anon namespace
+
+
+//-----------------------------------------------------------------------------
+
+void Snapshot::save(SourceFile c$$ sf, const char *filename)
+{
+    _SnapshotBuilder b;
+
+    snap::Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, snap::magic, sizeof(h.magic));
+    h.version = snap::version;
+    h.byte_order = snap::byte_order;
+    h.name = b.str(sf.m_name);
+
+    for(csubstr o : sf.m_owners)
+    {
+        b.m_owners.push_back(b.str(o));
+    }
+    for(auto c$$ p : sf.m_pos)
+    {
+        C4_CHECK(p.generator != nullptr);
+        b.m_pos.push_back({b.str(p.generator->m_name), (uint32_t)p.entity_type, (uint32_t)p.pos, (uint32_t)p.owner});
+    }
+    for(auto c$$ e : sf.m_enums)
+    {
+        snap::Enum se;
+        se.t = b.tagged(e);
+        se.symbols = {(uint32_t)b.m_symbols.size(), (uint32_t)e.m_symbols.size()};
+        for(auto c$$ s : e.m_symbols)
+        {
+            b.m_symbols.push_back({b.tagged(s), b.str(s.m_sym), b.str(csubstr(s.m_val_buf, s.m_val_size))});
+        }
+        b.m_enums.push_back(se);
+    }
+    for(auto c$$ c : sf.m_classes)
+    {
+        snap::Class sc;
+        sc.t = b.tagged(c);
+        sc.members = {(uint32_t)b.m_members.size(), (uint32_t)c.m_members.size()};
+        for(auto c$$ m : c.m_members)
+        {
+            b.m_members.push_back(b.tagged(m));
+        }
+        // methods may add parameters, so compute them before appending
+        sc.methods = {(uint32_t)b.m_methods.size(), (uint32_t)c.m_methods.size()};
+        for(auto c$$ m : c.m_methods)
+        {
+            snap::Function sm = b.function(m);
+            b.m_methods.push_back(sm);
+        }
+        b.m_classes.push_back(sc);
+    }
+    for(auto c$$ f : sf.m_functions)
+    {
+        snap::Function sfn = b.function(f);
+        b.m_functions.push_back(sfn);
+    }
+
+    // lay out the file: header, then the sections. All records are made
+    // of 32 bit fields, so the string table is padded to keep them aligned.
+    std::string out(sizeof(snap::Header), '\0');
+    snap::append_strings(&out, b.m_strings, &h.strings);
+    snap::append_section(&out, b.m_owners   , &h.owners);
+    snap::append_section(&out, b.m_pos      , &h.pos);
+    snap::append_section(&out, b.m_enums    , &h.enums);
+    snap::append_section(&out, b.m_symbols  , &h.symbols);
+    snap::append_section(&out, b.m_classes  , &h.classes);
+    snap::append_section(&out, b.m_members  , &h.members);
+    snap::append_section(&out, b.m_methods  , &h.methods);
+    snap::append_section(&out, b.m_functions, &h.functions);
+    snap::append_section(&out, b.m_params   , &h.params);
+    C4_CHECK_MSG(out.size() <= UINT32_MAX, "snapshot too big");
+    memcpy(&out[0], &h, sizeof(h));
+
+    c4::fs::file_put_contents(filename, to_csubstr(out));
+}
+
+
+//-----------------------------------------------------------------------------
+
+bool Snapshot::open(const char *filename)
+{
+    if( ! m_file.open(filename)) return false;
+
+    // check the header and the bounds of every section
+    bool ok = m_file.m_size >= sizeof(snap::Header);
+    if(ok)
+    {
+        snap::Header c$$ h = header();
+        ok = memcmp(h.magic, snap::magic, sizeof(h.magic)) == 0
+            && h.version == snap::version
+            && h.byte_order == snap::byte_order;
+        auto fits = [this](snap::Section s, size_t record_size) {
+            return m_file.fits(s.offset, s.count, record_size);
+        };
+        ok = ok
+            && fits(h.strings  , 1)
+            && fits(h.owners   , sizeof(snap::Str))
+            && fits(h.pos      , sizeof(snap::Pos))
+            && fits(h.enums    , sizeof(snap::Enum))
+            && fits(h.symbols  , sizeof(snap::Symbol))
+            && fits(h.classes  , sizeof(snap::Class))
+            && fits(h.members  , sizeof(snap::Tagged))
+            && fits(h.methods  , sizeof(snap::Function))
+            && fits(h.functions, sizeof(snap::Function))
+            && fits(h.params   , sizeof(snap::Entity));
+    }
+    if( ! ok)
+    {
+        close();
+    }
+    return ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+csubstr Snapshot::_str(snap::Str s) const
+{
+    snap::Section t = header().strings;
+    C4_CHECK(s.offset < t.count && s.len < t.count - s.offset);
+    return csubstr(m_file.m_data + t.offset + s.offset, s.len);
+}
+
+void Snapshot::_restore(snap::Entity c$$ se, Entity $ e) const
+{
+    e->clear_handles();
+    e->m_name = _str(se.name);
+    e->m_usr = _str(se.usr);
+    e->m_spelling = _str(se.spelling);
+    e->m_kind = _str(se.kind);
+    e->m_type = _str(se.type);
+    e->m_brief_comment = _str(se.brief_comment);
+    e->m_raw_comment = _str(se.raw_comment);
+    // strings in the table are zero-terminated
+    e->m_region.m_file = _str(se.region.file).str;
+    e->m_region.m_start.line   = se.region.start.line;
+    e->m_region.m_start.column = se.region.start.column;
+    e->m_region.m_start.offset = se.region.start.offset;
+    e->m_region.m_end.line     = se.region.end.line;
+    e->m_region.m_end.column   = se.region.end.column;
+    e->m_region.m_end.offset   = se.region.end.offset;
+    e->m_is_tpl = (se.flags & snap::IS_TPL) != 0;
+    e->m_is_tpl_class = (se.flags & snap::IS_TPL_CLASS) != 0;
+    e->m_is_tpl_function = (se.flags & snap::IS_TPL_FUNCTION) != 0;
+}
+
+void Snapshot::_restore(snap::Tagged c$$ st, TaggedEntity $ e) const
+{
+    _restore(st.e, e);
+    if(st.e.flags & snap::HAS_TAG)
+    {
+        _restore(st.tag, &e->m_tag);
+        e->m_tag._restore_annotations(_str(st.tag_spec));
+    }
+}
+
+void Snapshot::_restore(snap::Function c$$ sf, Function $ f) const
+{
+    _restore(sf.t, f);
+    C4_CHECK(sf.params.offset + sf.params.count <= header().params.count);
+    auto params = _section<snap::Entity>(header().params) + sf.params.offset;
+    f->m_parameters.resize(sf.params.count);
+    for(size_t i = 0; i < sf.params.count; ++i)
+    {
+        _restore(params[i], &f->m_parameters[i]);
+    }
+}
+
+void Snapshot::restore(SourceFile $ sf, Generator c$ c$ gens, size_t num_gens) const
+{
+    C4_CHECK(valid());
+    snap::Header c$$ h = header();
+
+    sf->clear();
+    sf->clear_handles();
+    sf->m_name = _str(h.name);
+    sf->m_region.m_file = sf->m_name.str;
+
+    auto enums = _section<snap::Enum>(h.enums);
+    auto symbols = _section<snap::Symbol>(h.symbols);
+    sf->m_enums.resize(h.enums.count);
+    for(size_t i = 0; i < h.enums.count; ++i)
+    {
+        Enum $$ e = sf->m_enums[i];
+        _restore(enums[i].t, &e);
+        e.m_entity_type = ENT_ENUM;
+        snap::Section ss = enums[i].symbols;
+        C4_CHECK(ss.offset + ss.count <= h.symbols.count);
+        e.m_symbols.resize(ss.count);
+        for(size_t j = 0; j < ss.count; ++j)
+        {
+            snap::Symbol c$$ sym = symbols[ss.offset + j];
+            EnumSymbol $$ s = e.m_symbols[j];
+            _restore(sym.t, &s);
+            s.m_enum = &e;
+            s.m_sym = _str(sym.sym);
+            csubstr val = _str(sym.value);
+            C4_CHECK(val.len <= sizeof(s.m_val_buf));
+            memcpy(s.m_val_buf, val.str, val.len);
+            s.m_val_size = val.len;
+        }
+    }
+
+    auto classes = _section<snap::Class>(h.classes);
+    auto members = _section<snap::Tagged>(h.members);
+    auto methods = _section<snap::Function>(h.methods);
+    sf->m_classes.resize(h.classes.count);
+    for(size_t i = 0; i < h.classes.count; ++i)
+    {
+        Class $$ c = sf->m_classes[i];
+        _restore(classes[i].t, &c);
+        c.m_entity_type = ENT_CLASS;
+        snap::Section ms = classes[i].members;
+        C4_CHECK(ms.offset + ms.count <= h.members.count);
+        c.m_members.resize(ms.count);
+        for(size_t j = 0; j < ms.count; ++j)
+        {
+            Member $$ m = c.m_members[j];
+            _restore(members[ms.offset + j], &m);
+            m.m_entity_type = ENT_MEMBER;
+            m.m_class = &c;
+        }
+        ms = classes[i].methods;
+        C4_CHECK(ms.offset + ms.count <= h.methods.count);
+        c.m_methods.resize(ms.count);
+        for(size_t j = 0; j < ms.count; ++j)
+        {
+            Method $$ m = c.m_methods[j];
+            _restore(methods[ms.offset + j], &m);
+            m.m_entity_type = ENT_METHOD;
+            m.m_class = &c;
+        }
+    }
+
+    auto functions = _section<snap::Function>(h.functions);
+    sf->m_functions.resize(h.functions.count);
+    for(size_t i = 0; i < h.functions.count; ++i)
+    {
+        _restore(functions[i], &sf->m_functions[i]);
+        sf->m_functions[i].m_entity_type = ENT_FUNCTION;
+    }
+
+    auto owners = _section<snap::Str>(h.owners);
+    for(size_t i = 0; i < h.owners.count; ++i)
+    {
+        sf->m_owners.push_back(_str(owners[i]));
+    }
+
+    auto pos = _section<snap::Pos>(h.pos);
+    sf->m_pos.resize(h.pos.count);
+    sf->m_chunks.resize(h.pos.count);
+    for(size_t i = 0; i < h.pos.count; ++i)
+    {
+        csubstr name = _str(pos[i].generator);
+        Generator c$ g = nullptr;
+        for(size_t j = 0; j < num_gens; ++j)
+        {
+            if(gens[j]->m_name == name)
+            {
+                g = gens[j];
+                break;
+            }
+        }
+        C4_CHECK_MSG(g != nullptr, "snapshot of %.*s: generator '%.*s' is not in the config. Run the extract command again.",
+                     (int)sf->m_name.len, sf->m_name.str, (int)name.len, name.str);
+        auto $$ p = sf->m_pos[i];
+        p.generator = g;
+        p.entity_type = (EntityType_e)pos[i].entity_type;
+        p.pos = pos[i].pos;
+        p.owner = pos[i].owner;
+        C4_CHECK(p.owner < sf->m_owners.size() || sf->m_owners.empty());
+        C4_CHECK(p.entity_type == g->m_entity_type);
+        switch(p.entity_type)
+        {
+        case ENT_ENUM:     C4_CHECK(p.pos < sf->m_enums.size()); break;
+        case ENT_CLASS:    C4_CHECK(p.pos < sf->m_classes.size()); break;
+        case ENT_FUNCTION: C4_CHECK(p.pos < sf->m_functions.size()); break;
+        default: C4_ERROR("snapshot: unknown entity type");
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void SnapshotStore::load(c4::yml::NodeRef const root)
+{
+    m_dir = ".c4regen/snapshots";
+    csubstr dir;
+    root.get_if("snapshot_dir", &dir);
+    if( ! dir.empty())
+    {
+        set_dir(dir);
+    }
+}
+
+void SnapshotStore::path(csubstr src_file, std::string $ snapshot_file) const
+{
+    std::vector<char> cwdbuf = c4::fs::cwd<std::vector<char>>();
+    csubstr cwd = to_csubstr(cwdbuf).trimr('\0');
+    std::string full;
+    normalize_path(src_file, cwd, &full);
+    csubstr base = to_csubstr(full).basename();
+    *snapshot_file = m_dir;
+    *snapshot_file += '/';
+    snapshot_file->append(base.str, base.len);
+    *snapshot_file += '.';
+    *snapshot_file += Hasher::to_hex(hash_str(to_csubstr(full)));
+    *snapshot_file += ".c4snap";
+}
+
+void SnapshotStore::save(SourceFile c$$ sf)
+{
+    std::string dir = m_dir, file;
+    c4::fs::mkdirs(&dir[0]);
+    path(sf.m_name, &file);
+    Snapshot::save(sf, file.c_str());
+    ++m_num_saved;
+}
+
+bool SnapshotStore::open(csubstr src_file, Snapshot $ snapshot)
+{
+    std::string file;
+    path(src_file, &file);
+    if( ! snapshot->open(file.c_str())) return false;
+    ++m_num_loaded;
+    return true;
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
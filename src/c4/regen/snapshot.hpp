@@ -0,0 +1,198 @@
+#ifndef _c4_REGEN_SNAPSHOT_HPP_
+#define _c4_REGEN_SNAPSHOT_HPP_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <c4/yml/node.hpp>
+#include "c4/regen/source_file.hpp"
+#include "c4/regen/mapped_file.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** The binary layout of an entity snapshot. Every record has a fixed
+ * size and is made of 32 bit fields only, so the file can be mapped and
+ * used in place. Strings are interned in a single table, where each of
+ * them is zero-terminated; records refer to the strings and to other
+ * records by offset/index, never by pointer.
+ *
+ * @code
+ * Header
+ * strings   char[]      (the string table)
+ * owners    Str[]       (the files to which the code is attributed)
+ * pos       Pos[]       (the chunks in source order)
+ * enums     Enum[]
+ * symbols   Symbol[]    (the symbols of all enums, contiguous per enum)
+ * classes   Class[]
+ * members   Tagged[]    (contiguous per class)
+ * methods   Function[]  (contiguous per class)
+ * functions Function[]
+ * params    Entity[]    (the parameters of functions and methods)
+ * @endcode
+ */
+namespace snap {
+
+constexpr const char magic[8] = {'c', '4', 'r', 'g', 's', 'n', 'a', 'p'};
+constexpr const uint32_t version = 1;
+constexpr const uint32_t byte_order = 0x01020304;
+
+typedef enum : uint32_t {
+    IS_TPL          = 1u << 0,
+    IS_TPL_CLASS    = 1u << 1,
+    IS_TPL_FUNCTION = 1u << 2,
+    HAS_TAG         = 1u << 3,
+} EntityFlags_e;
+
+struct Str      { uint32_t offset, len; };
+struct Section  { uint32_t offset, count; };
+struct Loc      { uint32_t line, column, offset; };
+struct Region   { Str file; Loc start, end; };
+struct Entity   { Str name, usr, spelling, kind, type, brief_comment, raw_comment; Region region; uint32_t flags; };
+struct Tagged   { Entity e; Entity tag; Str tag_spec; };
+struct Symbol   { Tagged t; Str sym, value; };
+struct Enum     { Tagged t; Section symbols; };
+struct Function { Tagged t; Section params; };
+struct Class    { Tagged t; Section members, methods; };
+struct Pos      { Str generator; uint32_t entity_type, pos, owner; };
+
+struct Header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    Str      name;
+    Section  strings, owners, pos, enums, symbols, classes, members, methods, functions, params;
+};
+
+/** builds a table of interned, zero-terminated strings */
+struct StringTable
+{
+    std::string m_strings;
+    std::unordered_map<std::string, Str> m_interned;
+
+    StringTable()
+    {
+        // empty strings refer to this terminator
+        m_strings.push_back('\0');
+    }
+
+    Str add(csubstr s)
+    {
+        if(s.empty()) return Str{0, 0};
+        std::string key(s.str, s.len);
+        auto it = m_interned.find(key);
+        if(it != m_interned.end()) return it->second;
+        Str ret{(uint32_t)m_strings.size(), (uint32_t)s.len};
+        m_strings.append(s.str, s.len);
+        m_strings.push_back('\0');
+        m_interned.emplace(std::move(key), ret);
+        return ret;
+    }
+
+    Str add(const char *s)
+    {
+        return s ? add(to_csubstr(s)) : Str{0, 0};
+    }
+
+    csubstr get(Str s) const { return csubstr(m_strings.data() + s.offset, s.len); }
+};
+
+/** append records to a file buffer, and set the section pointing at them */
+template<class T>
+void append_section(std::string $ out, std::vector<T> c$$ records, Section $ s)
+{
+    *s = {(uint32_t)out->size(), (uint32_t)records.size()};
+    out->append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+
+/** append a string table to a file buffer, padding it so that the
+ * records following it are aligned */
+inline void append_strings(std::string $ out, StringTable c$$ t, Section $ s)
+{
+    *s = {(uint32_t)out->size(), (uint32_t)t.m_strings.size()};
+    *out += t.m_strings;
+    out->resize((out->size() + 3u) & ~size_t(3u), '\0');
+}
+
+} // namespace snap
+
+
+//-----------------------------------------------------------------------------
+
+/** A read-only view of a snapshot file. The file is mapped into memory
+ * where possible, and the restored entities point directly into it, so
+ * the snapshot must outlive the source file restored from it. */
+struct Snapshot
+{
+    MappedFile m_file;
+
+public:
+
+    /** open a snapshot file. @return false if the file does not exist
+     * or is not a snapshot of the current version */
+    bool open(const char *filename);
+    void close() { m_file.close(); }
+
+    bool valid() const { return m_file.valid(); }
+
+    snap::Header c$$ header() const { return *reinterpret_cast<snap::Header c$>(m_file.m_data); }
+
+    /** restore the entities of the snapshot into a source file. The chunk
+     * generators are looked up by name in the given generators. */
+    void restore(SourceFile $ sf, Generator c$ c$ gens, size_t num_gens) const;
+
+    /** write the extracted entities of a source file to a snapshot file */
+    static void save(SourceFile c$$ sf, const char *filename);
+
+private:
+
+    template<class T>
+    T c$ _section(snap::Section s) const { return reinterpret_cast<T c$>(m_file.m_data + s.offset); }
+    csubstr _str(snap::Str s) const;
+
+    void _restore(snap::Entity c$$ se, Entity $ e) const;
+    void _restore(snap::Tagged c$$ st, TaggedEntity $ e) const;
+    void _restore(snap::Function c$$ sf, Function $ f) const;
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** Where to place the snapshots of the source files.
+ *
+ * YAML config example (this can also be set with --snapshot-dir):
+ *
+ * @begincode
+ * snapshot_dir: build/c4regen/snapshots
+ * @endcode
+ */
+struct SnapshotStore
+{
+    std::string m_dir{".c4regen/snapshots"};
+    size_t      m_num_saved{0};
+    size_t      m_num_loaded{0};
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+    void set_dir(csubstr dir) { m_dir.assign(dir.str, dir.len); }
+
+    /** get the snapshot file name for a source file. This is named after
+     * the file's base name and a hash of its full path. */
+    void path(csubstr src_file, std::string $ snapshot_file) const;
+
+    void save(SourceFile c$$ sf);
+    bool open(csubstr src_file, Snapshot $ snapshot);
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_SNAPSHOT_HPP_ */
@@ -1,12 +1,15 @@
 #include "c4/regen/source_file.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <c4/c4_push.hpp>
 
 namespace c4 {
 namespace regen {
 
-size_t SourceFile::extract(Generator c$ c$ gens, size_t num_gens)
+size_t SourceFile::extract(Generator c$ c$ gens, size_t num_gens, EntityRegistry $ registry, size_t unit)
 {
     size_t num_chunks = m_pos.size();
 
@@ -16,9 +19,9 @@ size_t SourceFile::extract(Generator c$ c$ gens, size_t num_gens)
         auto c$ g_ = gens[i];
         switch(g_->m_entity_type)
         {
-        case ENT_CLASS:    _extract(&m_classes  , ENT_CLASS   , *g_); break;
-        case ENT_ENUM:     _extract(&m_enums    , ENT_ENUM    , *g_); break;
-        case ENT_FUNCTION: _extract(&m_functions, ENT_FUNCTION, *g_); break;
+        case ENT_CLASS:    _extract(&m_classes  , ENT_CLASS   , *g_, registry, unit); break;
+        case ENT_ENUM:     _extract(&m_enums    , ENT_ENUM    , *g_, registry, unit); break;
+        case ENT_FUNCTION: _extract(&m_functions, ENT_FUNCTION, *g_, registry, unit); break;
         default:
             C4_NOT_IMPLEMENTED();
         }
@@ -31,19 +34,103 @@ size_t SourceFile::extract(Generator c$ c$ gens, size_t num_gens)
 
     num_chunks = m_pos.size() - num_chunks;
 
+    _collect_owners();
+
     return num_chunks;
 }
 
-void SourceFile::gencode(Generator c$ c$ gens, size_t num_gens, c4::yml::NodeRef workspace)
+void SourceFile::_collect_owners()
+{
+    m_owners.clear();
+    m_owners.push_back(m_name);
+    for(auto $$ p : m_pos)
+    {
+        Entity c$ e = resolve(p);
+        if(m_tu && clang_File_isEqual(e->m_cursor.file(), m_tu->m_main_file))
+        {
+            p.owner = 0;
+            continue;
+        }
+        csubstr file = owner(*e);
+        auto it = std::find(m_owners.begin(), m_owners.end(), file);
+        p.owner = (size_t)(it - m_owners.begin());
+        if(it == m_owners.end())
+        {
+            m_owners.push_back(file);
+        }
+    }
+}
+
+void SourceFile::assign_owners(csubstr const* files, size_t num_files)
+{
+    std::vector<char> cwdbuf = c4::fs::cwd<std::vector<char>>();
+    csubstr cwd = to_csubstr(cwdbuf).trimr('\0');
+    std::vector<std::string> keys(num_files);
+    for(size_t i = 0; i < num_files; ++i)
+    {
+        normalize_path(files[i], cwd, &keys[i]);
+    }
+    m_owners.assign(files, files + num_files);
+    std::string key;
+    for(auto $$ p : m_pos)
+    {
+        Entity $ e = resolve(p);
+        normalize_path(owner(*e), cwd, &key);
+        auto it = std::find(keys.begin(), keys.end(), key);
+        if(it != keys.end())
+        {
+            p.owner = (size_t)(it - keys.begin());
+            e->m_region.m_file = files[p.owner].str;
+        }
+        else
+        {
+            csubstr file = owner(*e);
+            auto jt = std::find(m_owners.begin() + (std::ptrdiff_t)num_files, m_owners.end(), file);
+            p.owner = (size_t)(jt - m_owners.begin());
+            if(jt == m_owners.end())
+            {
+                m_owners.push_back(file);
+            }
+        }
+    }
+}
+
+void ParallelRender::load(c4::yml::NodeRef const root)
+{
+    m_min_chunks = 1000;
+    m_jobs = 0;
+    c4::yml::NodeRef n = root.find_child("parallel_render");
+    if( ! n.valid()) return;
+    n.get_if("min_chunks", &m_min_chunks, size_t(1000));
+    n.get_if("jobs", &m_jobs, size_t(0));
+}
+
+size_t ParallelRender::num_jobs(size_t num_chunks) const
+{
+    if(m_min_chunks == 0 || num_chunks < m_min_chunks) return 1;
+    size_t jobs = m_jobs ? m_jobs : (size_t)std::thread::hardware_concurrency();
+    // give each thread a fair share of chunks
+    constexpr const size_t min_chunks_per_job = 64;
+    jobs = std::min(jobs, num_chunks / min_chunks_per_job);
+    return jobs > 1 ? jobs : 1;
+}
+
+void SourceFile::gencode(Generator c$ c$ gens, size_t num_gens, c4::yml::NodeRef workspace, RenderCache $ cache, ParallelRender c$ parallel)
 {
+    size_t num_jobs = parallel ? parallel->num_jobs(m_chunks.size()) : 1;
+    if(num_jobs > 1)
+    {
+        _gencode_parallel(gens, num_gens, num_jobs, cache);
+        return;
+    }
     for(size_t i = 0; i < num_gens; ++i)
     {
         auto c$ g_ = gens[i];
         switch(g_->m_entity_type)
         {
-        case ENT_CLASS:    _gencode(&m_classes  , ENT_CLASS   , *g_, workspace); break;
-        case ENT_ENUM:     _gencode(&m_enums    , ENT_ENUM    , *g_, workspace); break;
-        case ENT_FUNCTION: _gencode(&m_functions, ENT_FUNCTION, *g_, workspace); break;
+        case ENT_CLASS:    _gencode(&m_classes  , ENT_CLASS   , *g_, workspace, cache); break;
+        case ENT_ENUM:     _gencode(&m_enums    , ENT_ENUM    , *g_, workspace, cache); break;
+        case ENT_FUNCTION: _gencode(&m_functions, ENT_FUNCTION, *g_, workspace, cache); break;
         default:
             C4_NOT_IMPLEMENTED();
         }
@@ -51,5 +138,54 @@ void SourceFile::gencode(Generator c$ c$ gens, size_t num_gens, c4::yml::NodeRef
 }
 
 
+void SourceFile::_gencode_parallel(Generator c$ c$ gens, size_t num_gens, size_t num_jobs, RenderCache $ cache)
+{
+    // the chunks of the given generators, in the order of the file
+    std::vector<size_t> todo;
+    todo.reserve(m_pos.size());
+    for(size_t i = 0, e = m_pos.size(); i < e; ++i)
+    {
+        if(std::find(gens, gens + num_gens, m_pos[i].generator) != gens + num_gens)
+        {
+            todo.push_back(i);
+        }
+    }
+    while(m_render_jobs.size() < num_jobs)
+    {
+        m_render_jobs.emplace_back(new RenderJob);
+    }
+
+    // hand out the chunks in batches, so that the threads do not
+    // contend for the counter
+    constexpr const size_t batch = 16;
+    std::atomic<size_t> next{0};
+    auto work = [&](RenderJob $ job) {
+        c4::yml::NodeRef workspace = job->m_workspace.rootref();
+        for(size_t b = next.fetch_add(batch); b < todo.size(); b = next.fetch_add(batch))
+        {
+            for(size_t k = b, e = std::min(b + batch, todo.size()); k < e; ++k)
+            {
+                size_t i = todo[k];
+                EntityPos c$$ p = m_pos[i];
+                Entity c$$ ent = *resolve(p);
+                if(cache && cache->load(*p.generator, ent, &m_chunks[i])) continue;
+                p.generator->generate(ent, workspace, &m_chunks[i], &job->m_code);
+                if(cache) cache->store(m_chunks[i]);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(num_jobs - 1);
+    for(size_t j = 1; j < num_jobs; ++j)
+    {
+        threads.emplace_back(work, m_render_jobs[j].get());
+    }
+    work(m_render_jobs[0].get());
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+}
+
 } // namespace regen
 } // namespace c4
@@ -1,10 +1,14 @@
 #ifndef _c4_REGEN_SOURCE_FILE_HPP_
 #define _c4_REGEN_SOURCE_FILE_HPP_
 
+#include <memory>
+
 #include "c4/regen/enum.hpp"
 #include "c4/regen/class.hpp"
 #include "c4/regen/function.hpp"
 #include "c4/regen/extractor.hpp"
+#include "c4/regen/registry.hpp"
+#include "c4/regen/render_cache.hpp"
 
 #include <c4/c4_push.hpp>
 
@@ -12,6 +16,35 @@ namespace c4 {
 namespace regen {
 
 
+/** Splits the rendering of the chunks of a large file across threads.
+ * Each thread renders into the preallocated slots of the chunks, with a
+ * workspace and strings of its own, so the order of the code does not
+ * change. Files with fewer chunks than the threshold are rendered on the
+ * calling thread, where the threads would cost more than they save.
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * parallel_render:
+ *   min_chunks: 1000  # files with fewer chunks are rendered serially. 0 never splits.
+ *   jobs: 4           # the threads rendering a file. 0 uses one per hardware thread.
+ * @endcode
+ */
+struct ParallelRender
+{
+    size_t m_min_chunks{1000};
+    size_t m_jobs{0};
+
+    void load(c4::yml::NodeRef const root);
+
+    /** the threads rendering a file with the given number of chunks.
+     * 1 renders on the calling thread. */
+    size_t num_jobs(size_t num_chunks) const;
+};
+
+
+//-----------------------------------------------------------------------------
+
 struct SourceFile : public Entity
 {
 public:
@@ -30,9 +63,25 @@ public:
         Generator c$ generator;
         EntityType_e entity_type;
         size_t pos;
+        size_t owner; ///< index into m_owners
     };
     std::vector<EntityPos> m_pos;    ///< the map to the chunks array
     std::vector<CodeChunk> m_chunks; ///< the code chunks originated from the source code
+    ast::StringCollection  m_code;   ///< the code written by native generators, which the chunks point at
+
+    /** the scratch of a thread rendering the chunks of a large file. The
+     * chunks may point at it, so it lives as long as they do. */
+    struct RenderJob
+    {
+        c4::yml::Tree         m_workspace;
+        ast::StringCollection m_code;
+    };
+    std::vector<std::unique_ptr<RenderJob>> m_render_jobs;
+
+    /// the files declaring the extracted entities. The generated code is
+    /// attributed to these files rather than to the translation unit. The
+    /// first owner is always the main file of the unit.
+    std::vector<csubstr>   m_owners;
 
 public:
 
@@ -49,20 +98,48 @@ public:
         m_functions.clear();
         m_pos.clear();
         m_chunks.clear();
+        m_code.clear();
+        for(auto &job : m_render_jobs)
+        {
+            job->m_workspace.clear_arena();
+            job->m_code.clear();
+        }
+        m_owners.clear();
     }
 
-    size_t extract(Generator c$ c$ gens, size_t num_gens);
-    void gencode(Generator c$ c$ gens, size_t num_gens, c4::yml::NodeRef workspace);
+    /** extract the entities from the unit.
+     * @param registry when given, entities claimed by other units are skipped
+     * @param unit the unit id obtained from the registry */
+    size_t extract(Generator c$ c$ gens, size_t num_gens, EntityRegistry $ registry=nullptr, size_t unit=0);
+    /** render the code chunks of the extracted entities.
+     * @param cache when given, the chunks of unchanged entities are
+     * loaded from it instead of rendered
+     * @param parallel when given, the chunks of a large file are
+     * rendered in several threads */
+    void gencode(Generator c$ c$ gens, size_t num_gens, c4::yml::NodeRef workspace, RenderCache $ cache=nullptr, ParallelRender c$ parallel=nullptr);
 
     ast::Entity ast_ent(ast::Cursor c, ast::Cursor parent) const
     {
         return ast::Entity{c, parent, m_tu, m_index};
     }
 
+    /** the file to which the code of an entity is attributed */
+    static csubstr owner(Entity c$$ e) { return to_csubstr(e.m_region.m_file); }
+
+    /** set the owners of the extracted entities to the given files,
+     * in the given order. This is used when several files are parsed in
+     * a single unit, so that the code is split back to the originating
+     * files. The entity's file names are set to the matching given names,
+     * which must be zero-terminated. Entities declared in other files
+     * are attributed to those files, as usual. */
+    void assign_owners(csubstr const* files, size_t num_files);
+
 private:
 
+    void _collect_owners();
+
     template<class EntityT>
-    void _extract(std::vector<EntityT> $ entities, EntityType_e type, Generator c$$ g)
+    void _extract(std::vector<EntityT> $ entities, EntityType_e type, Generator c$$ g, EntityRegistry $ registry, size_t unit)
     {
         struct _visitor_data
         {
@@ -70,8 +147,10 @@ private:
             std::vector<EntityT> $ entities;
             EntityType_e type;
             Generator c$ gen;
+            EntityRegistry $ registry;
+            size_t unit;
         };
-        _visitor_data vd{this, entities, type, &g};
+        _visitor_data vd{this, entities, type, &g, registry, unit};
 
         auto visitor = [](ast::Cursor c, ast::Cursor parent, void *data)
         {
@@ -79,6 +158,20 @@ private:
             Extractor::Data ret = vd_->gen->m_extractor.extract(*vd_->sf, c);
             if(ret.extracted)
             {
+                if(ret.cursor.is_in_system_header())
+                {
+                    return CXChildVisit_Recurse;
+                }
+                if(vd_->registry)
+                {
+                    ast::Index $$ idx = *vd_->sf->m_index;
+                    csubstr file = to_csubstr(ret.cursor.file_name(idx));
+                    csubstr usr = to_csubstr(ret.cursor.usr(idx));
+                    if( ! vd_->registry->claim(vd_->unit, file, usr, vd_->gen->m_name))
+                    {
+                        return CXChildVisit_Recurse;
+                    }
+                }
                 EntityPos pos{vd_->gen, vd_->type, vd_->entities->size()};
                 vd_->sf->m_pos.emplace_back(pos);
                 vd_->sf->m_chunks.emplace_back();
@@ -97,8 +190,10 @@ private:
         m_tu->visit_children(visitor, &vd);
     }
 
+    void _gencode_parallel(Generator c$ c$ gens, size_t num_gens, size_t num_jobs, RenderCache $ cache);
+
     template<class EntityT>
-    void _gencode(std::vector<EntityT> $ entities, EntityType_e type, Generator c$$ g, c4::yml::NodeRef workspace)
+    void _gencode(std::vector<EntityT> $ entities, EntityType_e type, Generator c$$ g, c4::yml::NodeRef workspace, RenderCache $ cache)
     {
         C4_ASSERT(workspace.is_root());
         for(size_t i = 0, e = m_pos.size(); i < e; ++i)
@@ -106,7 +201,10 @@ private:
             auto c$$ p = m_pos[i];
             if(p.generator == &g && p.entity_type == type)
             {
-                g.generate((*entities)[p.pos], workspace, &m_chunks[i]);
+                EntityT c$$ ent = (*entities)[p.pos];
+                if(cache && cache->load(g, ent, &m_chunks[i])) continue;
+                g.generate(ent, workspace, &m_chunks[i], &m_code);
+                if(cache) cache->store(m_chunks[i]);
             }
         }
     }
@@ -130,6 +228,11 @@ public:
 
 public:
 
+    Entity * resolve(EntityPos c$$ p)
+    {
+        return const_cast<Entity*>(static_cast<SourceFile const*>(this)->resolve(p));
+    }
+
     Entity const* resolve(EntityPos c$$ p) const
     {
         switch(p.entity_type)
@@ -146,6 +249,45 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------
+
+/** Receives each source file of a run as soon as its code was generated
+ * and written, in the order of the files. The source file is recycled
+ * after the call returns, so that the memory used by a run does not grow
+ * with the number of files: the callee must copy what it needs, or move
+ * the source file out of the argument.
+ *
+ * The rendered chunks are valid only during the call. The entities and
+ * their strings are valid only during the call, unless retains() returns
+ * true, in which case their strings are kept until the next run.
+ *
+ * @note consume() may be called from a thread other than the one
+ * running the regen call: when generating code from files, it is called
+ * from the thread writing the files, while the calling thread goes on
+ * with the next files. The calls are never concurrent with each other,
+ * and all of them return before the regen call returns; a sink which
+ * shares state with the caller during the run must synchronize it. */
+struct SourceFileSink
+{
+    virtual ~SourceFileSink() = default;
+
+    virtual void consume(SourceFile $$ sf) = 0;
+
+    /** whether the consumed source files are kept after the call */
+    virtual bool retains() const { return false; }
+};
+
+/** a sink keeping every source file of a run in a vector */
+struct SourceFileCollector : public SourceFileSink
+{
+    std::vector<SourceFile> $ m_files;
+
+    SourceFileCollector(std::vector<SourceFile> $ files) : m_files(files) {}
+
+    void consume(SourceFile $$ sf) override { m_files->emplace_back(std::move(sf)); }
+    bool retains() const override { return true; }
+};
+
 } // namespace regen
 } // namespace c4
 
@@ -0,0 +1,116 @@
+#include "c4/regen/template_library.hpp"
+
+#include <c4/std/string.hpp>
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+std::shared_ptr<ParsedTemplate> ParsedTemplate::create(csubstr src, uint64_t hash)
+{
+    auto t = std::make_shared<ParsedTemplate>();
+    t->m_src.assign(src.str, src.len);
+    t->m_hash = hash;
+    t->m_uses_region = src.find("region") != csubstr::npos;
+    // the engine points at the source, which is not relocated from now on
+    t->m_engine.parse(to_csubstr(t->m_src), &t->m_rope);
+    return t;
+}
+
+std::shared_ptr<CompiledTemplate> ParsedTemplate::compiled(EntityType_e entity_type)
+{
+    for(auto c$$ c : m_compiled)
+    {
+        if(c.first == entity_type) return c.second;
+    }
+    m_compiled.emplace_back(entity_type, CompiledTemplate::compile(to_csubstr(m_src), entity_type));
+    return m_compiled.back().second;
+}
+
+
+//-----------------------------------------------------------------------------
+
+void TemplateLibrary::load(c4::yml::NodeRef const root)
+{
+    clear();
+    c4::yml::NodeRef n = root.find_child("templates");
+    if( ! n.valid()) return;
+    C4_CHECK_MSG(n.is_map(), "templates: must be a map of named templates");
+    for(auto const ch : n.children())
+    {
+        C4_CHECK_MSG( ! find(ch.key()), "templates: duplicate template: %.*s", (int)ch.key().len, ch.key().str);
+        m_named.emplace_back(ch.key(), ch.val());
+    }
+}
+
+void TemplateLibrary::clear()
+{
+    m_named.clear();
+    m_parsed.clear();
+    m_num_requests = 0;
+}
+
+bool TemplateLibrary::find(csubstr name, csubstr $ src) const
+{
+    for(auto c$$ t : m_named)
+    {
+        if(t.first == name)
+        {
+            if(src) *src = t.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<ParsedTemplate> TemplateLibrary::get(csubstr src)
+{
+    ++m_num_requests;
+    std::string expanded;
+    expand(src, &expanded);
+    csubstr esrc = to_csubstr(expanded);
+    uint64_t h = hash_str(esrc);
+    auto it = m_parsed.find(h);
+    if(it != m_parsed.end())
+    {
+        if(to_csubstr(it->second->m_src) == esrc) return it->second;
+        // a hash collision: keep the template apart
+        return ParsedTemplate::create(esrc, h);
+    }
+    auto t = ParsedTemplate::create(esrc, h);
+    m_parsed.emplace(h, t);
+    return t;
+}
+
+void TemplateLibrary::expand(csubstr src, std::string $ out) const
+{
+    out->clear();
+    _expand(src, out, 0);
+}
+
+void TemplateLibrary::_expand(csubstr src, std::string $ out, size_t depth) const
+{
+    C4_CHECK_MSG(depth < 32, "templates: the includes are nested too deep; is there a cycle?");
+    const csubstr tag = "{% include ";
+    size_t pos = 0;
+    while(true)
+    {
+        size_t b = src.find(tag, pos);
+        if(b == csubstr::npos) break;
+        size_t e = src.find("%}", b + tag.len);
+        C4_CHECK_MSG(e != csubstr::npos, "templates: unterminated include: %.*s", (int)src.sub(b).len, src.sub(b).str);
+        csubstr name = src.range(b + tag.len, e).trim(' ');
+        csubstr partial;
+        C4_CHECK_MSG(find(name, &partial), "templates: unknown template: %.*s", (int)name.len, name.str);
+        out->append(src.str + pos, b - pos);
+        _expand(partial, out, depth + 1);
+        pos = e + 2;
+    }
+    out->append(src.str + pos, src.len - pos);
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
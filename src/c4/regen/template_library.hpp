@@ -0,0 +1,106 @@
+#ifndef _c4_REGEN_TEMPLATE_LIBRARY_HPP_
+#define _c4_REGEN_TEMPLATE_LIBRARY_HPP_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <c4/tpl/engine.hpp>
+#include <c4/yml/node.hpp>
+#include "c4/regen/compiled_template.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** a template source parsed once, and shared by every template of the
+ * config with the same source */
+struct ParsedTemplate
+{
+    std::string     m_src;  ///< the source, with the includes expanded
+    uint64_t        m_hash{0};
+    bool            m_uses_region{false}; ///< whether the template may read the entity regions
+    c4::tpl::Engine m_engine;
+    c4::tpl::Rope   m_rope;
+    std::vector<std::pair<EntityType_e, std::shared_ptr<CompiledTemplate>>> m_compiled;
+
+public:
+
+    static std::shared_ptr<ParsedTemplate> create(csubstr src, uint64_t hash);
+
+    /** the template compiled for the given entity type, compiled on the
+     * first request */
+    std::shared_ptr<CompiledTemplate> compiled(EntityType_e entity_type);
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** The templates of a config. Named templates are declared once in the
+ * top-level templates section, and included by name from the templates
+ * of the generators and of the writer, or from each other. A template
+ * consisting of an include only is a plain reference to the named
+ * template.
+ *
+ * The templates are parsed once per distinct source: templates whose
+ * sources are identical after expanding the includes share the parsed
+ * engine and the compiled templates.
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * templates:
+ *   symbol_pairs: |
+ *     {% for e in symbols %}
+ *     { {{e.name}}, "{{e.name}}"},
+ *     {% endfor %}
+ *   enum_pairs_decl: |
+ *     template<> const EnumPairs<{{type}}> enum_pairs();
+ * generators:
+ *   - name: enum_symbols
+ *     type: enum
+ *     hdr: '{% include enum_pairs_decl %}'
+ *     src: |
+ *       static constexpr const EnumAndName<{{type}}> vals[] = {
+ *           {% include symbol_pairs %}
+ *       };
+ * @endcode
+ */
+struct TemplateLibrary
+{
+    std::vector<std::pair<csubstr, csubstr>> m_named; ///< the templates of the config: name and source
+    std::unordered_map<uint64_t, std::shared_ptr<ParsedTemplate>> m_parsed;
+    size_t m_num_requests{0};
+
+public:
+
+    void load(c4::yml::NodeRef const root);
+    void clear();
+
+    /** get the parsed template for a source, parsing it if no template
+     * with the same expanded source was parsed before */
+    std::shared_ptr<ParsedTemplate> get(csubstr src);
+
+    /** replace the includes of a source with the named templates */
+    void expand(csubstr src, std::string $ out) const;
+
+    /** find a named template */
+    bool find(csubstr name, csubstr $ src=nullptr) const;
+
+    size_t num_requests() const { return m_num_requests; }
+    size_t num_parsed() const { return m_parsed.size(); }
+
+private:
+
+    void _expand(csubstr src, std::string $ out, size_t depth) const;
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_TEMPLATE_LIBRARY_HPP_ */
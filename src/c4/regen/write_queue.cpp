@@ -0,0 +1,117 @@
+#include "c4/regen/write_queue.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+void WriteQueue::load(c4::yml::NodeRef const root)
+{
+    size_t depth = 2;
+    root.get_if("write_queue", &depth, size_t(2));
+    set_depth(depth);
+}
+
+void WriteQueue::start(write_fn write)
+{
+    _stop();
+    m_write = std::move(write);
+    // the items being written, waiting and being filled
+    size_t num_items = m_depth > 0 ? m_depth + 2 : 1;
+    while(m_items.size() < num_items)
+    {
+        m_items.emplace_back(new Item);
+    }
+    m_items.resize(num_items);
+    m_free.clear();
+    m_pending.clear();
+    for(auto &item : m_items)
+    {
+        m_free.push_back(item.get());
+    }
+    m_stop = false;
+    m_num_written = 0;
+    m_num_full = 0;
+    m_max_pending = 0;
+    if(m_depth > 0)
+    {
+        m_thread = std::thread(&WriteQueue::_work, this);
+    }
+}
+
+WriteQueue::Item $$ WriteQueue::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_free.empty())
+    {
+        ++m_num_full;
+        m_cv.wait(lock, [this]{ return ! m_free.empty(); });
+    }
+    Item $ item = m_free.front();
+    m_free.pop_front();
+    return *item;
+}
+
+void WriteQueue::push(Item $$ item)
+{
+    if(m_depth == 0)
+    {
+        m_write(item);
+        item.m_written = true;
+        ++m_num_written;
+        m_free.push_back(&item);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_pending.push_back(&item);
+    if(m_pending.size() > m_max_pending) m_max_pending = m_pending.size();
+    m_cv.notify_all();
+}
+
+void WriteQueue::_work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        m_cv.wait(lock, [this]{ return m_stop || ! m_pending.empty(); });
+        if(m_pending.empty()) return; // stopped, and everything was written
+        Item $ item = m_pending.front();
+        m_pending.pop_front();
+        lock.unlock();
+        m_write(*item);
+        lock.lock();
+        item->m_written = true;
+        ++m_num_written;
+        m_free.push_back(item);
+        m_cv.notify_all();
+    }
+}
+
+void WriteQueue::finish(std::function<void(Item $$)> recycle)
+{
+    _stop();
+    for(auto &item : m_items)
+    {
+        recycle(*item);
+    }
+    m_write = nullptr;
+}
+
+void WriteQueue::_stop()
+{
+    if(m_thread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cv.notify_all();
+        }
+        m_thread.join();
+    }
+    C4_ASSERT(m_pending.empty());
+}
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
@@ -0,0 +1,98 @@
+#ifndef _c4_REGEN_WRITE_QUEUE_HPP_
+#define _c4_REGEN_WRITE_QUEUE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <c4/yml/tree.hpp>
+#include "c4/regen/source_file.hpp"
+
+#include <c4/c4_push.hpp>
+
+namespace c4 {
+namespace regen {
+
+/** Writes the finished source files of a run in a thread of its own, so
+ * that writing the files of a unit overlaps with parsing and extracting
+ * the next units. The source files are handed over to the writer thread
+ * through a bounded queue, and written in the order they were pushed.
+ *
+ * Each item of the queue owns everything the written code points at: the
+ * source file, the strings of its entities and the workspace of its
+ * property trees. The items are recycled, so the memory used by a run
+ * is bounded by the queue depth. With a depth of 0 there is no thread:
+ * each file is written on the calling thread when it is pushed.
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * write_queue: 4   # the files waiting to be written. 0 writes synchronously.
+ * @endcode
+ */
+struct WriteQueue
+{
+    struct Item
+    {
+        SourceFile            m_sf;
+        ast::StringCollection m_strings;
+        c4::yml::Tree         m_workspace;
+        bool                  m_written{false}; ///< whether it was written since it was last acquired
+    };
+
+    /** write an item. This is called from the writer thread, in order. */
+    using write_fn = std::function<void(Item $$ item)>;
+
+    size_t                             m_depth{2};
+    write_fn                           m_write;
+    std::vector<std::unique_ptr<Item>> m_items;
+    std::deque<Item*>                  m_free;
+    std::deque<Item*>                  m_pending;
+    bool                               m_stop{false};
+    std::thread                        m_thread;
+    std::mutex                         m_mutex;
+    std::condition_variable            m_cv;
+
+    size_t                             m_num_written{0};
+    size_t                             m_num_full{0};    ///< times the queue was full when acquiring an item
+    size_t                             m_max_pending{0}; ///< the most items waiting to be written
+
+public:
+
+    ~WriteQueue() { _stop(); }
+
+    void load(c4::yml::NodeRef const root);
+    void set_depth(size_t depth) { m_depth = depth; }
+
+    /** start a run */
+    void start(write_fn write);
+
+    /** get a free item, waiting until one is written if the queue is
+     * full. The item still has the contents it was written with, if any,
+     * so that the caller can recycle them: see Item::m_written */
+    Item $$ acquire();
+
+    /** queue an item to be written */
+    void push(Item $$ item);
+
+    /** wait until every item is written, and finish the run. The items
+     * are passed to the given function so that their contents can be
+     * recycled. */
+    void finish(std::function<void(Item $$)> recycle);
+
+private:
+
+    void _work();
+    void _stop();
+};
+
+} // namespace regen
+} // namespace c4
+
+#include <c4/c4_pop.hpp>
+
+#endif /* _c4_REGEN_WRITE_QUEUE_HPP_ */
@@ -1,6 +1,9 @@
 #include "c4/regen/writer.hpp"
+#include "c4/regen/hash.hpp"
 
+#include <algorithm>
 #include <cctype>
+#include <c4/std/string.hpp>
 #include <c4/c4_push.hpp>
 
 namespace c4 {
@@ -58,23 +61,93 @@ void add_src(const char* ext) { s_src_exts.add(ext); }
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
-void WriterBase::load(c4::yml::NodeRef const n)
+bool ChunkTemplate::split(csubstr src)
+{
+    m_src.assign(src.str, src.len);
+    m_segments.clear();
+    m_split = false;
+    csubstr s = to_csubstr(m_src);
+    size_t pos = 0;
+    while(pos < s.len)
+    {
+        size_t b = s.find('{', pos);
+        while(b != csubstr::npos && b + 1 < s.len && s[b+1] != '{' && s[b+1] != '%' && s[b+1] != '#')
+        {
+            b = s.find('{', b + 1);
+        }
+        if(b == csubstr::npos || b + 1 >= s.len)
+        {
+            m_segments.push_back({TEXT, s.sub(pos)});
+            break;
+        }
+        if(s[b+1] != '{') return false; // blocks and comments need the engine
+        if(b + 2 < s.len && s[b+2] == '{') return false;
+        size_t e = s.find("}}", b + 2);
+        if(e == csubstr::npos) return false;
+        if(e + 2 < s.len && s[e+2] == '}') return false;
+        if(b > pos) m_segments.push_back({TEXT, s.range(pos, b)});
+        csubstr var = s.range(b + 2, e).trim(" \t");
+        if     (var == "generator.name") m_segments.push_back({GENERATOR_NAME, {}});
+        else if(var == "entity.name"   ) m_segments.push_back({ENTITY_NAME, {}});
+        else if(var == "entity.file"   ) m_segments.push_back({ENTITY_FILE, {}});
+        else if(var == "entity.line"   ) m_segments.push_back({ENTITY_LINE, {}});
+        else if(var == "gencode"       ) m_segments.push_back({GENCODE, {}});
+        else return false;
+        pos = e + 2;
+    }
+    m_split = true;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void WriterBase::load(c4::yml::NodeRef const n, TemplateLibrary $ lib)
 {
     auto ntpl = n.find_child("tpl");
-    m_tpl_chunk     .load(ntpl, "chunk", s_default_tpl_chunk);
-    m_file_tpl.m_hdr.load(ntpl, "hdr"  , s_default_tpl_hdr);
-    m_file_tpl.m_inl.load(ntpl, "inl"  , s_default_tpl_inl);
-    m_file_tpl.m_src.load(ntpl, "src"  , s_default_tpl_src);
+    m_tpl_chunk     .load(ntpl, "chunk", s_default_tpl_chunk, _ENT_NONE, lib);
+    // the chunk template is split with its includes expanded
+    m_tpl_chunk_split.split(m_tpl_chunk.empty() ? csubstr{} : to_csubstr(m_tpl_chunk.parsed->m_src));
+    m_file_tpl.m_hdr.load(ntpl, "hdr"  , s_default_tpl_hdr, _ENT_NONE, lib);
+    m_file_tpl.m_inl.load(ntpl, "inl"  , s_default_tpl_inl, _ENT_NONE, lib);
+    m_file_tpl.m_src.load(ntpl, "src"  , s_default_tpl_src, _ENT_NONE, lib);
+    n.get_if("shards", &m_num_shards, size_t(0));
 }
 
 void WriterBase::write(SourceFile c$$ src, set_type $ output_names)
 {
     C4_UNUSED(output_names);
-    _begin_file(src);
+    if(src.m_owners.empty())
+    {
+        _write(src, 0, src.m_name);
+        return;
+    }
+    // the code of each entity goes to the file where the entity is declared
+    for(size_t i = 0; i < src.m_owners.size(); ++i)
+    {
+        _write(src, i, src.m_owners[i]);
+    }
+}
+
+void WriterBase::_write(SourceFile c$$ src, size_t owner, csubstr file, Generator c$ gen)
+{
+    m_gen = gen;
+    if(m_capture)
+    {
+        _clear();
+        extract_filenames(file, &m_file_names, m_gen);
+    }
+    else
+    {
+        _begin_file(src, file);
+    }
 
-    for(auto c$$ chunk : src.m_chunks)
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
     {
-        _request_preambles(chunk);
+        if( ! _is_written(src, i, owner)) continue;
+        _request_preambles(src.m_chunks[i]);
     }
 
     // header code
@@ -82,9 +155,10 @@ void WriterBase::write(SourceFile c$$ src, set_type $ output_names)
     {
         _append_preamble(to_csubstr(gen->m_preambles.m_hdr.preamble), HDR);
     }
-    for(auto c$$ chunk : src.m_chunks)
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
     {
-        _append_code_chunk(chunk, chunk.m_hdr, HDR);
+        if( ! _is_written(src, i, owner)) continue;
+        _append_code_chunk(src.m_chunks[i], src.m_chunks[i].m_hdr, HDR);
     }
 
     // inline code
@@ -92,24 +166,106 @@ void WriterBase::write(SourceFile c$$ src, set_type $ output_names)
     {
         _append_preamble(to_csubstr(gen->m_preambles.m_inl.preamble), INL);
     }
-    for(auto c$$ chunk : src.m_chunks)
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
     {
-        _append_code_chunk(chunk, chunk.m_inl, INL);
+        if( ! _is_written(src, i, owner)) continue;
+        _append_code_chunk(src.m_chunks[i], src.m_chunks[i].m_inl, INL);
     }
 
     // source code
-    for(auto c$ gen : m_contributors.m_src)
+    if(_sharded())
     {
-        _append_preamble(to_csubstr(gen->m_preambles.m_src.preamble), SRC);
+        _write_shards(src, owner, file);
     }
-    for(auto c$$ chunk : src.m_chunks)
+    else
     {
-        _append_code_chunk(chunk, chunk.m_src, SRC);
+        for(auto c$ gen : m_contributors.m_src)
+        {
+            _append_preamble(to_csubstr(gen->m_preambles.m_src.preamble), SRC);
+        }
+        for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
+        {
+            if( ! _is_written(src, i, owner)) continue;
+            _append_code_chunk(src.m_chunks[i], src.m_chunks[i].m_src, SRC);
+        }
     }
 
     _render_files();
 
-    _end_file(src);
+    if(m_capture)
+    {
+        m_capture->emplace_back();
+        RenderedFile $$ rf = m_capture->back();
+        rf.m_source.assign(file.str, file.len);
+        output_filenames(file, &rf.m_names);
+        std::swap(rf.m_code, m_file_contents);
+        if( ! _sharded()) return;
+        for(auto $$ s : m_shards)
+        {
+            m_capture->emplace_back();
+            RenderedFile $$ rs = m_capture->back();
+            rs.m_source.assign(file.str, file.len);
+            rs.m_names.m_src = s.m_name;
+            std::swap(rs.m_code.m_src, s.m_contents);
+        }
+        return;
+    }
+    _end_file(src, file);
+}
+
+void WriterBase::_write_shards(SourceFile c$$ src, size_t owner, csubstr file)
+{
+    m_shards.resize(m_num_shards);
+    for(size_t k = 0; k < m_shards.size(); ++k)
+    {
+        Shard $$ s = m_shards[k];
+        shard_filename(file, k, &s.m_name, m_gen);
+        s.m_preamble.clear();
+        s.m_contents.clear();
+        s.m_contributors.clear();
+        s.m_rope.clear();
+    }
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
+    {
+        if( ! _is_written(src, i, owner)) continue;
+        CodeChunk c$$ ch = src.m_chunks[i];
+        if(ch.m_src.empty()) continue;
+        m_shards[_shard_of(ch)].m_contributors.insert(ch.m_generator);
+    }
+    // each shard is a translation unit, so it needs the preambles of
+    // its own chunks
+    for(auto $$ s : m_shards)
+    {
+        for(auto c$ gen : s.m_contributors)
+        {
+            s.m_preamble += gen->m_preambles.m_src.preamble;
+        }
+    }
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
+    {
+        if( ! _is_written(src, i, owner)) continue;
+        CodeChunk c$$ ch = src.m_chunks[i];
+        if(ch.m_src.empty()) continue;
+        // append the chunk into the shard's contents
+        Shard $$ s = m_shards[_shard_of(ch)];
+        std::swap(s.m_contents, m_file_contents.m_src);
+        _append_code_chunk(ch, ch.m_src, SRC);
+        std::swap(s.m_contents, m_file_contents.m_src);
+    }
+}
+
+bool WriterBase::_is_written(SourceFile c$$ src, size_t chunk, size_t owner) const
+{
+    if(src.m_pos[chunk].owner != owner) return false;
+    return m_gen == nullptr || src.m_chunks[chunk].m_generator == m_gen;
+}
+
+size_t WriterBase::_shard_of(CodeChunk c$$ ch) const
+{
+    C4_ASSERT(_sharded());
+    Hasher h;
+    h(ch.m_generator->m_name)(ch.m_originator->m_name);
+    return (size_t)(h.value() % m_num_shards);
 }
 
 
@@ -135,20 +291,69 @@ void WriterBase::_append_preamble(csubstr s, Destination_e dst)
 }
 
 void WriterBase::_append_to(csubstr s, Destination_e dst, CodeInstances<std::string> $ code)
+{
+    _get_dst(dst, code)->append(s.str, s.len);
+}
+
+std::string $ WriterBase::_get_dst(Destination_e dst, CodeInstances<std::string> $ code)
 {
     switch(dst)
     {
-    case HDR: code->m_hdr.append(s.str, s.len); break;
-    case INL: code->m_inl.append(s.str, s.len); break;
-    case SRC: code->m_src.append(s.str, s.len); break;
+    case HDR: return &code->m_hdr;
+    case INL: return &code->m_inl;
+    case SRC: return &code->m_src;
     default: C4_ERROR("unknown destination");
     }
+    return nullptr;
 }
 
 void WriterBase::_append_code_chunk(CodeChunk c$$ ch, c4::tpl::Rope c$$ r, Destination_e dst)
 {
     if(r.str_size() == 0) return;
 
+    if(m_tpl_chunk_split.m_split)
+    {
+        C4_ASSERT(ch.m_generator != nullptr);
+        std::string $$ out = *_get_dst(dst, &m_file_contents);
+        for(auto c$$ seg : m_tpl_chunk_split.m_segments)
+        {
+            switch(seg.m_slot)
+            {
+            case ChunkTemplate::TEXT:
+                out.append(seg.m_text.str, seg.m_text.len);
+                break;
+            case ChunkTemplate::GENERATOR_NAME:
+                out.append(ch.m_generator->m_name.str, ch.m_generator->m_name.len);
+                break;
+            case ChunkTemplate::ENTITY_NAME:
+                out.append(ch.m_originator->m_name.str, ch.m_originator->m_name.len);
+                break;
+            case ChunkTemplate::ENTITY_FILE:
+            {
+                csubstr file = to_csubstr(ch.m_originator->m_region.m_file);
+                out.append(file.str, file.len);
+                break;
+            }
+            case ChunkTemplate::ENTITY_LINE:
+            {
+                char buf[32];
+                size_t len = to_chars(buf, ch.m_originator->m_region.m_start.line);
+                out.append(buf, len);
+                break;
+            }
+            case ChunkTemplate::GENCODE:
+                for(csubstr entry : r.entries())
+                {
+                    out.append(entry.str, entry.len);
+                }
+                break;
+            default:
+                C4_ERROR("unknown slot");
+            }
+        }
+        return;
+    }
+
     // linearize the chunk's rope into a temporary buffer
     r.chain_all_resize(&m_tpl_ws_str);
 
@@ -180,9 +385,25 @@ void WriterBase::_render_files()
 {
     const bool hdr_empty = m_file_contents.m_hdr.empty() && m_file_preambles.m_hdr.empty();
     const bool inl_empty = m_file_contents.m_inl.empty() && m_file_preambles.m_inl.empty();
-    const bool src_empty = m_file_contents.m_src.empty() && m_file_preambles.m_src.empty();
+    bool src_empty = m_file_contents.m_src.empty() && m_file_preambles.m_src.empty();
+    if(_sharded())
+    {
+        for(auto c$$ s : m_shards)
+        {
+            src_empty = src_empty && s.m_contents.empty() && s.m_preamble.empty();
+        }
+    }
 
-    if(hdr_empty && inl_empty && src_empty) return;
+    if(hdr_empty && inl_empty && src_empty)
+    {
+        _clear(&m_file_ropes);
+        for(auto $$ s : m_shards)
+        {
+            s.m_contents.clear();
+            s.m_rope.clear();
+        }
+        return;
+    }
 
     m_tpl_ws_tree.clear();
     m_tpl_ws_tree.clear_arena();
@@ -211,22 +432,51 @@ void WriterBase::_render_files()
     inl["filename"] = to_csubstr(m_file_names.m_inl);
     src["filename"] = to_csubstr(m_file_names.m_src);
 
-    // note that the properties are using the file contents
-    // strings, so we can't chain the rope directly into those
-    // strings. That's the reason for chaining into the temp
-    // string and then copying it to the file contents strings.
+    // the ropes point at the property tree and at the file contents
+    // strings, so they are valid until the next file is rendered. They
+    // are written to the files straight from their entries.
+    m_file_tpl.m_hdr.render(root, &m_file_ropes.m_hdr);
+    m_file_tpl.m_inl.render(root, &m_file_ropes.m_inl);
+    m_file_tpl.m_src.render(root, &m_file_ropes.m_src);
 
-    m_file_tpl.m_hdr.render(root, &m_tpl_ws_rope);
-    m_tpl_ws_rope.chain_all_resize(&m_tpl_ws_str);
-    m_file_contents.m_hdr = m_tpl_ws_str;
+    if(_sharded())
+    {
+        for(auto $$ s : m_shards)
+        {
+            root["has_src"] << ( ! (s.m_contents.empty() && s.m_preamble.empty()));
+            src["preamble"] = to_csubstr(s.m_preamble);
+            src["gencode"]  = to_csubstr(s.m_contents);
+            src["filename"] = to_csubstr(s.m_name);
+            m_file_tpl.m_src.render(root, &s.m_rope);
+        }
+    }
 
-    m_file_tpl.m_inl.render(root, &m_tpl_ws_rope);
-    m_tpl_ws_rope.chain_all_resize(&m_tpl_ws_str);
-    m_file_contents.m_inl = m_tpl_ws_str;
+    if(m_keep_contents || m_capture)
+    {
+        _join_files();
+    }
+}
 
-    m_file_tpl.m_src.render(root, &m_tpl_ws_rope);
-    m_tpl_ws_rope.chain_all_resize(&m_tpl_ws_str);
+void WriterBase::_join_files()
+{
+    // the properties are using the file contents strings, so the
+    // ropes can't be chained directly into those strings. That's the
+    // reason for chaining into the temp string and then copying it to
+    // the file contents strings.
+    m_file_ropes.m_hdr.chain_all_resize(&m_tpl_ws_str);
+    m_file_contents.m_hdr = m_tpl_ws_str;
+    m_file_ropes.m_inl.chain_all_resize(&m_tpl_ws_str);
+    m_file_contents.m_inl = m_tpl_ws_str;
+    m_file_ropes.m_src.chain_all_resize(&m_tpl_ws_str);
     m_file_contents.m_src = m_tpl_ws_str;
+    _clear(&m_file_ropes);
+    if( ! _sharded()) return;
+    for(auto $$ s : m_shards)
+    {
+        s.m_rope.chain_all_resize(&m_tpl_ws_str);
+        s.m_contents = m_tpl_ws_str;
+        s.m_rope.clear();
+    }
 }
 
 csubstr WriterBase::_incguard(csubstr filename)
@@ -239,7 +489,58 @@ csubstr WriterBase::_incguard(csubstr filename)
     return incg;
 }
 
-void WriterBase::extract_filenames(csubstr name, CodeInstances<std::string> $ fn)
+void WriterBase::_save(std::string c$$ filename, std::string c$$ contents)
+{
+    if(c4::fs::path_exists(filename.c_str()))
+    {
+        c4::fs::file_get_contents(filename.c_str(), &m_save_ws);
+        if(m_save_ws == contents)
+        {
+            ++m_num_unchanged;
+            return;
+        }
+    }
+    c4::fs::file_put_contents(filename.c_str(), contents.data(), contents.size());
+    ++m_num_saved;
+}
+
+void WriterBase::_save(std::string c$$ filename, c4::tpl::Rope c$$ contents)
+{
+    if(file_has_contents(filename.c_str(), contents))
+    {
+        ++m_num_unchanged;
+        return;
+    }
+    m_rope_writer.add(to_csubstr(filename), contents);
+    ++m_num_saved;
+}
+
+void WriterBase::_save_files()
+{
+    _save(m_file_names.m_hdr, m_file_ropes.m_hdr);
+    _save(m_file_names.m_inl, m_file_ropes.m_inl);
+    if( ! _sharded())
+    {
+        _save(m_file_names.m_src, m_file_ropes.m_src);
+        return;
+    }
+    for(auto c$$ s : m_shards)
+    {
+        _save(s.m_name, s.m_rope);
+    }
+}
+
+void WriterBase::shard_filename(csubstr src_file_name, size_t shard, std::string $ fn, Generator c$ gen)
+{
+    CodeInstances<std::string> names;
+    extract_filenames(src_file_name, &names, gen);
+    // foo.c4gen.cpp -> foo.c4gen.N.cpp
+    csubstr src = to_csubstr(names.m_src);
+    C4_ASSERT(src.ends_with(".cpp"));
+    catrs(fn, src.first(src.len - 4), '.', shard, ".cpp");
+}
+
+void WriterBase::extract_filenames(csubstr name, CodeInstances<std::string> $ fn, Generator c$ gen)
 {
     C4_CHECK(name.not_empty());
 
@@ -252,9 +553,10 @@ void WriterBase::extract_filenames(csubstr name, CodeInstances<std::string> $ fn
         name = name.sub(m_source_root.size());
     }
 
-    m_file_names.m_src.assign(name.begin(), name.end());
-    // duplication is intentional, to prevent overlapping buffers in the catrs calls below
-    std::string tmp = m_file_names.m_src;
+    // copy the name, to prevent overlapping buffers in the catrs calls
+    // below. This does not use the members, so that it can be called
+    // while the writer thread is writing.
+    std::string tmp(name.begin(), name.end());
     substr wname = to_substr(tmp);
     c4::fs::to_unix_sep(wname.str, wname.len);
     wname.tolower();
@@ -262,6 +564,13 @@ void WriterBase::extract_filenames(csubstr name, CodeInstances<std::string> $ fn
     C4_ASSERT(is_hdr(wname) || is_src(wname));
     csubstr name_wo_ext = wname.name_wo_extshort();
 
+    if(gen)
+    {
+        catrs(&fn->m_hdr, name_wo_ext, '.', gen->m_name, ".c4gen.hpp");
+        catrs(&fn->m_inl, name_wo_ext, '.', gen->m_name, ".c4gen.def.hpp");
+        catrs(&fn->m_src, name_wo_ext, '.', gen->m_name, ".c4gen.cpp");
+        return;
+    }
     catrs(&fn->m_hdr, name_wo_ext, ".c4gen.hpp");
     catrs(&fn->m_inl, name_wo_ext, ".c4gen.def.hpp");
     catrs(&fn->m_src, name_wo_ext, ".c4gen.cpp");
@@ -270,7 +579,349 @@ void WriterBase::extract_filenames(csubstr name, CodeInstances<std::string> $ fn
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
-void Writer::load(c4::yml::NodeRef const n)
+
+constexpr const char s_samefile_marker[] = "// regen:GENERATED:(";
+constexpr const char s_samefile_begin[] = "// regen:GENERATED:(BEGIN). DO NOT EDIT THE BLOCK BELOW. WILL BE OVERWRITTEN!\n";
+constexpr const char s_samefile_end[] = "// regen:GENERATED:(END). DO NOT EDIT THE BLOCK ABOVE. WILL BE OVERWRITTEN!\n";
+
+void WriterSameFile::write(SourceFile c$$ src, set_type $ output_names)
+{
+    C4_UNUSED(output_names);
+    C4_CHECK_MSG(src.m_tu != nullptr, "samefile: the unit of the source file is needed to write into it");
+    if(src.m_owners.empty())
+    {
+        _write_same(src, 0, src.m_name);
+        return;
+    }
+    for(size_t i = 0; i < src.m_owners.size(); ++i)
+    {
+        _write_same(src, i, src.m_owners[i]);
+    }
+}
+
+void WriterSameFile::_write_same(SourceFile c$$ src, size_t owner, csubstr file)
+{
+    _clear();
+    m_filename.assign(file.str, file.len);
+    // the buffer which was parsed: the file is not read again
+    csubstr buf = src.m_tu->file_contents(m_filename.c_str());
+    const bool with_src = ! is_hdr(file);
+
+    // the chunks of this owner, in the order of their entities
+    m_order.clear();
+    for(size_t i = 0, e = src.m_chunks.size(); i < e; ++i)
+    {
+        if(src.m_pos[i].owner != owner) continue;
+        CodeChunk c$$ ch = src.m_chunks[i];
+        if(ch.m_hdr.empty() && ch.m_inl.empty() && ( ! with_src || ch.m_src.empty())) continue;
+        _request_preambles(ch);
+        m_order.push_back(i);
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [&src](size_t l, size_t r){
+        return src.m_chunks[l].m_originator->m_region.m_end.offset < src.m_chunks[r].m_originator->m_region.m_end.offset;
+    });
+    m_code.resize(m_order.size());
+    for(size_t i = 0; i < m_order.size(); ++i)
+    {
+        _render_chunk(src.m_chunks[m_order[i]], with_src, &m_code[i]);
+    }
+    if( ! m_code.empty())
+    {
+        for(auto c$ gen : m_contributors.m_hdr) _append_preamble(to_csubstr(gen->m_preambles.m_hdr.preamble), HDR);
+        for(auto c$ gen : m_contributors.m_inl) _append_preamble(to_csubstr(gen->m_preambles.m_inl.preamble), HDR);
+        if(with_src)
+        {
+            for(auto c$ gen : m_contributors.m_src) _append_preamble(to_csubstr(gen->m_preambles.m_src.preamble), HDR);
+        }
+        m_code[0].insert(0, m_file_preambles.m_hdr);
+    }
+
+    // match the blocks in the buffer to the chunks: a block belongs to
+    // the last entity ending before it. Blocks before the first entity
+    // are stale.
+    _scan(buf);
+    m_edits.clear();
+    size_t b = 0;
+    while(b < m_blocks.size() && (m_order.empty() || m_blocks[b].m_begin < src.m_chunks[m_order[0]].m_originator->m_region.m_end.offset))
+    {
+        m_edits.push_back({m_blocks[b].m_begin, m_blocks[b].m_end, {}});
+        ++b;
+    }
+    for(size_t c = 0; c < m_order.size(); )
+    {
+        Entity c$ ent = src.m_chunks[m_order[c]].m_originator;
+        size_t num_codes = 1;
+        while(c + num_codes < m_order.size() && src.m_chunks[m_order[c + num_codes]].m_originator == ent)
+        {
+            ++num_codes;
+        }
+        size_t next = c + num_codes < m_order.size() ? src.m_chunks[m_order[c + num_codes]].m_originator->m_region.m_end.offset : buf.len + 1;
+        size_t num_blocks = 0;
+        while(b + num_blocks < m_blocks.size() && m_blocks[b + num_blocks].m_begin < next)
+        {
+            ++num_blocks;
+        }
+        // new blocks go after the line where the entity ends
+        size_t insert_pos = buf.find('\n', ent->m_region.m_end.offset);
+        insert_pos = insert_pos == csubstr::npos ? buf.len : insert_pos + 1;
+        _edit_group(buf, insert_pos, b, num_blocks, c, num_codes);
+        b += num_blocks;
+        c += num_codes;
+    }
+
+    if(m_capture)
+    {
+        m_capture->emplace_back();
+        RenderedFile $$ rf = m_capture->back();
+        rf.m_source = m_filename;
+        output_filenames(file, &rf.m_names);
+        m_out.assign(buf.str, buf.len);
+    }
+    if(m_edits.empty())
+    {
+        if(m_capture) std::swap(*_get_dst(with_src ? SRC : HDR, &m_capture->back().m_code), m_out);
+        else ++m_num_unchanged;
+        return;
+    }
+
+    m_out.clear();
+    size_t pos = 0;
+    for(auto c$$ ed : m_edits)
+    {
+        C4_ASSERT(ed.m_begin >= pos && ed.m_end >= ed.m_begin);
+        m_out.append(buf.str + pos, ed.m_begin - pos);
+        m_out.append(ed.m_text);
+        pos = ed.m_end;
+    }
+    m_out.append(buf.str + pos, buf.len - pos);
+
+    if(m_capture)
+    {
+        std::swap(*_get_dst(with_src ? SRC : HDR, &m_capture->back().m_code), m_out);
+        return;
+    }
+    c4::fs::file_put_contents(m_filename.c_str(), m_out.data(), m_out.size());
+    ++m_num_saved;
+}
+
+void WriterSameFile::_render_chunk(CodeChunk c$$ ch, bool with_src, std::string $ out)
+{
+    m_file_contents.m_hdr.clear();
+    _append_code_chunk(ch, ch.m_hdr, HDR);
+    _append_code_chunk(ch, ch.m_inl, HDR);
+    if(with_src)
+    {
+        _append_code_chunk(ch, ch.m_src, HDR);
+    }
+    if( ! m_file_contents.m_hdr.empty() && m_file_contents.m_hdr.back() != '\n')
+    {
+        m_file_contents.m_hdr += '\n';
+    }
+    std::swap(*out, m_file_contents.m_hdr);
+}
+
+void WriterSameFile::_scan(csubstr buf)
+{
+    m_blocks.clear();
+    Block blk = {};
+    bool open = false;
+    size_t pos = 0;
+    while(pos < buf.len)
+    {
+        size_t m = buf.find(s_samefile_marker, pos);
+        if(m == csubstr::npos) break;
+        size_t line = m;
+        while(line > 0 && buf[line - 1] != '\n') --line;
+        size_t eol = buf.find('\n', m);
+        eol = eol == csubstr::npos ? buf.len : eol + 1;
+        csubstr marker = buf.sub(m);
+        if(marker.begins_with("// regen:GENERATED:(BEGIN)"))
+        {
+            C4_CHECK_MSG( ! open, "samefile: %s: a BEGIN marker is inside another block", m_filename.c_str());
+            blk.m_begin = line;
+            blk.m_code = eol;
+            open = true;
+        }
+        else if(marker.begins_with("// regen:GENERATED:(END)"))
+        {
+            C4_CHECK_MSG(open, "samefile: %s: an END marker has no BEGIN", m_filename.c_str());
+            blk.m_code_end = line;
+            blk.m_end = eol;
+            m_blocks.push_back(blk);
+            open = false;
+        }
+        pos = eol;
+    }
+    C4_CHECK_MSG( ! open, "samefile: %s: a BEGIN marker has no END", m_filename.c_str());
+}
+
+void WriterSameFile::_edit_group(csubstr buf, size_t insert_pos, size_t first_block, size_t num_blocks, size_t first_code, size_t num_codes)
+{
+    // the same blocks: replace only the code which changed
+    if(num_blocks == num_codes)
+    {
+        for(size_t i = 0; i < num_blocks; ++i)
+        {
+            Block c$$ blk = m_blocks[first_block + i];
+            std::string $$ code = m_code[first_code + i];
+            if(buf.range(blk.m_code, blk.m_code_end) == to_csubstr(code)) continue;
+            m_edits.push_back({blk.m_code, blk.m_code_end, std::move(code)});
+        }
+        return;
+    }
+    // otherwise, write all the blocks in place of the first one, or
+    // where the entity ends if there are no blocks
+    std::string text;
+    if(num_blocks == 0 && insert_pos == buf.len && buf.len > 0 && buf[buf.len - 1] != '\n')
+    {
+        text += '\n';
+    }
+    for(size_t i = 0; i < num_codes; ++i)
+    {
+        text += s_samefile_begin;
+        text += m_code[first_code + i];
+        text += s_samefile_end;
+    }
+    if(num_blocks == 0)
+    {
+        m_edits.push_back({insert_pos, insert_pos, std::move(text)});
+        return;
+    }
+    m_edits.push_back({m_blocks[first_block].m_begin, m_blocks[first_block].m_end, std::move(text)});
+    for(size_t i = 1; i < num_blocks; ++i)
+    {
+        m_edits.push_back({m_blocks[first_block + i].m_begin, m_blocks[first_block + i].m_end, {}});
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void WriterSingleFile::load(c4::yml::NodeRef const n, TemplateLibrary $ lib)
+{
+    WriterBase::load(n, lib);
+    C4_CHECK_MSG( ! _sharded(), "shards: the singlefile writer does not split its output");
+    csubstr name;
+    n.get_if("single_file", &name, csubstr("c4regen"));
+    C4_CHECK_MSG(name.not_empty(), "single_file: the name of the files cannot be empty");
+    m_basename.assign(name.str, name.len);
+}
+
+void WriterSingleFile::_names(CodeInstances<std::string> $ fn) const
+{
+    csubstr name = to_csubstr(m_basename);
+    catrs(&fn->m_hdr, name, ".c4gen.hpp");
+    catrs(&fn->m_inl, name, ".c4gen.def.hpp");
+    catrs(&fn->m_src, name, ".c4gen.cpp");
+}
+
+void WriterSingleFile::begin_files()
+{
+    _clear();
+    _names(&m_file_names);
+    m_chunks.clear();
+    m_chunk_files.clear();
+}
+
+void WriterSingleFile::write(SourceFile c$$ src, set_type $ output_names)
+{
+    C4_UNUSED(output_names);
+    // render the chunks now, so that the source file can be released
+    for(auto c$$ ch : src.m_chunks)
+    {
+        _request_preambles(ch);
+        std::string c$ file = &*m_chunk_files.emplace(ch.m_originator->m_region.m_file).first;
+        _add_chunk(ch, ch.m_hdr, HDR, file);
+        _add_chunk(ch, ch.m_inl, INL, file);
+        _add_chunk(ch, ch.m_src, SRC, file);
+    }
+}
+
+void WriterSingleFile::_add_chunk(CodeChunk c$$ ch, c4::tpl::Rope c$$ r, Destination_e dst, std::string c$ file)
+{
+    std::string c$$ code = *_get_dst(dst, &m_file_contents);
+    size_t first = code.size();
+    _append_code_chunk(ch, r, dst);
+    if(code.size() == first) return;
+    m_chunks.push_back({file, ch.m_originator->m_region.m_start.offset, m_chunks.size(), dst, first, code.size() - first});
+}
+
+void WriterSingleFile::_append_preambles(Contributors c$$ gens, Destination_e dst)
+{
+    // in the order of the generator names, which does not depend on
+    // where the generators are allocated
+    std::vector<Generator const*> sorted(gens.begin(), gens.end());
+    std::sort(sorted.begin(), sorted.end(), [](Generator c$ l, Generator c$ r){
+        return l->m_name < r->m_name;
+    });
+    for(auto c$ gen : sorted)
+    {
+        switch(dst)
+        {
+        case HDR: _append_preamble(to_csubstr(gen->m_preambles.m_hdr.preamble), HDR); break;
+        case INL: _append_preamble(to_csubstr(gen->m_preambles.m_inl.preamble), INL); break;
+        case SRC: _append_preamble(to_csubstr(gen->m_preambles.m_src.preamble), SRC); break;
+        default: C4_ERROR("unknown destination");
+        }
+    }
+}
+
+void WriterSingleFile::end_files()
+{
+    if(m_chunks.empty())
+    {
+        _clear();
+        return;
+    }
+    std::sort(m_chunks.begin(), m_chunks.end(), [](Chunk c$$ l, Chunk c$$ r){
+        if(l.m_file != r.m_file) return *l.m_file < *r.m_file;
+        if(l.m_offset != r.m_offset) return l.m_offset < r.m_offset;
+        return l.m_seq < r.m_seq;
+    });
+    _clear(&m_sorted);
+    for(auto c$$ c : m_chunks)
+    {
+        std::string c$$ code = *_get_dst(c.m_dst, &m_file_contents);
+        _get_dst(c.m_dst, &m_sorted)->append(code, c.m_first, c.m_len);
+    }
+    std::swap(m_file_contents, m_sorted);
+
+    _append_preambles(m_contributors.m_hdr, HDR);
+    _append_preambles(m_contributors.m_inl, INL);
+    _append_preambles(m_contributors.m_src, SRC);
+
+    _render_files();
+
+    if(m_capture)
+    {
+        m_capture->emplace_back();
+        RenderedFile $$ rf = m_capture->back();
+        rf.m_source = m_basename;
+        rf.m_names = m_file_names;
+        std::swap(rf.m_code, m_file_contents);
+    }
+    else
+    {
+        _save(m_file_names.m_hdr, m_file_ropes.m_hdr);
+        _save(m_file_names.m_inl, m_file_ropes.m_inl);
+        _save(m_file_names.m_src, m_file_ropes.m_src);
+        m_rope_writer.flush();
+    }
+
+    _clear();
+    _clear(&m_sorted);
+    m_chunks.clear();
+    m_chunk_files.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+void Writer::load(c4::yml::NodeRef const n, TemplateLibrary $ lib)
 {
     csubstr s;
     n.get_if("writer", &s, csubstr("stdout"));
@@ -295,7 +946,7 @@ void Writer::load(c4::yml::NodeRef const n)
     default:
         C4_ERROR("unknown writer type");
     }
-    m_impl->load(n);
+    m_impl->load(n, lib);
 }
 
 Writer::Type_e Writer::str2type(csubstr type_name)
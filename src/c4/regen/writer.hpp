@@ -3,6 +3,7 @@
 
 #include <set>
 #include "c4/regen/source_file.hpp"
+#include "c4/regen/rope_file.hpp"
 
 #include <c4/c4_push.hpp>
 
@@ -121,10 +122,54 @@ constexpr const char s_default_tpl_src[] = R"({% if has_src != 0 %}
 {% endif %})";
 
 
+//-----------------------------------------------------------------------------
+
+/** The chunk template split at load into literal text and the slots of
+ * its variables, so that each chunk is assembled by appending straight
+ * into the file contents. Only templates made of text and the variables
+ * below are split; others are rendered by the template engine. */
+struct ChunkTemplate
+{
+    typedef enum {
+        TEXT,
+        GENERATOR_NAME, ///< {{generator.name}}
+        ENTITY_NAME,    ///< {{entity.name}}
+        ENTITY_FILE,    ///< {{entity.file}}
+        ENTITY_LINE,    ///< {{entity.line}}
+        GENCODE,        ///< {{gencode}}
+    } Slot_e;
+
+    struct Segment
+    {
+        Slot_e  m_slot;
+        csubstr m_text;
+    };
+
+    std::string          m_src;
+    std::vector<Segment> m_segments;
+    bool                 m_split{false};
+
+    /** @return false if the template has other constructs */
+    bool split(csubstr src);
+};
+
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
+/** the code rendered for one of the files of a source, when the writer
+ * captures its output instead of writing it */
+struct RenderedFile
+{
+    std::string                m_source; ///< the file to which the code is attributed
+    CodeInstances<std::string> m_names;  ///< the files where the code would be written
+    CodeInstances<std::string> m_code;   ///< the rendered hdr, inl and src code
+};
+
+
+//-----------------------------------------------------------------------------
+
 struct WriterBase
 {
     typedef enum {HDR, INL, SRC} Destination_e;
@@ -132,52 +177,154 @@ struct WriterBase
     using Contributors = std::set<Generator const*>;
     using set_type     = std::set<std::string>;
 
+    /** one of the translation units where the src code of a file is
+     * split, named foo.c4gen.N.cpp */
+    struct Shard
+    {
+        std::string   m_name;
+        std::string   m_preamble;
+        std::string   m_contents;
+        Contributors  m_contributors;
+        c4::tpl::Rope m_rope;
+    };
+
     CodeInstances<Contributors> m_contributors;  ///< generators that contributed code
     CodeInstances<std::string>  m_file_names;
     CodeInstances<std::string>  m_file_preambles;
     CodeInstances<std::string>  m_file_contents;
+    CodeInstances<c4::tpl::Rope> m_file_ropes;   ///< the rendered files, until they are written
     CodeInstances<CodeTemplate> m_file_tpl;
 
     CodeTemplate  m_tpl_chunk;
+    ChunkTemplate m_tpl_chunk_split;
     c4::yml::Tree m_tpl_ws_tree;
     c4::tpl::Rope m_tpl_ws_rope;
     std::string   m_tpl_ws_str;
 
     std::string   m_source_root;
 
+    /** split the src code of each file into this many translation
+     * units, so that they can be compiled in parallel. Each chunk goes
+     * to the shard given by the hash of its generator and entity names,
+     * so adding or removing an entity changes only its own shard. 0 or
+     * 1 do not split. */
+    size_t             m_num_shards{0};
+    std::vector<Shard> m_shards;
+
+    Generator c$  m_gen{nullptr}; ///< when set, only the code of this generator is being written
+
+    std::vector<RenderedFile> $ m_capture{nullptr};
+
+    /** join the rendered files into m_file_contents. Otherwise the
+     * files are written from m_file_ropes and m_file_contents has only
+     * the generated code. The contents are always joined when capturing. */
+    bool          m_keep_contents{false};
+    RopeFileWriter m_rope_writer;
+
+    std::string   m_save_ws;
+    size_t        m_num_saved{0};     ///< files written in this run
+    size_t        m_num_unchanged{0}; ///< files left untouched as their contents did not change
+
 public:
 
     virtual ~WriterBase() = default;
-    virtual void load(c4::yml::NodeRef const n);
+    virtual void load(c4::yml::NodeRef const n, TemplateLibrary $ lib=nullptr);
 
     void set_source_root(csubstr r) { m_source_root.assign(r.begin(), r.end()); }
 
-    void extract_filenames(csubstr src_file_name, CodeInstances<std::string> $ fn);
+    /** get the names of the files generated from a source file. When a
+     * generator is given, get the names of the files with the code of
+     * that generator only: foo.<generator>.c4gen.hpp */
+    void extract_filenames(csubstr src_file_name, CodeInstances<std::string> $ fn, Generator c$ gen=nullptr);
+    /** get the name of one of the shards of the src file */
+    void shard_filename(csubstr src_file_name, size_t shard, std::string $ fn, Generator c$ gen=nullptr);
     virtual void insert_filenames(csubstr src_file_name, set_type $ filenames)
     {
-        extract_filenames(src_file_name, &m_file_names);
-        if( ! m_file_names.m_hdr.empty()) filenames->insert(m_file_names.m_hdr);
-        if( ! m_file_names.m_inl.empty()) filenames->insert(m_file_names.m_inl);
-        if( ! m_file_names.m_src.empty()) filenames->insert(m_file_names.m_src);
+        _insert_filenames(src_file_name, nullptr, filenames);
+    }
+    /** get the names of all the files written from a source file, as
+     * listed by outfiles --map: every shard, and the files of every
+     * generator. Unlike insert_filenames(), the source file is listed
+     * when the code is written into it. */
+    virtual void map_filenames(csubstr src_file_name, set_type $ filenames)
+    {
+        insert_filenames(src_file_name, filenames);
+    }
+
+    /** get the names of the files written from a source file. The names
+     * of the files which are not written are left empty. When sharding,
+     * the src file is not written; the shards are written instead. */
+    virtual void output_filenames(csubstr src_file_name, CodeInstances<std::string> $ fn)
+    {
+        extract_filenames(src_file_name, fn);
+        if(_sharded()) fn->m_src.clear();
     }
 
-    void write(SourceFile c$$ src, set_type $ output_names=nullptr);
+    virtual void write(SourceFile c$$ src, set_type $ output_names=nullptr);
+
+    /** render the files into this vector instead of writing them.
+     * Set to nullptr to write again. */
+    void capture(std::vector<RenderedFile> $ out) { m_capture = out; }
 
     virtual void begin_files() {}
     virtual void end_files() {}
 
+    /** set the generators of the run */
+    virtual void set_generators(Generator c$ c$ gens, size_t num_gens) { C4_UNUSED(gens); C4_UNUSED(num_gens); }
+
 protected:
 
-    virtual void _begin_file(SourceFile c$$ src) { C4_UNUSED(src); }
-    virtual void _end_file(SourceFile c$$ src) { C4_UNUSED(src); }
+    void _insert_filenames(csubstr src_file_name, Generator c$ gen, set_type $ filenames)
+    {
+        CodeInstances<std::string> names;
+        extract_filenames(src_file_name, &names, gen);
+        if( ! names.m_hdr.empty()) filenames->insert(names.m_hdr);
+        if( ! names.m_inl.empty()) filenames->insert(names.m_inl);
+        if( ! _sharded())
+        {
+            if( ! names.m_src.empty()) filenames->insert(names.m_src);
+            return;
+        }
+        for(size_t i = 0; i < m_num_shards; ++i)
+        {
+            shard_filename(src_file_name, i, &names.m_src, gen);
+            filenames->insert(names.m_src);
+        }
+    }
+
+    /** write the code attributed to one of the owners of the source
+     * file. When a generator is given, write only the code of that
+     * generator. */
+    void _write(SourceFile c$$ src, size_t owner, csubstr file, Generator c$ gen=nullptr);
+    /** distribute the src chunks of an owner among the shards */
+    void _write_shards(SourceFile c$$ src, size_t owner, csubstr file);
+    size_t _shard_of(CodeChunk c$$ ch) const;
+    /** whether a chunk goes to the owner and generator being written */
+    bool _is_written(SourceFile c$$ src, size_t chunk, size_t owner) const;
+    bool _sharded() const { return m_num_shards > 1; }
+
+    virtual void _begin_file(SourceFile c$$ src, csubstr file) { C4_UNUSED(src); C4_UNUSED(file); }
+    virtual void _end_file(SourceFile c$$ src, csubstr file) { C4_UNUSED(src); C4_UNUSED(file); }
 
     void _request_preambles(CodeChunk c$$ chunk);
     void _append_preamble(csubstr s, Destination_e dst);
     static void _append_to(csubstr s, Destination_e dst, CodeInstances<std::string> $ code);
+    static std::string $ _get_dst(Destination_e dst, CodeInstances<std::string> $ code);
     void _append_code_chunk(CodeChunk c$$ ch, c4::tpl::Rope c$$ r, Destination_e dst);
     void _render_files();
+    void _join_files();
     csubstr _incguard(csubstr filename);
 
+    /** write a file, unless it already has these contents. This keeps
+     * the timestamps of unchanged files, so that their dependents are
+     * not rebuilt. */
+    void _save(std::string c$$ filename, std::string c$$ contents);
+    /** queue a rendered file for writing, unless it already has these
+     * contents. The queued files are written with m_rope_writer.flush() */
+    void _save(std::string c$$ filename, c4::tpl::Rope c$$ contents);
+    /** queue the rendered hdr, inl and src files (or its shards) */
+    void _save_files();
+
     template <class T>
     static void _clear(CodeInstances<T> $ s)
     {
@@ -191,6 +338,7 @@ protected:
         _clear(&m_file_names);
         _clear(&m_file_preambles);
         _clear(&m_file_contents);
+        _clear(&m_file_ropes);
         _clear(&m_contributors);
     }
 
@@ -202,20 +350,28 @@ protected:
 struct WriterStdout : public WriterBase
 {
 
-    void _begin_file(SourceFile c$$ src) override
+    WriterStdout() { m_keep_contents = true; }
+
+    void _begin_file(SourceFile c$$ src, csubstr file) override
     {
         C4_UNUSED(src);
         _clear();
-        extract_filenames(src.m_name, &m_file_names);
+        extract_filenames(file, &m_file_names);
     }
-    void _end_file(SourceFile c$$ src) override
+    void _end_file(SourceFile c$$ src, csubstr file) override
     {
         C4_UNUSED(src);
+        C4_UNUSED(file);
 #define _c4prfile(which) if( ! m_file_contents.which.empty()) { printf("%.*s\n", (int)m_file_contents.which.size(), m_file_contents.which.data()); }
         _c4prfile(m_hdr)
         _c4prfile(m_inl)
         _c4prfile(m_src)
 #undef _c4prfile
+        if( ! _sharded()) return;
+        for(auto c$$ s : m_shards)
+        {
+            if( ! s.m_contents.empty()) { printf("%.*s\n", (int)s.m_contents.size(), s.m_contents.data()); }
+        }
     }
 
     void insert_filenames(csubstr src_file, set_type $ filenames) override
@@ -225,15 +381,93 @@ struct WriterStdout : public WriterBase
         // nothing to do here
     }
 
+    void output_filenames(csubstr src_file, CodeInstances<std::string> $ fn) override
+    {
+        C4_UNUSED(src_file);
+        _clear(fn);
+    }
+
 };
 
 
 
 //-----------------------------------------------------------------------------
 
-/** */
+/** Writes the code of each generator to its own files, named after the
+ * source and the generator: foo.<generator>.c4gen.hpp,
+ * foo.<generator>.c4gen.def.hpp and foo.<generator>.c4gen.cpp. Each file
+ * has the preamble of its generator only. As unchanged files are not
+ * written, editing the templates of a generator touches only the files
+ * of that generator, and only their consumers are rebuilt.
+ *
+ * The files of every generator are written for each source, so that
+ * the outputs are known before generating. They are all reported by
+ * insert_filenames(), and so by outfiles, its map and the depfiles;
+ * output_filenames() has the names of the generator being written
+ * only. */
 struct WriterGenFile : public WriterBase
 {
+    std::vector<Generator c$> m_gens;
+
+public:
+
+    void set_generators(Generator c$ c$ gens, size_t num_gens) override
+    {
+        m_gens.assign(gens, gens + num_gens);
+    }
+
+    void write(SourceFile c$$ src, set_type $ output_names=nullptr) override
+    {
+        C4_UNUSED(output_names);
+        for(Generator c$ gen : m_gens)
+        {
+            if(src.m_owners.empty())
+            {
+                _write(src, 0, src.m_name, gen);
+                continue;
+            }
+            for(size_t i = 0; i < src.m_owners.size(); ++i)
+            {
+                _write(src, i, src.m_owners[i], gen);
+            }
+        }
+        m_gen = nullptr;
+    }
+
+    void insert_filenames(csubstr src_file, set_type $ filenames) override
+    {
+        for(Generator c$ gen : m_gens)
+        {
+            _insert_filenames(src_file, gen, filenames);
+        }
+    }
+
+    void output_filenames(csubstr src_file, CodeInstances<std::string> $ fn) override
+    {
+        // the names of the generator being written, if any
+        if( ! m_gen)
+        {
+            _clear(fn);
+            return;
+        }
+        extract_filenames(src_file, fn, m_gen);
+        if(_sharded()) fn->m_src.clear();
+    }
+
+    void _begin_file(SourceFile c$$ src, csubstr file) override
+    {
+        C4_UNUSED(src);
+        _clear();
+        extract_filenames(file, &m_file_names, m_gen);
+    }
+    void _end_file(SourceFile c$$ src, csubstr file) override
+    {
+        C4_UNUSED(src);
+        C4_UNUSED(file);
+        _save_files();
+        m_rope_writer.flush();
+    }
+
 };
 
 
@@ -242,20 +476,18 @@ struct WriterGenFile : public WriterBase
 struct WriterGenGroup : public WriterBase
 {
 
-    void _begin_file(SourceFile c$$ src) override
+    void _begin_file(SourceFile c$$ src, csubstr file) override
     {
         C4_UNUSED(src);
         _clear();
-        extract_filenames(src.m_name, &m_file_names);
+        extract_filenames(file, &m_file_names);
     }
-    void _end_file(SourceFile c$$ src) override
+    void _end_file(SourceFile c$$ src, csubstr file) override
     {
         C4_UNUSED(src);
-#define _c4svfile(which) c4::fs::file_put_contents(m_file_names.which.c_str(), m_file_contents.which.data(), m_file_contents.which.size());
-        _c4svfile(m_hdr)
-        _c4svfile(m_inl)
-        _c4svfile(m_src)
-#undef _c4svfile
+        C4_UNUSED(file);
+        _save_files();
+        m_rope_writer.flush();
     }
 
 };
@@ -263,8 +495,54 @@ struct WriterGenGroup : public WriterBase
 
 //-----------------------------------------------------------------------------
 
+/** Splices the generated code into the source files themselves. The
+ * code of each chunk goes into a block delimited by marker lines, after
+ * the line where the chunk's entity ends:
+ *
+ * @begincode
+ * // regen:GENERATED:(BEGIN). DO NOT EDIT THE BLOCK BELOW. WILL BE OVERWRITTEN!
+ * ...
+ * // regen:GENERATED:(END). DO NOT EDIT THE BLOCK ABOVE. WILL BE OVERWRITTEN!
+ * @endcode
+ *
+ * The blocks are found with a single scan of the buffer which libclang
+ * parsed, so the file is neither read nor parsed again. Only the blocks
+ * whose code changed are replaced, and the file is not written when
+ * none changed, so that its timestamp is kept. The blocks of entities
+ * which are gone are removed. The preambles of the generators go in
+ * the first block of the file.
+ *
+ * As the buffers of the units are used, the files are written while
+ * their unit is alive, ie without the write queue. */
 struct WriterSameFile : public WriterBase
 {
+    /** a generated block in the source buffer */
+    struct Block
+    {
+        size_t m_begin;    ///< the start of the BEGIN line
+        size_t m_code;     ///< the start of the code
+        size_t m_code_end; ///< the start of the END line
+        size_t m_end;      ///< past the END line
+    };
+
+    /** replace the range [m_begin, m_end) of the source buffer */
+    struct Edit
+    {
+        size_t      m_begin;
+        size_t      m_end;
+        std::string m_text;
+    };
+
+    std::string              m_filename;
+    std::vector<Block>       m_blocks;
+    std::vector<Edit>        m_edits;
+    std::vector<size_t>      m_order;  ///< the chunks of an owner, sorted by entity
+    std::vector<std::string> m_code;   ///< the rendered code of each chunk of an owner
+    std::string              m_out;
+
+public:
+
+    void write(SourceFile c$$ src, set_type $ output_names=nullptr) override;
 
     void insert_filenames(csubstr src_file, set_type $ filenames) override
     {
@@ -272,20 +550,102 @@ struct WriterSameFile : public WriterBase
         C4_UNUSED(filenames);
     }
 
+    void map_filenames(csubstr src_file, set_type $ filenames) override
+    {
+        filenames->emplace(src_file.str, src_file.len);
+    }
+
+    void output_filenames(csubstr src_file, CodeInstances<std::string> $ fn) override
+    {
+        // the code is written into the source file itself
+        _clear(fn);
+        if(is_hdr(src_file))
+        {
+            fn->m_hdr.assign(src_file.str, src_file.len);
+        }
+        else
+        {
+            fn->m_src.assign(src_file.str, src_file.len);
+        }
+    }
+
+private:
+
+    void _write_same(SourceFile c$$ src, size_t owner, csubstr file);
+    void _scan(csubstr buf);
+    void _render_chunk(CodeChunk c$$ ch, bool with_src, std::string $ out);
+    void _edit_group(csubstr buf, size_t insert_pos, size_t first_block, size_t num_blocks, size_t first_code, size_t num_codes);
+
 };
 
 
 //-----------------------------------------------------------------------------
 
+/** Aggregates the code generated from all the sources of a run into a
+ * single set of hdr, inl and src files. The chunks of each source file
+ * are rendered into the writer as the source file is written, so the
+ * source files need not be kept until the end of the run. When the run
+ * ends, the chunks are sorted by the file and offset of their entity,
+ * so that the output does not depend on the order of the sources, and
+ * the preamble of each contributing generator is emitted once.
+ *
+ * YAML config example:
+ *
+ * @begincode
+ * writer: singlefile
+ * single_file: gen/all  # writes gen/all.c4gen.hpp, gen/all.c4gen.def.hpp
+ *                       # and gen/all.c4gen.cpp. Defaults to c4regen.
+ * @endcode
+ */
 struct WriterSingleFile : public WriterBase
 {
+    /** a rendered chunk, waiting to be sorted */
+    struct Chunk
+    {
+        std::string c$ m_file;   ///< the file of the entity
+        unsigned       m_offset; ///< the offset of the entity in its file
+        size_t         m_seq;    ///< the arrival order, to break ties
+        Destination_e  m_dst;
+        size_t         m_first;  ///< the position of the code in m_file_contents
+        size_t         m_len;
+    };
+
+    std::string                m_basename{"c4regen"};
+    std::vector<Chunk>         m_chunks;
+    std::set<std::string>      m_chunk_files; ///< interned entity file names
+    CodeInstances<std::string> m_sorted;
+
+public:
+
+    void load(c4::yml::NodeRef const n, TemplateLibrary $ lib=nullptr) override;
+
+    void write(SourceFile c$$ src, set_type $ output_names=nullptr) override;
+
+    void begin_files() override;
+    void end_files() override;
 
     void insert_filenames(csubstr src_file, set_type $ filenames) override
     {
         C4_UNUSED(src_file);
-        C4_UNUSED(filenames);
+        CodeInstances<std::string> names;
+        _names(&names);
+        filenames->insert(names.m_hdr);
+        filenames->insert(names.m_inl);
+        filenames->insert(names.m_src);
     }
 
+    void output_filenames(csubstr src_file, CodeInstances<std::string> $ fn) override
+    {
+        C4_UNUSED(src_file);
+        _names(fn);
+    }
+
+private:
+
+    void _names(CodeInstances<std::string> $ fn) const;
+    void _add_chunk(CodeChunk c$$ ch, c4::tpl::Rope c$$ r, Destination_e dst, std::string c$ file);
+    void _append_preambles(Contributors c$$ gens, Destination_e dst);
+
 };
 
 
@@ -321,12 +681,35 @@ public:
         m_impl->insert_filenames(src_file, workspace);
     }
 
-    void begin_files() { m_impl->begin_files(); }
+    void output_filenames(csubstr src_file, CodeInstances<std::string> *names)
+    {
+        m_impl->output_filenames(src_file, names);
+    }
+
+    void map_filenames(csubstr src_file, set_type *workspace)
+    {
+        m_impl->map_filenames(src_file, workspace);
+    }
+
+    void set_generators(Generator c$ c$ gens, size_t num_gens)
+    {
+        m_impl->set_generators(gens, num_gens);
+    }
+
+    void capture(std::vector<RenderedFile> $ out)
+    {
+        m_impl->capture(out);
+    }
+
+    void begin_files() { m_impl->begin_files(); m_impl->m_num_saved = m_impl->m_num_unchanged = 0; }
     void end_files() { m_impl->end_files(); }
 
+    size_t num_saved() const { return m_impl->m_num_saved; }
+    size_t num_unchanged() const { return m_impl->m_num_unchanged; }
+
 public:
 
-    void load(c4::yml::NodeRef const n);
+    void load(c4::yml::NodeRef const n, TemplateLibrary $ lib=nullptr);
     static Type_e str2type(csubstr type_name);
 
 };
@@ -2,6 +2,7 @@
 #include <c4/log/log.hpp>
 #include <c4/regen/regen.hpp>
 #include <c4/regen/exec.hpp>
+#include <c4/regen/manifest.hpp>
 #include <c4/yml/yml.hpp>
 #include <gtest/gtest.h>
 
@@ -166,6 +167,31 @@ typedef enum {FOO, BAR} MyEnum_e;
     EXPECT_EQ(i, 2);
 }
 
+TEST(pch, detect_prefix)
+{
+    std::vector<std::string> incs;
+    regen::SharedPch::detect_prefix(R"(// a comment
+/* a block
+ * comment */
+#ifndef _FOO_HPP_
+#define _FOO_HPP_
+
+#include <vector>
+#include  <string>   // trailing comment
+#include "foo/bar.hpp"
+#include <map>
+)", &incs);
+    ASSERT_EQ(incs.size(), 2u);
+    EXPECT_EQ(incs[0], "<vector>");
+    EXPECT_EQ(incs[1], "<string>");
+
+    regen::SharedPch::detect_prefix(R"(#pragma once
+int x;
+#include <vector>
+)", &incs);
+    EXPECT_TRUE(incs.empty());
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -225,19 +251,21 @@ struct GenCompare
 
 
 
+using arg = std::vector<char>;
+
+void putcontents(arg const& filename, csubstr contents)
+{
+    arg tmp_ = filename;
+    substr dirname = to_substr(tmp_).dirname().trimr("/\\");
+    tmp_[dirname.len] = '\0';
+    fs::mkdirs(dirname.data());
+    fs::file_put_contents(filename.data(), contents);
+}
+
 void test_regen_exec(const char *test_name, const char *cfg_yml_buf, SrcAndGen sg)
 {
     SCOPED_TRACE(sg.name);
 
-    using arg = std::vector<char>;
-    auto putcontents = [](arg const& filename, csubstr contents) {
-        arg tmp_ = filename;
-        substr dirname = to_substr(tmp_).dirname().trimr("/\\");
-        tmp_[dirname.len] = '\0';
-        fs::mkdirs(dirname.data());
-        fs::file_put_contents(filename.data(), contents);
-    };
-
     csubstr yml = to_csubstr(cfg_yml_buf);
     arg cwd, tmpdir, casedir, cfgfile, srcfile, srcfilefull;
     std::vector<arg> src_files;
@@ -424,6 +452,83 @@ generators:
       }
 )";
 
+/** basic_enums_cfg with the writer line replaced, and with more
+ * entries appended */
+std::string enums_cfg(csubstr writer, csubstr more={})
+{
+    const csubstr gengroup = "writer: gengroup";
+    std::string cfg = basic_enums_cfg;
+    cfg.replace(cfg.find(gengroup.str), gengroup.len, writer.str, writer.len);
+    cfg.append(more.str, more.len);
+    return cfg;
+}
+
+/** get the lines printed by outfiles --map */
+std::string output_map(c4::regen::Regen &rg, std::vector<const char*> const& files)
+{
+    testing::internal::CaptureStdout();
+    rg.print_output_map(files);
+    return testing::internal::GetCapturedStdout();
+}
+
+/** get the lines printed by outfiles --map --map-headers, which parses
+ * the files */
+std::string output_map_with_headers(c4::regen::Regen &rg, std::vector<const char*> const& files)
+{
+    const char* flags[] = {"-x", "c++"};
+    testing::internal::CaptureStdout();
+    rg.print_output_map_with_headers(files, nullptr, flags, C4_COUNTOF(flags));
+    return testing::internal::GetCapturedStdout();
+}
+
+/** Generates the code of in-memory sources with gencode_buffers().
+ * The files are named after the test, in the current directory: the
+ * sources can include the header defining the tag macros, which is
+ * given as an overlay. */
+struct BufferGen
+{
+    std::string srcname; ///< <name>.cpp
+    std::string hdrname; ///< <name>_macros.hpp
+    std::string include; ///< the include of the macros header
+    c4::regen::Regen rg;
+    std::vector<c4::regen::RenderedFile> out;
+
+    BufferGen(const char *name, std::string const& cfg)
+    {
+        path(to_csubstr(name), ".cpp", &srcname);
+        path(to_csubstr(name), "_macros.hpp", &hdrname);
+        catrs(&include, "#include \"", to_csubstr(name), "_macros.hpp\"\n");
+        rg.load_config_yml(to_csubstr(cfg));
+    }
+
+    static void path(csubstr name, csubstr ext, std::string *p)
+    {
+        arg cwd = c4::fs::cwd<arg>();
+        catrs(p, to_csubstr(cwd).trimr('\0'), "/", name, ext);
+    }
+
+    /** generate the code of a single source, named srcname */
+    std::vector<c4::regen::RenderedFile> const& gen(std::string const& src)
+    {
+        return gen_sources({{srcname, src}});
+    }
+
+    /** generate the code of several sources, given as name and contents */
+    std::vector<c4::regen::RenderedFile> const& gen_sources(std::vector<std::pair<std::string, std::string>> const& sources)
+    {
+        const char hdr[] = "#pragma once\n#define C4_ENUM(...)\n";
+        const char* flags[] = {"-x", "c++"};
+        CXUnsavedFile overlays[] = {{hdrname.c_str(), hdr, (unsigned long)strlen(hdr)}};
+        std::vector<CXUnsavedFile> buffers;
+        for(auto const& s : sources)
+        {
+            buffers.push_back({s.first.c_str(), s.second.c_str(), (unsigned long)s.second.size()});
+        }
+        rg.gencode_buffers(buffers.data(), buffers.size(), overlays, 1, flags, C4_COUNTOF(flags), &out);
+        return out;
+    }
+};
+
 TEST(enums_basic, empty_sources)
 {
     test_regen_exec("enums.basic", basic_enums_cfg, {
@@ -509,6 +614,1170 @@ template<> const EnumPairs<MyEnum_e> enum_pairs()
     });
 }
 
+TEST(registry, skip_parse)
+{
+    c4::regen::EntityRegistry r;
+    size_t a = r.begin_unit("reg_a.cpp");
+    ASSERT_NE(a, c4::regen::EntityRegistry::npos);
+    // a file is claimed by its own unit before being parsed
+    EXPECT_FALSE(r.skip_parse("reg_a.cpp"));
+    EXPECT_FALSE(r.skip_parse("reg_enum.hpp"));
+    EXPECT_TRUE(r.claim(a, "reg_enum.hpp", "c:@E@MyEnum_e", "enum_symbols"));
+    // once claimed by the entities of a unit, the unit of the file is not parsed
+    EXPECT_TRUE(r.skip_parse("reg_enum.hpp"));
+    EXPECT_TRUE(r.skip_parse("./reg_enum.hpp"));
+    EXPECT_EQ(r.begin_unit("reg_enum.hpp"), c4::regen::EntityRegistry::npos);
+    EXPECT_EQ(r.m_num_unparsed_units, 2u);
+    EXPECT_EQ(r.m_num_skipped_units, 1u);
+}
+
+TEST(manifest, is_current_until_a_file_changes)
+{
+    arg tmpdir, file, mfile;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "manifest/");
+    catrs(&file, to_csubstr(tmpdir), "input.hpp", '\0');
+    catrs(&mfile, to_csubstr(tmpdir), "input.manifest", '\0');
+    putcontents(file, "int foo;\n");
+    c4::regen::FileManifest m;
+    m.add(to_csubstr(file).trimr('\0'));
+    m.save(mfile.data());
+    c4::regen::FileManifest loaded;
+    ASSERT_TRUE(loaded.load(mfile.data()));
+    ASSERT_EQ(loaded.m_entries.size(), 1u);
+    EXPECT_EQ(loaded.m_entries[0].file, m.m_entries[0].file);
+    EXPECT_EQ(loaded.m_entries[0].hash, m.m_entries[0].hash);
+    EXPECT_EQ(loaded.m_entries[0].size, 9u);
+    EXPECT_EQ(loaded.m_entries[0].mtime, m.m_entries[0].mtime);
+    EXPECT_TRUE(loaded.is_current());
+    // the same contents written again
+    putcontents(file, "int foo;\n");
+    EXPECT_TRUE(loaded.is_current());
+    // the same size, likely within the same second
+    putcontents(file, "int bar;\n");
+    EXPECT_FALSE(loaded.is_current());
+    // another size
+    putcontents(file, "int foobar;\n");
+    EXPECT_FALSE(loaded.is_current());
+    // a manifest in the format without sizes and times is not loaded
+    putcontents(mfile, "0123456789abcdef input.hpp\n");
+    EXPECT_FALSE(loaded.load(mfile.data()));
+    EXPECT_TRUE(loaded.m_entries.empty());
+}
+
+TEST(enums_basic, header_included_from_several_units)
+{
+    arg tmpdir, cfgfile, hdrfile, cwd;
+    std::vector<arg> srcfiles;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_dedup/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&hdrfile, to_csubstr(tmpdir), "dedup_enum.hpp", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    putcontents(hdrfile, R"(#pragma once
+#define C4_ENUM(...)
+C4_ENUM()
+typedef enum {FOO, BAR} MyEnum_e;
+)");
+    std::vector<const char*> args = {
+        "--cmd", "generate",
+        "--flag", "'-x'",
+        "--flag", "c++",
+        "--cfg", cfgfile.data(),
+        "--",
+    };
+    for(const char *name : {"dedup_a.cpp", "dedup_b.cpp"})
+    {
+        arg srcfile;
+        catrs(&srcfile, to_csubstr(tmpdir), to_csubstr(name), '\0');
+        putcontents(srcfile, "#include \"dedup_enum.hpp\"\n");
+        srcfiles.emplace_back();
+        catrs(&srcfiles.back(), to_csubstr(cwd), "/", to_csubstr(srcfile));
+    }
+    for(auto const& f : srcfiles)
+    {
+        args.emplace_back(f.data());
+    }
+
+    c4::regen::Regen rg;
+    c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+
+    // the header is claimed by the first unit and skipped in the second
+    EXPECT_EQ(rg.m_registry.m_num_units, 2u);
+    EXPECT_EQ(rg.m_registry.m_num_skipped_units, 0u);
+    EXPECT_EQ(rg.m_registry.m_num_skipped_files, 1u);
+    EXPECT_EQ(rg.m_registry.m_num_skipped_entities, 1u);
+
+    // the code is attributed to the header, not to the units
+    std::string hdr, a, b;
+    c4::fs::file_get_contents("dedup_enum.c4gen.hpp", &hdr);
+    c4::fs::file_get_contents("dedup_a.c4gen.hpp", &a);
+    c4::fs::file_get_contents("dedup_b.c4gen.hpp", &b);
+    EXPECT_NE(hdr.find("EnumPairs<MyEnum_e>"), std::string::npos);
+    EXPECT_EQ(a.find("MyEnum_e"), std::string::npos);
+    EXPECT_EQ(b.find("MyEnum_e"), std::string::npos);
+
+    // the map has only the files named after each unit
+    std::string a_name = srcfiles[0].data(), b_name = srcfiles[1].data();
+    EXPECT_EQ(output_map(rg, {a_name.c_str(), b_name.c_str()}),
+              a_name + "\tdedup_a.c4gen.cpp\tdedup_a.c4gen.def.hpp\tdedup_a.c4gen.hpp\n" +
+              b_name + "\tdedup_b.c4gen.cpp\tdedup_b.c4gen.def.hpp\tdedup_b.c4gen.hpp\n");
+    // and when asked, the files of the header in the line of the first unit
+    EXPECT_EQ(output_map_with_headers(rg, {a_name.c_str(), b_name.c_str()}),
+              a_name + "\tdedup_a.c4gen.cpp\tdedup_a.c4gen.def.hpp\tdedup_a.c4gen.hpp"
+                       "\tdedup_enum.c4gen.cpp\tdedup_enum.c4gen.def.hpp\tdedup_enum.c4gen.hpp\n" +
+              b_name + "\tdedup_b.c4gen.cpp\tdedup_b.c4gen.def.hpp\tdedup_b.c4gen.hpp\n");
+}
+
+TEST(enums_basic, pch_is_reused_and_rebuilt)
+{
+    arg tmpdir, cfgfile, prefix, srcfile, incflag, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_pch/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&prefix, to_csubstr(tmpdir), "pch_prefix.hpp", '\0');
+    cwd = c4::fs::cwd<arg>();
+    catrs(&incflag, "-I", to_csubstr(cwd).trimr('\0'), "/", to_csubstr(tmpdir), '\0');
+    std::string pch;
+    catrs(&pch, "\npch:\n  headers: ['<pch_prefix.hpp>']\n  dir: ", to_csubstr(tmpdir), "pch\n");
+    putcontents(cfgfile, to_csubstr(enums_cfg("writer: gengroup", to_csubstr(pch))));
+    putcontents(prefix, R"(#pragma once
+#define C4_ENUM(...)
+)");
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "pch_main.cpp", '\0');
+        putcontents(f, R"(#include <pch_prefix.hpp>
+C4_ENUM()
+typedef enum {FOO, BAR} MyPchEnum_e;
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    std::vector<std::string> pch_files;
+    auto run = [&](bool *rebuilt, std::string *hdr, std::string *src) {
+        std::vector<const char*> args = {
+            "--cmd", "generate",
+            "--flag", "-x",
+            "--flag", "c++",
+            "--flag", incflag.data(),
+            "--cfg", cfgfile.data(),
+            "--",
+            srcfile.data(),
+        };
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        EXPECT_TRUE(rg.m_pch.active());
+        EXPECT_EQ(rg.m_pch.m_num_headers, 1u);
+        EXPECT_TRUE(c4::fs::path_exists(rg.m_pch.m_pch_file.c_str()));
+        pch_files.push_back(rg.m_pch.m_pch_file);
+        *rebuilt = rg.m_pch.m_rebuilt;
+        c4::fs::file_get_contents("pch_main.c4gen.hpp", hdr);
+        c4::fs::file_get_contents("pch_main.c4gen.cpp", src);
+    };
+
+    bool rebuilt;
+    std::string hdr0, src0, hdr1, src1, hdr2, src2;
+    run(&rebuilt, &hdr0, &src0);
+    EXPECT_TRUE(rebuilt);
+    EXPECT_NE(src0.find("{ FOO, \"FOO\"}"), std::string::npos);
+    // the second run parses with the same pch, and gets the same code
+    run(&rebuilt, &hdr1, &src1);
+    EXPECT_FALSE(rebuilt);
+    EXPECT_EQ(hdr1, hdr0);
+    EXPECT_EQ(src1, src0);
+    // the pch is rebuilt in place when the prefix changes
+    putcontents(prefix, R"(#pragma once
+#define C4_ENUM(...)
+#define PCH_PREFIX_CHANGED
+)");
+    run(&rebuilt, &hdr2, &src2);
+    EXPECT_TRUE(rebuilt);
+    EXPECT_EQ(hdr2, hdr0);
+    EXPECT_EQ(src2, src0);
+    ASSERT_EQ(pch_files.size(), 3u);
+    EXPECT_EQ(pch_files[1], pch_files[0]);
+    EXPECT_EQ(pch_files[2], pch_files[0]);
+}
+
+TEST(enums_basic, ast_cache_is_invalidated_by_a_rebuilt_pch)
+{
+    arg tmpdir, cfgfile, prefix, srcfile, incflag, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_pch_ast/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&prefix, to_csubstr(tmpdir), "pch_ast_prefix.hpp", '\0');
+    cwd = c4::fs::cwd<arg>();
+    catrs(&incflag, "-I", to_csubstr(cwd).trimr('\0'), "/", to_csubstr(tmpdir), '\0');
+    std::string more;
+    catrs(&more, "\npch:\n  headers: ['<pch_ast_prefix.hpp>']\n  dir: ", to_csubstr(tmpdir), "pch\n",
+          "ast_cache: ", to_csubstr(tmpdir), "ast\n");
+    putcontents(cfgfile, to_csubstr(enums_cfg("writer: gengroup", to_csubstr(more))));
+    putcontents(prefix, "#pragma once\n#define C4_ENUM(...)\n#define PCH_AST_VALUE 1\n");
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "pch_ast_main.cpp", '\0');
+        putcontents(f, R"(#include <pch_ast_prefix.hpp>
+C4_ENUM()
+typedef enum {FOO = PCH_AST_VALUE, BAR} MyPchAstEnum_e;
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    auto run = [&](bool *rebuilt, size_t *hits) {
+        std::vector<const char*> args = {
+            "--cmd", "generate",
+            "--flag", "-x",
+            "--flag", "c++",
+            "--flag", incflag.data(),
+            "--cfg", cfgfile.data(),
+            "--",
+            srcfile.data(),
+        };
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        EXPECT_TRUE(rg.m_pch.active());
+        *rebuilt = rg.m_pch.m_rebuilt;
+        *hits = rg.m_ast_cache.m_num_hits;
+    };
+
+    bool rebuilt;
+    size_t hits;
+    run(&rebuilt, &hits);
+    EXPECT_TRUE(rebuilt);
+    EXPECT_EQ(hits, 0u);
+    run(&rebuilt, &hits);
+    EXPECT_FALSE(rebuilt);
+    EXPECT_EQ(hits, 1u);
+    // the pch is rebuilt at the same path, so the unit is parsed again
+    putcontents(prefix, "#pragma once\n#define C4_ENUM(...)\n#define PCH_AST_VALUE 2\n");
+    run(&rebuilt, &hits);
+    EXPECT_TRUE(rebuilt);
+    EXPECT_EQ(hits, 0u);
+    run(&rebuilt, &hits);
+    EXPECT_FALSE(rebuilt);
+    EXPECT_EQ(hits, 1u);
+}
+
+TEST(enums_basic, ast_cache_matches_parse_until_a_file_changes)
+{
+    arg tmpdir, cfgfile, hdrfile, srcfile, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_ast_cache/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&hdrfile, to_csubstr(tmpdir), "ast_enum.hpp", '\0');
+    cwd = c4::fs::cwd<arg>();
+    std::string cache;
+    catrs(&cache, "\nast_cache: ", to_csubstr(tmpdir), "ast\n");
+    putcontents(cfgfile, to_csubstr(enums_cfg("writer: gengroup", to_csubstr(cache))));
+    const char hdr[] = "#pragma once\n#define C4_ENUM(...)\nC4_ENUM()\ntypedef enum {FOO, BAR} MyCachedHdrEnum_e;\n";
+    putcontents(hdrfile, hdr);
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "ast_main.cpp", '\0');
+        putcontents(f, "#include \"ast_enum.hpp\"\nC4_ENUM()\ntypedef enum {BAZ, BAT} MyCachedEnum_e;\n");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    auto run = [&](size_t *hits, std::string *out) {
+        std::vector<const char*> args = {
+            "--cmd", "generate",
+            "--flag", "-x",
+            "--flag", "c++",
+            "--cfg", cfgfile.data(),
+            "--",
+            srcfile.data(),
+        };
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        EXPECT_EQ(rg.m_ast_cache.m_num_hits + rg.m_ast_cache.m_num_misses, 1u);
+        *hits = rg.m_ast_cache.m_num_hits;
+        out->clear();
+        for(const char *name : {"ast_main.c4gen.hpp", "ast_main.c4gen.cpp", "ast_enum.c4gen.hpp", "ast_enum.c4gen.cpp"})
+        {
+            std::string contents;
+            c4::fs::file_get_contents(name, &contents);
+            *out += contents;
+        }
+    };
+
+    size_t hits;
+    std::string parsed, loaded, touched, changed;
+    run(&hits, &parsed);
+    EXPECT_EQ(hits, 0u);
+    EXPECT_NE(parsed.find("{ BAT, \"BAT\"}"), std::string::npos);
+    EXPECT_NE(parsed.find("{ BAR, \"BAR\"}"), std::string::npos);
+    // the unit loaded from the cache gives the same code as the parse
+    run(&hits, &loaded);
+    EXPECT_EQ(hits, 1u);
+    EXPECT_EQ(loaded, parsed);
+    // writing the same contents keeps the entry
+    putcontents(hdrfile, hdr);
+    run(&hits, &touched);
+    EXPECT_EQ(hits, 1u);
+    EXPECT_EQ(touched, parsed);
+    // an include changed with the same size, likely within the same second
+    std::string hdr2 = hdr;
+    hdr2.replace(hdr2.find("BAR"), 3, "BAX");
+    putcontents(hdrfile, to_csubstr(hdr2));
+    run(&hits, &changed);
+    EXPECT_EQ(hits, 0u);
+    EXPECT_NE(changed.find("{ BAX, \"BAX\"}"), std::string::npos);
+    EXPECT_EQ(changed.find("{ BAR, \"BAR\"}"), std::string::npos);
+    // and the new entry is used from now on
+    run(&hits, &loaded);
+    EXPECT_EQ(hits, 1u);
+    EXPECT_EQ(loaded, changed);
+}
+
+TEST(enums_basic, unity_parse_matches_per_file_parse)
+{
+    arg tmpdir, cfgfile, cwd;
+    std::vector<arg> hdrfiles;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_unity/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    const char *names[] = {"unity_a.hpp", "unity_b.hpp"};
+    const char *srcs[] = {
+        R"(#pragma once
+#define C4_ENUM(...)
+C4_ENUM()
+typedef enum {FOO, BAR} MyEnumA_e;
+)",
+        R"(#pragma once
+#include "unity_a.hpp"
+C4_ENUM(aaa)
+typedef enum {BAZ, BAT} MyEnumB_e;
+)",
+    };
+    for(size_t i = 0; i < C4_COUNTOF(names); ++i)
+    {
+        arg hdrfile;
+        catrs(&hdrfile, to_csubstr(tmpdir), to_csubstr(names[i]), '\0');
+        putcontents(hdrfile, to_csubstr(srcs[i]));
+        hdrfiles.emplace_back();
+        catrs(&hdrfiles.back(), to_csubstr(cwd), "/", to_csubstr(hdrfile));
+    }
+
+    auto run = [&](bool unity, std::vector<std::string> *contents) {
+        std::vector<const char*> args = {
+            "--cmd", "generate",
+            "--flag", "-x",
+            "--flag", "c++",
+            "--cfg", cfgfile.data(),
+        };
+        if(unity) args.push_back("--unity");
+        args.push_back("--");
+        for(auto const& f : hdrfiles) args.emplace_back(f.data());
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        contents->clear();
+        for(const char *out : {"unity_a.c4gen.hpp", "unity_a.c4gen.cpp", "unity_b.c4gen.hpp", "unity_b.c4gen.cpp"})
+        {
+            contents->emplace_back();
+            c4::fs::file_get_contents(out, &contents->back());
+            fs::file_put_contents(out, csubstr{}); // clear for the next run
+        }
+    };
+
+    std::vector<std::string> per_file, unity;
+    run(false, &per_file);
+    run(true, &unity);
+    ASSERT_EQ(per_file.size(), unity.size());
+    for(size_t i = 0; i < per_file.size(); ++i)
+    {
+        EXPECT_EQ(per_file[i], unity[i]);
+    }
+    EXPECT_NE(unity[0].find("MyEnumA_e"), std::string::npos);
+    EXPECT_NE(unity[2].find("MyEnumB_e"), std::string::npos);
+    EXPECT_EQ(unity[2].find("MyEnumA_e"), std::string::npos);
+}
+
+TEST(enums_basic, generate_from_snapshot_matches_parse)
+{
+    arg tmpdir, cfgfile, srcfile, snapdir, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_snapshot/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&snapdir, to_csubstr(tmpdir), "snapshots", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "snap_enums.hpp", '\0');
+        putcontents(f, R"(#pragma once
+#define C4_ENUM(...)
+C4_ENUM(aaa, bbb: ccc)
+typedef enum {FOO, BAR} MyEnumA_e;
+C4_ENUM()
+typedef enum {BAZ = 10, BAT = 20} MyEnumB_e;
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    auto run = [&](const char *cmd, bool from_snapshot, std::vector<std::string> *contents) {
+        std::vector<const char*> args = {
+            "--cmd", cmd,
+            "--flag", "-x",
+            "--flag", "c++",
+            "--cfg", cfgfile.data(),
+            "--snapshot-dir", snapdir.data(),
+        };
+        if(from_snapshot) args.push_back("--from-snapshot");
+        args.push_back("--");
+        args.push_back(srcfile.data());
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        contents->clear();
+        for(const char *out : {"snap_enums.c4gen.hpp", "snap_enums.c4gen.cpp"})
+        {
+            contents->emplace_back();
+            c4::fs::file_get_contents(out, &contents->back());
+            fs::file_put_contents(out, csubstr{}); // clear for the next run
+        }
+    };
+
+    std::vector<std::string> parsed, extracted, snapshot;
+    run("generate", false, &parsed);
+    run("extract", false, &extracted);
+    run("generate", true, &snapshot);
+    ASSERT_EQ(parsed.size(), snapshot.size());
+    for(size_t i = 0; i < parsed.size(); ++i)
+    {
+        EXPECT_TRUE(extracted[i].empty()); // extract does not generate code
+        EXPECT_EQ(parsed[i], snapshot[i]);
+    }
+    EXPECT_NE(snapshot[1].find("/* meta.bbb is \"ccc\" */"), std::string::npos);
+    EXPECT_NE(snapshot[1].find("{ BAT, \"BAT\"}"), std::string::npos);
+}
+
+TEST(enums_basic, generate_from_snapshot_skips_included_headers)
+{
+    arg tmpdir, cfgfile, hdrfile, srcfile, snapdir, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_snapshot_owned/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&snapdir, to_csubstr(tmpdir), "snapshots", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "snap_owned.hpp", '\0');
+        putcontents(f, R"(#pragma once
+#define C4_ENUM(...)
+C4_ENUM()
+typedef enum {FOO, BAR} MyOwnedEnum_e;
+)");
+        catrs(&hdrfile, to_csubstr(cwd), "/", to_csubstr(f));
+        catrs(&f, to_csubstr(tmpdir), "snap_owner.cpp", '\0');
+        putcontents(f, "#include \"snap_owned.hpp\"\nC4_ENUM()\ntypedef enum {BAZ, BAT} MyOwnerEnum_e;\n");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    // the header is listed after the file including it
+    auto run = [&](const char *cmd, bool from_snapshot, bool only_hdr, std::vector<std::string> *contents) {
+        std::vector<const char*> args = {
+            "--cmd", cmd,
+            "--flag", "-x",
+            "--flag", "c++",
+            "--cfg", cfgfile.data(),
+            "--snapshot-dir", snapdir.data(),
+        };
+        if(from_snapshot) args.push_back("--from-snapshot");
+        args.push_back("--");
+        if( ! only_hdr) args.push_back(srcfile.data());
+        args.push_back(hdrfile.data());
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        if( ! only_hdr)
+        {
+            EXPECT_EQ(rg.m_registry.m_num_units, 1u);
+            EXPECT_EQ(rg.m_registry.m_num_skipped_units, 1u);
+        }
+        contents->clear();
+        for(const char *out : {"snap_owner.c4gen.hpp", "snap_owner.c4gen.cpp", "snap_owned.c4gen.hpp", "snap_owned.c4gen.cpp"})
+        {
+            contents->emplace_back();
+            c4::fs::file_get_contents(out, &contents->back());
+            fs::file_put_contents(out, csubstr{}); // clear for the next run
+        }
+    };
+
+    std::vector<std::string> parsed, extracted, snapshot, stale;
+    run("generate", false, false, &parsed);
+    EXPECT_NE(parsed[1].find("{ BAT, \"BAT\"}"), std::string::npos);
+    EXPECT_NE(parsed[3].find("{ BAR, \"BAR\"}"), std::string::npos);
+    EXPECT_EQ(parsed[1].find("{ BAR, \"BAR\"}"), std::string::npos);
+    // the header has no snapshot of its own
+    run("extract", false, false, &extracted);
+    run("generate", true, false, &snapshot);
+    EXPECT_EQ(snapshot, parsed);
+    // a snapshot of the header from another run is not used either
+    run("extract", false, true, &extracted);
+    run("generate", true, false, &stale);
+    EXPECT_EQ(stale, parsed);
+}
+
+TEST(enums_basic, depfile_lists_included_headers)
+{
+    arg tmpdir, cfgfile, hdrfile, srcfile, mffile, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_depfile/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&hdrfile, to_csubstr(tmpdir), "dep_enum.hpp", '\0');
+    catrs(&mffile, to_csubstr(tmpdir), "all.d", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    putcontents(hdrfile, R"(#pragma once
+#define C4_ENUM(...)
+)");
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "dep_main.cpp", '\0');
+        putcontents(f, R"(#include "dep_enum.hpp"
+C4_ENUM()
+typedef enum {FOO, BAR} MyEnum_e;
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+    std::vector<const char*> args = {
+        "--cmd", "generate",
+        "--flag", "-x",
+        "--flag", "c++",
+        "--cfg", cfgfile.data(),
+        "--depfile",
+        "--MF", mffile.data(),
+        "--MT", "regen.stamp",
+        "--",
+        srcfile.data(),
+    };
+    c4::regen::Regen rg;
+    c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+
+    std::string hdr, d, mf;
+    c4::regen::normalize_path(to_csubstr(hdrfile).trimr('\0'), to_csubstr(cwd).trimr('\0'), &hdr);
+    c4::fs::file_get_contents("dep_main.c4gen.cpp.d", &d); // named after the first output
+    c4::fs::file_get_contents(mffile.data(), &mf);
+    // the per-unit depfile has the outputs as targets
+    EXPECT_NE(d.find("dep_main.c4gen.cpp "), std::string::npos);
+    EXPECT_NE(d.find("dep_main.c4gen.hpp:"), std::string::npos);
+    EXPECT_NE(d.find("dep_main.cpp"), std::string::npos);
+    EXPECT_NE(d.find(hdr), std::string::npos);
+    EXPECT_NE(d.find("c4regen.cfg.yml"), std::string::npos);
+    // the run's depfile uses the given target
+    EXPECT_NE(mf.find("/regen.stamp:"), std::string::npos);
+    EXPECT_EQ(mf.find("dep_main.c4gen.hpp"), std::string::npos);
+    EXPECT_NE(mf.find(hdr), std::string::npos);
+}
+
+TEST(enums_basic, depfile_targets_get_the_samefile_inputs)
+{
+    arg tmpdir, cfgfile, hdrfile, srcfile, mffile, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_depfile_samefile/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&hdrfile, to_csubstr(tmpdir), "dep_same_enum.hpp", '\0');
+    catrs(&mffile, to_csubstr(tmpdir), "all.d", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(enums_cfg("writer: samefile")));
+    putcontents(hdrfile, R"(#pragma once
+#define C4_ENUM(...)
+)");
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "dep_same_main.cpp", '\0');
+        putcontents(f, R"(#include "dep_same_enum.hpp"
+C4_ENUM()
+typedef enum {FOO, BAR} MyEnum_e;
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+    std::vector<const char*> args = {
+        "--cmd", "generate",
+        "--flag", "-x",
+        "--flag", "c++",
+        "--cfg", cfgfile.data(),
+        "--MF", mffile.data(),
+        "--MT", "regen_same.stamp",
+        "--",
+        srcfile.data(),
+    };
+    c4::regen::Regen rg;
+    c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+
+    // the code is written into the source, so the unit has no outputs;
+    // its inputs still go to the given target
+    std::string hdr, mf;
+    c4::regen::normalize_path(to_csubstr(hdrfile).trimr('\0'), to_csubstr(cwd).trimr('\0'), &hdr);
+    c4::fs::file_get_contents(mffile.data(), &mf);
+    EXPECT_NE(mf.find("/regen_same.stamp:"), std::string::npos);
+    EXPECT_NE(mf.find("dep_same_main.cpp"), std::string::npos);
+    EXPECT_NE(mf.find(hdr), std::string::npos);
+    EXPECT_NE(mf.find("c4regen.cfg.yml"), std::string::npos);
+}
+
+TEST(enums_basic, parallel_parse_matches_serial_parse)
+{
+    arg tmpdir, cfgfile, cwd;
+    std::vector<arg> srcfiles;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_jobs/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    std::vector<std::string> outputs;
+    for(size_t i = 0; i < 6; ++i)
+    {
+        arg f, name, src;
+        catrs(&name, "jobs_", i);
+        catrs(&f, to_csubstr(tmpdir), to_csubstr(name), ".cpp", '\0');
+        catrs(&src, "#define C4_ENUM(...)\nC4_ENUM()\ntypedef enum {FOO", i, ", BAR", i, "} MyEnum", i, "_e;\n");
+        putcontents(f, to_csubstr(src));
+        srcfiles.emplace_back();
+        catrs(&srcfiles.back(), to_csubstr(cwd), "/", to_csubstr(f));
+        outputs.emplace_back(name.begin(), name.end());
+        outputs.back() += ".c4gen.cpp";
+    }
+
+    auto run = [&](const char *jobs, std::vector<std::string> *contents) {
+        std::vector<const char*> args = {
+            "--cmd", "generate",
+            "--flag", "-x",
+            "--flag", "c++",
+            "--cfg", cfgfile.data(),
+            "--jobs", jobs,
+            "--",
+        };
+        for(auto const& f : srcfiles) args.emplace_back(f.data());
+        c4::regen::Regen rg;
+        c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+        contents->clear();
+        for(auto const& out : outputs)
+        {
+            contents->emplace_back();
+            c4::fs::file_get_contents(out.c_str(), &contents->back());
+        }
+        return rg.m_writer.num_unchanged();
+    };
+
+    std::vector<std::string> serial, parallel;
+    run("1", &serial);
+    // the contents are the same, so none of the hdr/inl/src files is
+    // written again
+    EXPECT_EQ(run("4", &parallel), 3 * outputs.size());
+    ASSERT_EQ(serial.size(), parallel.size());
+    for(size_t i = 0; i < serial.size(); ++i)
+    {
+        EXPECT_EQ(serial[i], parallel[i]);
+        EXPECT_NE(parallel[i].find("MyEnum" + std::to_string(i) + "_e"), std::string::npos);
+    }
+}
+
+TEST(write_queue, writes_in_order)
+{
+    using Item = c4::regen::WriteQueue::Item;
+    for(size_t depth : {0, 1, 3})
+    {
+        c4::regen::WriteQueue q;
+        q.set_depth(depth);
+        std::vector<Item*> pushed, written;
+        q.start([&](Item &item){ written.push_back(&item); });
+        for(size_t i = 0; i < 20; ++i)
+        {
+            Item &item = q.acquire();
+            EXPECT_EQ(item.m_written, i >= (depth ? depth + 2 : 1));
+            item.m_written = false;
+            pushed.push_back(&item);
+            q.push(item);
+        }
+        size_t num_recycled = 0;
+        q.finish([&](Item &){ ++num_recycled; });
+        EXPECT_EQ(num_recycled, depth ? depth + 2 : 1);
+        EXPECT_EQ(written, pushed);
+        EXPECT_EQ(q.m_num_written, pushed.size());
+    }
+}
+
+TEST(enums_basic, sink_receives_each_file)
+{
+    arg tmpdir, cfgfile, cwd;
+    std::vector<arg> srcfiles;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "enums_sink/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_enums_cfg));
+    for(size_t i = 0; i < 3; ++i)
+    {
+        arg f, src;
+        catrs(&f, to_csubstr(tmpdir), "sink_", i, ".cpp", '\0');
+        catrs(&src, "#define C4_ENUM(...)\nC4_ENUM()\ntypedef enum {FOO", i, ", BAR", i, "} MyEnum", i, "_e;\n");
+        putcontents(f, to_csubstr(src));
+        srcfiles.emplace_back();
+        catrs(&srcfiles.back(), to_csubstr(cwd), "/", to_csubstr(f));
+    }
+
+    struct EnumNames : public c4::regen::SourceFileSink
+    {
+        std::vector<std::string> names;
+        size_t num_chunks = 0;
+        void consume(c4::regen::SourceFile &sf) override
+        {
+            for(auto const& e : sf.m_enums)
+            {
+                names.emplace_back(e.m_name.str, e.m_name.len);
+            }
+            num_chunks += sf.m_chunks.size();
+        }
+    } sink;
+
+    std::vector<const char*> files;
+    for(auto const& f : srcfiles) files.push_back(f.data());
+    const char* flags[] = {"-x", "c++"};
+    c4::regen::Regen rg(cfgfile.data());
+    rg.gencode(files, sink, nullptr, flags, C4_COUNTOF(flags));
+
+    // the files are handed out in order, and not retained
+    EXPECT_EQ(sink.names, (std::vector<std::string>{"MyEnum0_e", "MyEnum1_e", "MyEnum2_e"}));
+    EXPECT_EQ(sink.num_chunks, 3u);
+    EXPECT_TRUE(rg.m_src_files.empty());
+}
+
+TEST(enums_basic, gencode_buffers)
+{
+    BufferGen g("c4regen_unsaved", basic_enums_cfg);
+    std::string src = g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyUnsavedEnum_e;\n";
+    for(int i = 0; i < 2; ++i) // the config stays loaded across calls
+    {
+        auto const& out = g.gen(src);
+        ASSERT_EQ(out.size(), 1u);
+        EXPECT_EQ(out[0].m_source, g.srcname);
+        EXPECT_EQ(out[0].m_names.m_hdr, "c4regen_unsaved.c4gen.hpp");
+        EXPECT_NE(out[0].m_code.m_hdr.find("EnumPairs<MyUnsavedEnum_e>"), std::string::npos);
+        EXPECT_NE(out[0].m_code.m_src.find("{ FOO, \"FOO\"}"), std::string::npos);
+    }
+    // nothing was written
+    EXPECT_FALSE(c4::fs::path_exists(g.srcname.c_str()));
+    EXPECT_FALSE(c4::fs::path_exists("c4regen_unsaved.c4gen.hpp"));
+}
+
+TEST(enums_basic, single_file_aggregates_sources)
+{
+    BufferGen g("c4regen_single", enums_cfg("writer: singlefile\nsingle_file: all_enums"));
+    std::string aname, bname;
+    g.path("c4regen_single_a", ".cpp", &aname);
+    g.path("c4regen_single_b", ".cpp", &bname);
+    std::string asrc = g.include + "C4_ENUM()\ntypedef enum {FOOA, BARA} MyEnumA_e;\n";
+    std::string bsrc = g.include + "C4_ENUM()\ntypedef enum {FOOB, BARB} MyEnumB_e;\n";
+
+    auto ab = g.gen_sources({{aname, asrc}, {bname, bsrc}});
+    auto ba = g.gen_sources({{bname, bsrc}, {aname, asrc}});
+
+    // all the sources go to a single set of files
+    ASSERT_EQ(ab.size(), 1u);
+    ASSERT_EQ(ba.size(), 1u);
+    EXPECT_EQ(ab[0].m_names.m_hdr, "all_enums.c4gen.hpp");
+    EXPECT_EQ(ab[0].m_names.m_src, "all_enums.c4gen.cpp");
+    // the order of the sources does not matter
+    EXPECT_EQ(ab[0].m_code.m_hdr, ba[0].m_code.m_hdr);
+    EXPECT_EQ(ab[0].m_code.m_src, ba[0].m_code.m_src);
+    csubstr h = to_csubstr(ab[0].m_code.m_hdr);
+    size_t a = h.find("EnumPairs<MyEnumA_e>");
+    size_t b = h.find("EnumPairs<MyEnumB_e>");
+    ASSERT_NE(a, csubstr::npos);
+    ASSERT_NE(b, csubstr::npos);
+    EXPECT_LT(a, b);
+    // the preamble is emitted once
+    size_t pre = h.find("#include \"enum_pairs.h\"");
+    ASSERT_NE(pre, csubstr::npos);
+    EXPECT_EQ(h.find("#include \"enum_pairs.h\"", pre + 1), csubstr::npos);
+}
+
+TEST(enums_basic, shards_split_the_src_file)
+{
+    BufferGen g("c4regen_shards", enums_cfg("writer: gengroup\nshards: 3"));
+    std::string src = g.include;
+    for(int i = 0; i < 8; ++i)
+    {
+        catrs(append, &src, "C4_ENUM()\ntypedef enum {FOO", i, ", BAR", i, "} MyShardedEnum", i, "_e;\n");
+    }
+    auto out = g.gen(src);
+
+    // the hdr, and then each of the shards in place of the src
+    ASSERT_EQ(out.size(), 4u);
+    EXPECT_EQ(out[0].m_names.m_hdr, "c4regen_shards.c4gen.hpp");
+    EXPECT_TRUE(out[0].m_names.m_src.empty());
+    for(int i = 0; i < 8; ++i)
+    {
+        std::string sym = "{ FOO" + std::to_string(i) + ", \"FOO" + std::to_string(i) + "\"}";
+        size_t count = 0;
+        for(size_t k = 1; k < out.size(); ++k)
+        {
+            if(out[k].m_code.m_src.find(sym) != std::string::npos) ++count;
+        }
+        EXPECT_EQ(count, 1u) << sym;
+    }
+    for(size_t k = 1; k < out.size(); ++k)
+    {
+        EXPECT_EQ(out[k].m_names.m_src, "c4regen_shards.c4gen." + std::to_string(k - 1) + ".cpp");
+        if( ! out[k].m_code.m_src.empty())
+        {
+            EXPECT_NE(out[k].m_code.m_src.find("#include \"c4regen_shards.c4gen.hpp\""), std::string::npos);
+        }
+    }
+    // the layout is stable
+    auto const& again = g.gen(src);
+    ASSERT_EQ(again.size(), out.size());
+    for(size_t k = 0; k < out.size(); ++k)
+    {
+        EXPECT_EQ(again[k].m_code.m_src, out[k].m_code.m_src);
+    }
+    // every shard is an output
+    c4::regen::Writer::set_type names;
+    g.rg.m_writer.insert_filenames(to_csubstr(g.srcname), &names);
+    EXPECT_EQ(names.count("c4regen_shards.c4gen.cpp"), 0u);
+    EXPECT_EQ(names.count("c4regen_shards.c4gen.0.cpp"), 1u);
+    EXPECT_EQ(names.count("c4regen_shards.c4gen.1.cpp"), 1u);
+    EXPECT_EQ(names.count("c4regen_shards.c4gen.2.cpp"), 1u);
+    // and is listed in the map for the build systems
+    EXPECT_EQ(output_map(g.rg, {g.srcname.c_str()}), g.srcname +
+              "\tc4regen_shards.c4gen.0.cpp"
+              "\tc4regen_shards.c4gen.1.cpp"
+              "\tc4regen_shards.c4gen.2.cpp"
+              "\tc4regen_shards.c4gen.def.hpp"
+              "\tc4regen_shards.c4gen.hpp\n");
+}
+
+TEST(enums_basic, samefile_splices_marked_blocks)
+{
+    BufferGen g("c4regen_samefile", enums_cfg("writer: samefile"));
+    auto gen = [&](std::string const& src) {
+        auto const& out = g.gen(src);
+        EXPECT_EQ(out.size(), 1u);
+        EXPECT_EQ(out[0].m_names.m_src, g.srcname);
+        return out.empty() ? std::string{} : out[0].m_code.m_src;
+    };
+
+    const std::string begin = "// regen:GENERATED:(BEGIN)";
+    const std::string end = "// regen:GENERATED:(END)";
+    std::string src = g.include + R"(C4_ENUM()
+typedef enum {FOO, BAR} MyEnumA_e;
+int between = 0;
+C4_ENUM()
+typedef enum {BAZ, BAT} MyEnumB_e;
+)";
+    std::string first = gen(src);
+    // a block after each entity
+    size_t a = first.find("MyEnumA_e;\n" + begin);
+    size_t b = first.find("MyEnumB_e;\n" + begin);
+    ASSERT_NE(a, std::string::npos);
+    ASSERT_NE(b, std::string::npos);
+    EXPECT_LT(first.find("{ FOO, \"FOO\"}"), first.find("int between"));
+    EXPECT_GT(first.find("{ BAZ, \"BAZ\"}"), first.find("int between"));
+    // the preamble goes in the first block
+    EXPECT_LT(first.find("#include \"enum_pairs.h\""), first.find("{ FOO, \"FOO\"}"));
+    EXPECT_EQ(first.find("#include \"enum_pairs.h\""), first.rfind("#include \"enum_pairs.h\""));
+    // nothing changes in the next run
+    EXPECT_EQ(gen(first), first);
+    // edits to the blocks are overwritten, and the rest is kept
+    std::string edited = first;
+    edited.replace(edited.find("{ BAZ, \"BAZ\"}"), 4, "{ XX");
+    edited.replace(edited.find("int between"), 11, "int changed");
+    std::string fixed = gen(edited);
+    EXPECT_NE(fixed.find("{ BAZ, \"BAZ\"}"), std::string::npos);
+    EXPECT_NE(fixed.find("int changed"), std::string::npos);
+    // the blocks of removed entities are removed
+    std::string removed = first;
+    removed.replace(removed.find("C4_ENUM()\ntypedef enum {FOO"), strlen("C4_ENUM()\n"), "");
+    removed.insert(0, begin + "\nstale\n" + end + "\n");
+    std::string cleaned = gen(removed);
+    EXPECT_EQ(cleaned.find("stale"), std::string::npos);
+    EXPECT_EQ(cleaned.find("{ FOO, \"FOO\"}"), std::string::npos);
+    EXPECT_NE(cleaned.find("{ BAZ, \"BAZ\"}"), std::string::npos);
+    EXPECT_EQ(gen(cleaned), cleaned);
+}
+
+TEST(enums_basic, genfile_writes_each_generator_apart)
+{
+    BufferGen g("c4regen_genfile", enums_cfg("writer: genfile", R"(
+  - name: enum_count
+    type: enum
+    extract:
+      macro: C4_ENUM
+    hdr_preamble: |
+      #include "enum_count.h"
+    hdr: |
+      template<> constexpr size_t enum_count<{{type}}>() { return {% for e in symbols %}1+{% endfor %}0; }
+)"));
+    std::string src = g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyGenFileEnum_e;\n";
+    auto const& out = g.gen(src);
+
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].m_names.m_hdr, "c4regen_genfile.enum_symbols.c4gen.hpp");
+    EXPECT_EQ(out[1].m_names.m_hdr, "c4regen_genfile.enum_count.c4gen.hpp");
+    // each file has the code and the preamble of its generator only
+    EXPECT_NE(out[0].m_code.m_hdr.find("enum_pairs.h"), std::string::npos);
+    EXPECT_EQ(out[0].m_code.m_hdr.find("enum_count"), std::string::npos);
+    EXPECT_NE(out[1].m_code.m_hdr.find("enum_count.h"), std::string::npos);
+    EXPECT_NE(out[1].m_code.m_hdr.find("enum_count<MyGenFileEnum_e>"), std::string::npos);
+    EXPECT_EQ(out[1].m_code.m_hdr.find("enum_pairs"), std::string::npos);
+
+    c4::regen::Writer::set_type names;
+    g.rg.m_writer.insert_filenames(to_csubstr(g.srcname), &names);
+    EXPECT_EQ(names, (c4::regen::Writer::set_type{
+        "c4regen_genfile.enum_count.c4gen.cpp",
+        "c4regen_genfile.enum_count.c4gen.def.hpp",
+        "c4regen_genfile.enum_count.c4gen.hpp",
+        "c4regen_genfile.enum_symbols.c4gen.cpp",
+        "c4regen_genfile.enum_symbols.c4gen.def.hpp",
+        "c4regen_genfile.enum_symbols.c4gen.hpp",
+    }));
+    // the map for the build systems has the same files
+    EXPECT_EQ(output_map(g.rg, {g.srcname.c_str()}), g.srcname +
+              "\tc4regen_genfile.enum_count.c4gen.cpp"
+              "\tc4regen_genfile.enum_count.c4gen.def.hpp"
+              "\tc4regen_genfile.enum_count.c4gen.hpp"
+              "\tc4regen_genfile.enum_symbols.c4gen.cpp"
+              "\tc4regen_genfile.enum_symbols.c4gen.def.hpp"
+              "\tc4regen_genfile.enum_symbols.c4gen.hpp\n");
+}
+
+TEST(enums_basic, render_cache_reuses_unchanged_entities)
+{
+    arg tmpdir = c4::fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "render_cache");
+    std::string cache;
+    catrs(&cache, "\nrender_cache: ", to_csubstr(tmpdir).trimr('\0'), "\n");
+    BufferGen g("c4regen_render_cache", enums_cfg("writer: gengroup", to_csubstr(cache)));
+    std::string src_a = g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyCachedEnum_e;\nC4_ENUM()\ntypedef enum {BAZ} MyOtherEnum_e;\n";
+    std::string src_b = g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyCachedEnum_e;\nC4_ENUM()\ntypedef enum {BAZ, BAT} MyOtherEnum_e;\n";
+
+    auto first = g.gen(src_a);
+    EXPECT_EQ(g.rg.m_render_cache.num_hits(), 0u);
+    EXPECT_EQ(g.rg.m_render_cache.num_misses(), 2u);
+
+    // nothing changed: every entity is loaded from the cache
+    auto const& again = g.gen(src_a);
+    EXPECT_EQ(g.rg.m_render_cache.num_hits(), 2u);
+    EXPECT_EQ(g.rg.m_render_cache.num_misses(), 0u);
+    ASSERT_EQ(again.size(), first.size());
+    for(size_t i = 0; i < first.size(); ++i)
+    {
+        EXPECT_EQ(again[i].m_code.m_hdr, first[i].m_code.m_hdr);
+        EXPECT_EQ(again[i].m_code.m_inl, first[i].m_code.m_inl);
+        EXPECT_EQ(again[i].m_code.m_src, first[i].m_code.m_src);
+    }
+
+    // one enum changed: only that one is rendered again
+    auto const& changed = g.gen(src_b);
+    EXPECT_EQ(g.rg.m_render_cache.num_hits(), 1u);
+    EXPECT_EQ(g.rg.m_render_cache.num_misses(), 1u);
+    ASSERT_EQ(changed.size(), 1u);
+    EXPECT_NE(changed[0].m_code.m_src.find("BAT"), std::string::npos);
+}
+
+TEST(enums_basic, parallel_render_keeps_the_order)
+{
+    BufferGen serial("c4regen_parallel_render", enums_cfg("writer: gengroup", "\nparallel_render:\n  min_chunks: 0\n"));
+    BufferGen parallel("c4regen_parallel_render", enums_cfg("writer: gengroup", "\nparallel_render:\n  min_chunks: 128\n  jobs: 4\n"));
+    std::string src = serial.include;
+    for(size_t i = 0; i < 300; ++i)
+    {
+        catrs(append, &src, "C4_ENUM()\ntypedef enum {FOO", i, ", BAR", i, "} MyParallelEnum", i, "_e;\n");
+    }
+    EXPECT_EQ(serial.rg.m_parallel_render.num_jobs(300), 1u);
+    EXPECT_EQ(parallel.rg.m_parallel_render.num_jobs(100), 1u);
+    EXPECT_EQ(parallel.rg.m_parallel_render.num_jobs(300), 4u);
+    serial.gen(src);
+    parallel.gen(src);
+
+    ASSERT_EQ(serial.out.size(), 1u);
+    ASSERT_EQ(parallel.out.size(), 1u);
+    EXPECT_EQ(parallel.out[0].m_code.m_hdr, serial.out[0].m_code.m_hdr);
+    EXPECT_EQ(parallel.out[0].m_code.m_src, serial.out[0].m_code.m_src);
+    EXPECT_LT(serial.out[0].m_code.m_src.find("MyParallelEnum0_e"), serial.out[0].m_code.m_src.find("MyParallelEnum299_e"));
+}
+
+TEST(enums_basic, template_library_shares_parsed_templates)
+{
+    BufferGen g("c4regen_templates", R"(
+writer: gengroup
+templates:
+  pairs: |-
+    {% for e in symbols %}{ {{e.name}}, "{{e.name}}"}, {% endfor %}
+  names: 'names<{{type}}>: {% include pairs %}'
+tpl:
+  chunk: |
+    {{gencode}}
+  hdr: |
+    {{hdr.gencode}}
+generators:
+  - name: names_a
+    type: enum
+    extract:
+      macro: C4_ENUM
+    hdr: '{% include names %}'
+  - name: names_b
+    type: enum
+    extract:
+      macro: C4_ENUM
+    hdr: 'names<{{type}}>: {% include pairs %}'
+)");
+    auto const& gens = g.rg.m_gens_all;
+    ASSERT_EQ(gens.size(), 2u);
+    // both generators expand to the same source, so it is parsed once
+    EXPECT_EQ(gens[0]->m_hdr.engine, gens[1]->m_hdr.engine);
+    EXPECT_EQ(gens[0]->m_hdr.compiled, gens[1]->m_hdr.compiled);
+    EXPECT_EQ(gens[0]->m_tpl_hash, gens[1]->m_tpl_hash);
+    EXPECT_LT(g.rg.m_templates.num_parsed(), g.rg.m_templates.num_requests());
+
+    std::string expanded;
+    g.rg.m_templates.expand("{% include names %}", &expanded);
+    EXPECT_EQ(expanded, R"(names<{{type}}>: {% for e in symbols %}{ {{e.name}}, "{{e.name}}"}, {% endfor %})");
+
+    auto const& out = g.gen(g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyLibEnum_e;\n");
+    ASSERT_EQ(out.size(), 1u);
+    csubstr code = to_csubstr(out[0].m_code.m_hdr);
+    size_t first = code.find(R"(names<MyLibEnum_e>: { FOO, "FOO"}, { BAR, "BAR"}, )");
+    ASSERT_NE(first, csubstr::npos);
+    EXPECT_NE(code.find(R"(names<MyLibEnum_e>: { FOO, "FOO"}, { BAR, "BAR"}, )", first + 1), csubstr::npos);
+}
+
+TEST(enums_basic, lookup_is_dense_or_sorted)
+{
+    BufferGen g("c4regen_lookup", R"(
+writer: gengroup
+tpl:
+  chunk: |
+    {{gencode}}
+  hdr: |
+    {{hdr.gencode}}
+generators:
+  - name: lookup
+    type: enum
+    extract:
+      macro: C4_ENUM
+    hdr: |
+      {{type}}: {{lookup}} [{{value_min}},{{value_max}}] {{lookup_size}}:{% for i in lookup_index %} {{i.pos}}{% endfor %}
+)");
+    auto const& out = g.gen(g.include + R"(C4_ENUM()
+typedef enum {A = -1, B = 2, C = 0, D = 2} MyDenseEnum_e;
+C4_ENUM()
+typedef enum {X = 1000, Y = 10, Z = 100000, W = 10} MySparseEnum_e;
+C4_ENUM()
+typedef enum {} MyEmptyEnum_e;
+)");
+    ASSERT_EQ(out.size(), 1u);
+    csubstr code = to_csubstr(out[0].m_code.m_hdr);
+    // a table for the values -1..2, where the first of the symbols with the same value wins
+    EXPECT_NE(code.find("MyDenseEnum_e: dense [-1,2] 4: 0 2 -1 1"), csubstr::npos) << code;
+    // the symbols with distinct values, sorted by value
+    EXPECT_NE(code.find("MySparseEnum_e: sorted [10,100000] 3: 1 0 2"), csubstr::npos) << code;
+    EXPECT_NE(code.find("MyEmptyEnum_e: linear [,] 0:"), csubstr::npos) << code;
+}
+
+#ifdef C4REGEN_TEST_PLUGIN
+TEST(enums_basic, plugin_generator_writes_the_chunks)
+{
+    BufferGen g("c4regen_plugin", R"(
+writer: gengroup
+tpl:
+  chunk: |
+    {{gencode}}
+  src: |
+    {{src.preamble}}
+    {{src.gencode}}
+generators:
+  - name: enum_names
+    type: plugin
+    library: )" C4REGEN_TEST_PLUGIN R"(
+    extract:
+      macro: C4_ENUM
+    src_preamble: |
+      #include "enum_name.h"
+)");
+    ASSERT_EQ(g.rg.m_gens_all.size(), 1u);
+    EXPECT_EQ(g.rg.m_gens_all[0]->m_name, "enum_names");
+    auto const& out = g.gen(g.include + "C4_ENUM()\ntypedef enum {FOO, BAR} MyPluginEnum_e;\n");
+
+    ASSERT_EQ(out.size(), 1u);
+    csubstr code = to_csubstr(out[0].m_code.m_src);
+    EXPECT_NE(code.find("#include \"enum_name.h\""), csubstr::npos);
+    EXPECT_NE(code.find("template<> const char* enum_name<MyPluginEnum_e>(MyPluginEnum_e v)"), csubstr::npos);
+    EXPECT_NE(code.find("case FOO: return \"FOO\";"), csubstr::npos);
+    EXPECT_NE(code.find("case BAR: return \"BAR\";"), csubstr::npos);
+}
+#endif
+
+TEST(exec, response_files)
+{
+    arg tmpdir, rspfile;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "response_files/");
+    catrs(&rspfile, to_csubstr(tmpdir), "files.rsp", '\0');
+    putcontents(rspfile, "b.cpp\r\n\n  c.cpp\nd.cpp");
+    std::string rsparg = "@" + std::string(rspfile.data());
+    std::vector<const char*> args = {"a.cpp", rsparg.c_str(), "e.cpp"};
+    std::vector<std::string> files;
+    c4::regen::collect_files(args, &files);
+    EXPECT_EQ(files, (std::vector<std::string>{"a.cpp", "b.cpp", "c.cpp", "d.cpp", "e.cpp"}));
+}
+
+TEST(writer, chunk_template_split)
+{
+    using c4::regen::ChunkTemplate;
+    ChunkTemplate t;
+    ASSERT_TRUE(t.split(to_csubstr(c4::regen::s_default_tpl_chunk)));
+    std::vector<ChunkTemplate::Slot_e> slots;
+    for(auto const& seg : t.m_segments)
+    {
+        if(seg.m_slot != ChunkTemplate::TEXT) slots.push_back(seg.m_slot);
+    }
+    EXPECT_EQ(slots, (std::vector<ChunkTemplate::Slot_e>{
+        ChunkTemplate::GENERATOR_NAME,
+        ChunkTemplate::ENTITY_NAME,
+        ChunkTemplate::ENTITY_FILE,
+        ChunkTemplate::ENTITY_LINE,
+        ChunkTemplate::GENCODE,
+    }));
+    EXPECT_TRUE(t.split("{{ gencode }}\n"));
+    EXPECT_EQ(t.m_segments.size(), 2u);
+    // these are left to the template engine
+    EXPECT_FALSE(t.split("{% if gencode %}{{gencode}}{% endif %}"));
+    EXPECT_FALSE(t.split("{{entity.usr}}"));
+    EXPECT_FALSE(t.m_split);
+}
+
+TEST(writer, rope_file)
+{
+    arg tmpdir, filename;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(&filename, to_csubstr(tmpdir), "rope_file.txt", '\0');
+    putcontents(filename, "old contents");
+
+    c4::yml::Tree tpl = c4::yml::parse("t: 'hello {{name}}, bye {{name}}'");
+    c4::yml::Tree props = c4::yml::parse("name: world");
+    c4::regen::CodeTemplate ct;
+    ASSERT_TRUE(ct.load(tpl.rootref(), "t"));
+    c4::tpl::Rope r;
+    ct.render(props.rootref(), &r);
+    EXPECT_FALSE(c4::regen::file_has_contents(filename.data(), r));
+
+    c4::regen::RopeFileWriter w;
+    w.add(to_csubstr(filename).trimr('\0'), r);
+    EXPECT_FALSE(w.empty());
+    w.flush();
+    EXPECT_TRUE(w.empty());
+
+    std::string contents;
+    c4::fs::file_get_contents(filename.data(), &contents);
+    EXPECT_EQ(contents, "hello world, bye world");
+    EXPECT_TRUE(c4::regen::file_has_contents(filename.data(), r));
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -651,5 +1920,183 @@ void show(bar const& obj);
     });
 }
 
+TEST(classes, compiled_templates_match_the_engine)
+{
+    arg cwd = c4::fs::cwd<arg>();
+    std::string srcname;
+    catrs(&srcname, to_csubstr(cwd).trimr('\0'), "/c4regen_compiled.cpp");
+    // with empty and non-empty sequences
+    const char src[] = R"(#define C4_CLASS(...)
+#define C4_ENUM(...)
+C4_CLASS(serialize: 1)
+struct foo
+{
+  int a, b;
+  void some_method(foo const& that, int x);
+  void no_params();
+};
+C4_CLASS(serialize: 0)
+struct empty {};
+C4_CLASS(serialize: 2)
+struct no_methods
+{
+  float x;
+};
+C4_ENUM(serialize: 3)
+typedef enum {FOO = 1, BAR = 20} MyEnum_e;
+C4_ENUM(serialize: 4)
+typedef enum {} MyEmptyEnum_e;
+)";
+    CXUnsavedFile sources[] = {{srcname.c_str(), src, (unsigned long)strlen(src)}};
+    const char* flags[] = {"-x", "c++"};
+    // every instruction of the compiled templates, at the start and at
+    // the end of lines, and in nested loops
+    const char cfg[] = R"(
+writer: gengroup
+generators:
+  - name: params
+    type: class
+    extract:
+      macro: C4_CLASS
+    hdr: |
+      PREFIX// {{name}} {{spelling}} {{kind}} {{type}} {{meta.serialize}}
+      {% for m in members %}
+      {{m.type}} {{m.name}}; // {{m.kind}}
+      {% endfor %}
+      {% for m in methods %}
+      void {{m.spelling}}_args({% for p in m.parameters %}{{p.type}} {{p.name}}, {% endfor %}int);
+        {% for p in m.parameters %}{{p.name}}{% endfor %}
+      {% endfor %}
+      members:{% for m in members %} {{m.name}}{% endfor %}
+      {{brief_comment}}{{raw_comment}}
+    src: |
+      PREFIX{% for m in methods %}{{m.name}} {% endfor %}{{name}}
+  - name: symbols
+    type: enum
+    extract:
+      macro: C4_ENUM
+    hdr: |
+      PREFIX// {{name}} {{type}} {{meta.serialize}}
+      {% for s in symbols %}
+      {{s.symbol}} = {{s.value}}, // {{s.name}}
+      {% endfor %}
+      end
+)";
+    auto gen = [&](bool compiled, std::vector<c4::regen::RenderedFile> *out) {
+        std::string c = cfg;
+        // a comment is not compiled, so it makes the engine render the templates
+        const char *prefix = compiled ? "" : "{# engine #}";
+        for(size_t pos; (pos = c.find("PREFIX")) != std::string::npos; )
+        {
+            c.replace(pos, 6, prefix);
+        }
+        c4::regen::Regen rg;
+        rg.load_config_yml(to_csubstr(c));
+        EXPECT_EQ(rg.m_gens_class[0].m_hdr.is_compiled(), compiled);
+        EXPECT_EQ(rg.m_gens_class[0].m_src.is_compiled(), compiled);
+        EXPECT_EQ(rg.m_gens_enum[0].m_hdr.is_compiled(), compiled);
+        rg.gencode_buffers(sources, 1, nullptr, 0, flags, C4_COUNTOF(flags), out);
+    };
+
+    std::vector<c4::regen::RenderedFile> compiled, engine;
+    gen(true, &compiled);
+    gen(false, &engine);
+    ASSERT_EQ(compiled.size(), 1u);
+    ASSERT_EQ(engine.size(), 1u);
+    EXPECT_EQ(compiled[0].m_code.m_hdr, engine[0].m_code.m_hdr);
+    EXPECT_EQ(compiled[0].m_code.m_src, engine[0].m_code.m_src);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("// foo "), std::string::npos);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("void some_method_args(const foo & that, int x, int);\n"), std::string::npos);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("void no_params_args(int);\n"), std::string::npos);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("BAR = 20, // BAR\n"), std::string::npos);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("// empty "), std::string::npos);
+    EXPECT_NE(compiled[0].m_code.m_hdr.find("// MyEmptyEnum_e "), std::string::npos);
+
+    // templates with other constructs are not compiled
+    c4::regen::Regen rg;
+    rg.load_config_yml(to_csubstr(R"(
+writer: gengroup
+generators:
+  - name: cond
+    type: class
+    extract:
+      macro: C4_CLASS
+    src: |
+      {% if meta %}// {{name}}{% endif %}
+)"));
+    EXPECT_FALSE(rg.m_gens_class[0].m_src.is_compiled());
+}
+
+TEST(classes, dump_entity_db)
+{
+    arg tmpdir, cfgfile, srcfile, dbfile, cwd;
+    tmpdir = fs::tmpnam<arg>("test_tmp/XXXXXXXX/");
+    catrs(append, &tmpdir, "classes_dump/");
+    catrs(&cfgfile, to_csubstr(tmpdir), "c4regen.cfg.yml", '\0');
+    catrs(&dbfile, to_csubstr(tmpdir), "entities.c4db", '\0');
+    cwd = c4::fs::cwd<arg>();
+    putcontents(cfgfile, to_csubstr(basic_classes_cfg));
+    {
+        arg f;
+        catrs(&f, to_csubstr(tmpdir), "dump_classes.hpp", '\0');
+        putcontents(f, R"(#pragma once
+#define C4_CLASS(...)
+C4_CLASS(serialize)
+struct foo
+{
+  int a, b;
+  void some_method(foo const& that);
+};
+
+struct not_tagged { int x; };
+
+C4_CLASS()
+struct bar
+{
+  float z;
+};
+)");
+        catrs(&srcfile, to_csubstr(cwd), "/", to_csubstr(f));
+    }
+    std::vector<const char*> args = {
+        "--cmd", "dump",
+        "--flag", "-x",
+        "--flag", "c++",
+        "--cfg", cfgfile.data(),
+        "--entity-db", dbfile.data(),
+        "--",
+        srcfile.data(),
+    };
+    c4::regen::Regen rg;
+    c4::regen::exec(&rg, (int)args.size(), args.data(), /*skip_exe_name*/false);
+
+    c4::regen::EntityDb db;
+    ASSERT_TRUE(db.open(dbfile.data()));
+    ASSERT_EQ(db.size(), 2u + 3u + 1u); // the classes and their members and methods
+
+    auto tagged = db.find_tag("C4_CLASS");
+    ASSERT_EQ(tagged.size(), 2u);
+    EXPECT_EQ(db.find_tag("C4_ENUM").size(), 0u);
+
+    auto const& foo = db[*tagged.begin()];
+    EXPECT_EQ(db.str(foo.name), "foo");
+    EXPECT_EQ(foo.kind, c4::regen::edb::CLASS);
+    EXPECT_EQ(db.str(foo.generator), "class_members");
+    EXPECT_NE(db.str(foo.tag_spec).find("serialize"), csubstr::npos);
+    ASSERT_EQ(foo.children.count, 3u);
+    EXPECT_EQ(db.str(db[foo.children.offset].name), "a");
+    EXPECT_EQ(db[foo.children.offset + 2].kind, c4::regen::edb::METHOD);
+    EXPECT_EQ(db.parent(db[foo.children.offset]), &foo);
+
+    auto const* byusr = db.find_usr(db.str(foo.usr));
+    ASSERT_NE(byusr, nullptr);
+    EXPECT_EQ(byusr, &foo);
+    EXPECT_EQ(db.find_usr("c:@S@not_tagged"), nullptr);
+
+    std::string path;
+    c4::regen::normalize_path(to_csubstr(srcfile).trimr('\0'), to_csubstr(cwd).trimr('\0'), &path);
+    EXPECT_EQ(db.find_file(to_csubstr(path)).size(), db.size());
+}
+
 } // namespace ast
 } // namespace c4
@@ -0,0 +1,21 @@
+// a plugin generator, loaded by the tests with dlopen
+#include <c4/regen/plugin.hpp>
+
+struct EnumNames : public c4::regen::EnumGenerator
+{
+    bool generate_code(c4::regen::Entity const& e, c4::regen::CodeWriter &w) const override
+    {
+        auto const& en = static_cast<c4::regen::Enum const&>(e);
+        std::string s;
+        c4::catrs(&s, "template<> const char* enum_name<", en.m_name, ">(", en.m_name, " v)\n{\n    switch(v)\n    {\n");
+        for(auto const& sym : en.m_symbols)
+        {
+            c4::catrs(c4::append, &s, "    case ", sym.m_sym, ": return \"", sym.m_sym, "\";\n");
+        }
+        c4::catrs(c4::append, &s, "    }\n    return nullptr;\n}\n");
+        w.src(c4::to_csubstr(s));
+        return true;
+    }
+};
+
+C4REGEN_PLUGIN(EnumNames)